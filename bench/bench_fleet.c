@@ -0,0 +1,493 @@
+/*
+ * Banc de charge de bout en bout : flotte d'ESP32 simulés.
+ *
+ * Chaque appareil simulé est un client MQTT qui publie le payload de
+ * sendSensorData() sur le topic capteur, à cadence fixe. Un client
+ * supplémentaire écoute topic_republish : le serveur doit tourner.
+ *
+ * Le numéro de séquence de chaque message est codé dans ses valeurs
+ * (temperature, pression, humidite au dixième, plages réalistes), que le
+ * serveur republie telles quelles : la latence publication -> republication
+ * et les pertes se mesurent sans modifier le payload.
+ *
+ * Usage : build/bench_fleet [-c config.toml] [-n appareils] [-r msg/s par appareil]
+ *                           [-d durée s] [-w attente finale s] [-q qos] [-b]
+ *                           [-l étiquette] [-o résultats.jsonl]
+ *
+ * -b : paquets binaires (sensor_packet.h) au lieu du JSON.
+ *
+ * Le résultat est une ligne JSON, affichée et ajoutée au fichier -o.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <MQTTAsync.h>
+#include "config.h"
+#include "devices.h"
+#include "sensor_packet.h"
+
+#define MAX_DEVICES 4096
+#define SEQ_SPACE 2000000000ULL
+
+static Config cfg;
+static int binary_payload = 0;
+
+static MQTTAsync *devices = NULL;
+static MQTTAsync listener = NULL;
+static atomic_int connected_count = 0;
+static atomic_int subscribed = 0;
+
+// Instant d'envoi et de première réception de chaque message (ns monotones)
+static int64_t *sent_ns = NULL;
+static int64_t *received_ns = NULL;
+static size_t seq_capacity = 0;
+static atomic_size_t seq_next = 0;
+
+static atomic_uint_least64_t received = 0;
+static atomic_uint_least64_t duplicates = 0;
+static atomic_uint_least64_t unknown = 0;
+static atomic_uint_least64_t publish_errors = 0;
+
+static int64_t monotonicNanos(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// ===== CODAGE DE LA SÉQUENCE =====
+
+/*
+ * seq -> dixièmes : temperature [-20.0, 79.9], pression [900.0, 1099.9],
+ * humidite [0.0, 99.9], soit 2.10^9 messages distincts.
+ */
+static void encodeSeq(size_t seq, double *temp, double *press, double *hum)
+{
+  *temp = -20.0 + (double)(seq % 1000) / 10.0;
+  *press = 900.0 + (double)((seq / 1000) % 2000) / 10.0;
+  *hum = (double)((seq / 2000000) % 1000) / 10.0;
+}
+
+static long long decodeSeq(double temp, double press, double hum)
+{
+  long long t = llround((temp + 20.0) * 10.0);
+  long long p = llround((press - 900.0) * 10.0);
+  long long h = llround(hum * 10.0);
+
+  if (t < 0 || t >= 1000 || p < 0 || p >= 2000 || h < 0 || h >= 1000)
+    return -1;
+
+  return t + p * 1000 + h * 2000000;
+}
+
+// ===== RÉCEPTION =====
+
+static int republishArrived(void *context, char *topicName, int topicLen, MQTTAsync_message *message)
+{
+  (void)context;
+  (void)topicLen;
+
+  int64_t now = monotonicNanos();
+  char payload[256];
+  double temp, press, hum;
+
+  int len = message->payloadlen < (int)sizeof(payload) - 1 ? message->payloadlen : (int)sizeof(payload) - 1;
+  memcpy(payload, message->payload, (size_t)len);
+  payload[len] = '\0';
+
+  // Format de republication : valeurs en chaînes, voir payload_format_republish()
+  const char *t = strstr(payload, "\"temperature\"");
+  const char *p = strstr(payload, "\"pression\"");
+  const char *h = strstr(payload, "\"humidite\"");
+  long long seq = -1;
+
+  if (t && p && h &&
+      sscanf(t, "\"temperature\": \"%lf\"", &temp) == 1 &&
+      sscanf(p, "\"pression\": \"%lf\"", &press) == 1 &&
+      sscanf(h, "\"humidite\": \"%lf\"", &hum) == 1)
+  {
+    seq = decodeSeq(temp, press, hum);
+  }
+
+  if (seq < 0 || (size_t)seq >= atomic_load(&seq_next) || (size_t)seq >= seq_capacity)
+  {
+    atomic_fetch_add(&unknown, 1);
+  }
+  else if (received_ns[seq] != 0)
+  {
+    atomic_fetch_add(&duplicates, 1);
+  }
+  else
+  {
+    received_ns[seq] = now;
+    atomic_fetch_add(&received, 1);
+  }
+
+  MQTTAsync_freeMessage(&message);
+  MQTTAsync_free(topicName);
+  return 1;
+}
+
+// ===== CONNEXIONS =====
+
+static void onConnect(void *context, MQTTAsync_successData *response)
+{
+  (void)context;
+  (void)response;
+  atomic_fetch_add(&connected_count, 1);
+}
+
+static void onConnectFailure(void *context, MQTTAsync_failureData *response)
+{
+  (void)context;
+  fprintf(stderr, "Échec connexion : %d\n", response ? response->code : -1);
+}
+
+static void onSubscribe(void *context, MQTTAsync_successData *response)
+{
+  (void)context;
+  (void)response;
+  atomic_store(&subscribed, 1);
+}
+
+static int connectClient(MQTTAsync *client, const char *client_id, MQTTAsync_messageArrived *arrived)
+{
+  MQTTAsync_connectOptions opts = MQTTAsync_connectOptions_initializer;
+
+  if (MQTTAsync_create(client, cfg.mqtt.broker_address, client_id, MQTTCLIENT_PERSISTENCE_NONE, NULL) !=
+      MQTTASYNC_SUCCESS)
+    return -1;
+
+  if (arrived)
+    MQTTAsync_setCallbacks(*client, NULL, NULL, arrived, NULL);
+
+  opts.keepAliveInterval = 60;
+  opts.cleansession = 1;
+  opts.onSuccess = onConnect;
+  opts.onFailure = onConnectFailure;
+
+  return MQTTAsync_connect(*client, &opts) == MQTTASYNC_SUCCESS ? 0 : -1;
+}
+
+static int waitFor(atomic_int *value, int expected, int timeout_ms)
+{
+  for (int waited = 0; atomic_load(value) < expected; waited += 10)
+  {
+    if (waited >= timeout_ms)
+      return -1;
+    usleep(10 * 1000);
+  }
+  return 0;
+}
+
+// ===== PUBLICATION =====
+
+static void publishSample(MQTTAsync client, int device, int qos)
+{
+  size_t seq = atomic_fetch_add(&seq_next, 1);
+  double temp, press, hum;
+  char payload[128];
+  char name[DEVICE_NAME_SIZE];
+  char topic[256];
+  int len;
+
+  if (seq >= seq_capacity)
+    return;
+
+  // Topic avec '+' : un nom par appareil simulé (sim-0, sim-1...)
+  snprintf(name, sizeof(name), "sim-%d", device);
+  devices_format_topic(cfg.mqtt.topic, name, topic, sizeof(topic));
+
+  encodeSeq(seq, &temp, &press, &hum);
+
+  if (binary_payload)
+  {
+    SensorPacket packet = {SENSOR_PACKET_VERSION, 0, (uint16_t)device, (uint32_t)seq,
+                           (int16_t)lround(temp * 10), (uint16_t)lround(press * 10), (uint16_t)lround(hum * 10)};
+    len = (int)sensor_packet_encode(&packet, (uint8_t *)payload);
+  }
+  else
+  {
+    // Sérialisation ArduinoJson : compacte, valeurs arrondies au dixième
+    len = snprintf(payload, sizeof(payload), "{\"temperature\":%g,\"pression\":%g,\"humidite\":%g}",
+                   temp, press, hum);
+  }
+
+  MQTTAsync_message msg = MQTTAsync_message_initializer;
+  msg.payload = payload;
+  msg.payloadlen = len;
+  msg.qos = qos;
+  msg.retained = 0;
+
+  sent_ns[seq] = monotonicNanos();
+  if (MQTTAsync_sendMessage(client, topic, &msg, NULL) != MQTTASYNC_SUCCESS)
+  {
+    sent_ns[seq] = -1;
+    atomic_fetch_add(&publish_errors, 1);
+  }
+}
+
+static void sleepUntil(int64_t deadline_ns)
+{
+  struct timespec ts = {(time_t)(deadline_ns / 1000000000LL), (long)(deadline_ns % 1000000000LL)};
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0)
+    ;
+}
+
+// ===== RÉSULTATS =====
+
+static int compareDouble(const void *a, const void *b)
+{
+  double x = *(const double *)a, y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+static double percentile(const double *sorted, size_t count, double q)
+{
+  if (count == 0)
+    return 0.0;
+
+  size_t index = (size_t)ceil(q * (double)count);
+  if (index > 0)
+    index--;
+  return sorted[index < count ? index : count - 1];
+}
+
+static void usage(const char *prog)
+{
+  fprintf(stderr, "Usage : %s [-c config.toml] [-n appareils] [-r msg/s] [-d durée s] [-w attente s] "
+                  "[-q qos] [-b] [-l étiquette] [-o résultats.jsonl]\n",
+          prog);
+}
+
+int main(int argc, char *argv[])
+{
+  const char *config_file = "config.toml";
+  const char *label = "";
+  const char *output = NULL;
+  int device_count = 10;
+  double rate = 1.0;
+  double duration_s = 30.0;
+  double drain_s = 2.0;
+  int qos = 0; // PubSubClient publie en QoS 0
+  int opt;
+
+  while ((opt = getopt(argc, argv, "c:n:r:d:w:q:bl:o:h")) != -1)
+  {
+    switch (opt)
+    {
+    case 'c':
+      config_file = optarg;
+      break;
+    case 'n':
+      device_count = atoi(optarg);
+      break;
+    case 'r':
+      rate = atof(optarg);
+      break;
+    case 'd':
+      duration_s = atof(optarg);
+      break;
+    case 'w':
+      drain_s = atof(optarg);
+      break;
+    case 'q':
+      qos = atoi(optarg);
+      break;
+    case 'b':
+      binary_payload = 1;
+      break;
+    case 'l':
+      label = optarg;
+      break;
+    case 'o':
+      output = optarg;
+      break;
+    default:
+      usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (device_count < 1 || device_count > MAX_DEVICES || rate <= 0.0 || duration_s <= 0.0 || qos < 0 || qos > 2)
+  {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  if (config_load(&cfg, config_file) != 0)
+    return EXIT_FAILURE;
+
+  double expected = (double)device_count * rate * duration_s;
+  seq_capacity = (size_t)(expected * 1.1) + (size_t)device_count + 16;
+  if (seq_capacity > SEQ_SPACE)
+  {
+    fprintf(stderr, "Trop de messages pour le codage de séquence (%zu)\n", seq_capacity);
+    return EXIT_FAILURE;
+  }
+
+  sent_ns = calloc(seq_capacity, sizeof(int64_t));
+  received_ns = calloc(seq_capacity, sizeof(int64_t));
+  devices = calloc((size_t)device_count, sizeof(MQTTAsync));
+  if (!sent_ns || !received_ns || !devices)
+  {
+    fprintf(stderr, "Erreur allocation\n");
+    return EXIT_FAILURE;
+  }
+
+  printf("Flotte : %d appareils x %.2f msg/s pendant %.0f s vers %s (%s -> %s)\n",
+         device_count, rate, duration_s, cfg.mqtt.broker_address, cfg.mqtt.topic, cfg.mqtt.topic_republish);
+
+  // Écoute de la republication avant tout envoi
+  MQTTAsync_responseOptions sub_opts = MQTTAsync_responseOptions_initializer;
+  sub_opts.onSuccess = onSubscribe;
+
+  if (connectClient(&listener, "bench-listener", republishArrived) != 0 ||
+      waitFor(&connected_count, 1, 5000) != 0 ||
+      MQTTAsync_subscribe(listener, cfg.mqtt.topic_republish, 1, &sub_opts) != MQTTASYNC_SUCCESS ||
+      waitFor(&subscribed, 1, 5000) != 0)
+  {
+    fprintf(stderr, "Abonnement à %s impossible\n", cfg.mqtt.topic_republish);
+    return EXIT_FAILURE;
+  }
+
+  for (int i = 0; i < device_count; i++)
+  {
+    char client_id[32];
+    snprintf(client_id, sizeof(client_id), "bench-esp32-%d", i);
+    if (connectClient(&devices[i], client_id, NULL) != 0)
+    {
+      fprintf(stderr, "Création client %s impossible\n", client_id);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (waitFor(&connected_count, device_count + 1, 30000) != 0)
+  {
+    fprintf(stderr, "Connexions : %d/%d\n", atomic_load(&connected_count) - 1, device_count);
+    return EXIT_FAILURE;
+  }
+
+  // Départs étalés sur une période, comme des appareils allumés à des instants différents
+  int64_t period_ns = (int64_t)(1e9 / rate);
+  int64_t start_ns = monotonicNanos();
+  int64_t end_ns = start_ns + (int64_t)(duration_s * 1e9);
+  int64_t *next_ns = malloc((size_t)device_count * sizeof(int64_t));
+  if (!next_ns)
+    return EXIT_FAILURE;
+
+  for (int i = 0; i < device_count; i++)
+    next_ns[i] = start_ns + period_ns * i / device_count;
+
+  while (1)
+  {
+    int64_t now = monotonicNanos();
+    int64_t earliest = INT64_MAX;
+
+    for (int i = 0; i < device_count; i++)
+    {
+      if (next_ns[i] <= now && next_ns[i] < end_ns)
+      {
+        publishSample(devices[i], i, qos);
+        next_ns[i] += period_ns;
+      }
+      if (next_ns[i] < earliest)
+        earliest = next_ns[i];
+    }
+
+    if (earliest >= end_ns)
+      break;
+    if (earliest > now)
+      sleepUntil(earliest);
+  }
+
+  int64_t publish_end_ns = monotonicNanos();
+  sleepUntil(publish_end_ns + (int64_t)(drain_s * 1e9));
+
+  // Résultats
+  size_t sent = atomic_load(&seq_next);
+  if (sent > seq_capacity)
+    sent = seq_capacity;
+
+  double *latencies = malloc((sent ? sent : 1) * sizeof(double));
+  size_t latency_count = 0;
+  double latency_sum = 0.0;
+  int64_t last_received_ns = start_ns;
+
+  for (size_t s = 0; s < sent && latencies; s++)
+  {
+    if (sent_ns[s] > 0 && received_ns[s] > 0)
+    {
+      double ms = (double)(received_ns[s] - sent_ns[s]) / 1e6;
+      latencies[latency_count++] = ms;
+      latency_sum += ms;
+      if (received_ns[s] > last_received_ns)
+        last_received_ns = received_ns[s];
+    }
+  }
+  qsort(latencies, latency_count, sizeof(double), compareDouble);
+
+  uint64_t errors = atomic_load(&publish_errors);
+  uint64_t delivered = latency_count;
+  uint64_t lost = sent - errors - delivered;
+  double elapsed_s = (double)(last_received_ns - start_ns) / 1e9;
+  double publish_s = (double)(publish_end_ns - start_ns) / 1e9;
+
+  char result[1024];
+  snprintf(result, sizeof(result),
+           "{\"label\":\"%s\",\"time\":%lld,\"devices\":%d,\"rate_hz\":%g,\"duration_s\":%g,\"qos\":%d,\"format\":\"%s\","
+           "\"sent\":%zu,\"publish_errors\":%llu,\"received\":%llu,\"lost\":%llu,\"loss_pct\":%.3f,"
+           "\"duplicates\":%llu,\"unknown\":%llu,"
+           "\"publish_rate\":%.1f,\"throughput\":%.1f,"
+           "\"latency_ms\":{\"mean\":%.3f,\"p50\":%.3f,\"p90\":%.3f,\"p99\":%.3f,\"p999\":%.3f,\"max\":%.3f}}",
+           label, (long long)time(NULL), device_count, rate, duration_s, qos, binary_payload ? "binary" : "json",
+           sent, (unsigned long long)errors, (unsigned long long)delivered, (unsigned long long)lost,
+           sent ? 100.0 * (double)lost / (double)sent : 0.0,
+           (unsigned long long)atomic_load(&duplicates), (unsigned long long)atomic_load(&unknown),
+           publish_s > 0 ? (double)sent / publish_s : 0.0,
+           elapsed_s > 0 ? (double)delivered / elapsed_s : 0.0,
+           latency_count ? latency_sum / (double)latency_count : 0.0,
+           percentile(latencies, latency_count, 0.50), percentile(latencies, latency_count, 0.90),
+           percentile(latencies, latency_count, 0.99), percentile(latencies, latency_count, 0.999),
+           latency_count ? latencies[latency_count - 1] : 0.0);
+
+  printf("%s\n", result);
+
+  if (output)
+  {
+    FILE *fp = fopen(output, "a");
+    if (fp)
+    {
+      fprintf(fp, "%s\n", result);
+      fclose(fp);
+      printf("Résultat ajouté à %s\n", output);
+    }
+    else
+    {
+      fprintf(stderr, "Erreur écriture %s\n", output);
+    }
+  }
+
+  for (int i = 0; i < device_count; i++)
+  {
+    MQTTAsync_disconnectOptions disc_opts = MQTTAsync_disconnectOptions_initializer;
+    MQTTAsync_disconnect(devices[i], &disc_opts);
+    MQTTAsync_destroy(&devices[i]);
+  }
+
+  MQTTAsync_disconnectOptions disc_opts = MQTTAsync_disconnectOptions_initializer;
+  MQTTAsync_disconnect(listener, &disc_opts);
+  MQTTAsync_destroy(&listener);
+
+  free(next_ns);
+  free(latencies);
+  free(devices);
+  free(received_ns);
+  free(sent_ns);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,150 @@
+/*
+ * Microbenchmark du parsing des payloads capteur :
+ *   - json-c  : chemin historique (json_tokener_parse + get_ex + put)
+ *   - rapide  : payload_parse_fast, une passe sans allocation
+ *   - binaire : payload_parse_binary, paquet de 16 octets (sensor_packet.h)
+ *
+ * Usage : build/bench_parser [iterations]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include "payload.h"
+#include "sensor_packet.h"
+
+#define DEFAULT_ITERATIONS 1000000
+
+// Payloads représentatifs de sendSensorData() (ArduinoJson, sans espaces)
+static const char *payloads[] = {
+    "{\"temperature\":21.5,\"pression\":1013.2,\"humidite\":45.1}",
+    "{\"temperature\":-3.7,\"pression\":987.6,\"humidite\":99.9}",
+    "{\"temperature\":0,\"pression\":1020,\"humidite\":50}",
+    "{ \"humidite\": 38.4, \"temperature\": 23.9, \"pression\": 1009.8 }",
+};
+#define PAYLOAD_COUNT (sizeof(payloads) / sizeof(payloads[0]))
+
+// Mêmes mesures au format binaire, en dixièmes
+static const SensorPacket packets[PAYLOAD_COUNT] = {
+    {SENSOR_PACKET_VERSION, 0, 0, 1, 215, 10132, 451},
+    {SENSOR_PACKET_VERSION, 0, 0, 2, -37, 9876, 999},
+    {SENSOR_PACKET_VERSION, 0, 0, 3, 0, 10200, 500},
+    {SENSOR_PACKET_VERSION, 0, 0, 4, 239, 10098, 384},
+};
+static uint8_t encoded[PAYLOAD_COUNT][SENSOR_PACKET_SIZE];
+
+// Chemin historique de parseAndStore(), à l'identique
+static int parseWithJsonC(const char *jsonString, SensorSample *sample)
+{
+  struct json_object *parsed_json = json_tokener_parse(jsonString);
+  struct json_object *temp_obj, *press_obj, *hum_obj;
+
+  if (parsed_json == NULL)
+    return -1;
+
+  if (!json_object_object_get_ex(parsed_json, "temperature", &temp_obj) ||
+      !json_object_object_get_ex(parsed_json, "pression", &press_obj) ||
+      !json_object_object_get_ex(parsed_json, "humidite", &hum_obj))
+  {
+    json_object_put(parsed_json);
+    return -1;
+  }
+
+  sample->temperature = json_object_get_double(temp_obj);
+  sample->pression = json_object_get_double(press_obj);
+  sample->humidite = json_object_get_double(hum_obj);
+
+  json_object_put(parsed_json);
+  return 0;
+}
+
+static double nowSeconds(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int checkEquivalence(void)
+{
+  for (size_t i = 0; i < PAYLOAD_COUNT; i++)
+  {
+    SensorSample ref, fast;
+
+    if (parseWithJsonC(payloads[i], &ref) != 0 ||
+        payload_parse_fast(payloads[i], strlen(payloads[i]), &fast) != 0)
+    {
+      fprintf(stderr, "Payload rejeté : %s\n", payloads[i]);
+      return -1;
+    }
+
+    if (ref.temperature != fast.temperature || ref.pression != fast.pression ||
+        ref.humidite != fast.humidite)
+    {
+      fprintf(stderr, "Résultat différent de json-c : %s\n", payloads[i]);
+      return -1;
+    }
+
+    SensorSample binary;
+    sensor_packet_encode(&packets[i], encoded[i]);
+    if (payload_parse((const char *)encoded[i], SENSOR_PACKET_SIZE, &binary) != 0 ||
+        ref.temperature != binary.temperature || ref.pression != binary.pression ||
+        ref.humidite != binary.humidite)
+    {
+      fprintf(stderr, "Paquet binaire différent de json-c : %s\n", payloads[i]);
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+int main(int argc, char *argv[])
+{
+  long iterations = (argc > 1) ? atol(argv[1]) : DEFAULT_ITERATIONS;
+  size_t lengths[PAYLOAD_COUNT];
+  volatile double sink = 0;
+  SensorSample sample;
+
+  for (size_t i = 0; i < PAYLOAD_COUNT; i++)
+    lengths[i] = strlen(payloads[i]);
+
+  if (checkEquivalence() != 0)
+    return EXIT_FAILURE;
+
+  printf("=== Benchmark parsing (%ld itérations) ===\n", iterations);
+
+  double start = nowSeconds();
+  for (long n = 0; n < iterations; n++)
+  {
+    parseWithJsonC(payloads[n % PAYLOAD_COUNT], &sample);
+    sink += sample.temperature;
+  }
+  double json_c_ns = (nowSeconds() - start) * 1e9 / iterations;
+
+  start = nowSeconds();
+  for (long n = 0; n < iterations; n++)
+  {
+    size_t i = n % PAYLOAD_COUNT;
+    payload_parse_fast(payloads[i], lengths[i], &sample);
+    sink += sample.temperature;
+  }
+  double fast_ns = (nowSeconds() - start) * 1e9 / iterations;
+
+  start = nowSeconds();
+  for (long n = 0; n < iterations; n++)
+  {
+    payload_parse_binary(encoded[n % PAYLOAD_COUNT], SENSOR_PACKET_SIZE, &sample);
+    sink += sample.temperature;
+  }
+  double binary_ns = (nowSeconds() - start) * 1e9 / iterations;
+
+  printf("json-c  : %8.1f ns/op\n", json_c_ns);
+  printf("rapide  : %8.1f ns/op\n", fast_ns);
+  printf("binaire : %8.1f ns/op (%d octets au lieu de %zu)\n", binary_ns, SENSOR_PACKET_SIZE, lengths[0]);
+  printf("Gain    : x%.1f (rapide), x%.1f (binaire)\n", json_c_ns / fast_ns, json_c_ns / binary_ns);
+
+  (void)sink;
+  return EXIT_SUCCESS;
+}
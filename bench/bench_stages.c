@@ -0,0 +1,239 @@
+/*
+ * Microbenchmark par étape du chemin chaud du serveur, sans broker :
+ *   - getUTCTimestamp
+ *   - payload_parse
+ *   - insertData            (commit par lot compris, sans compression)
+ *   - insertData+<mode>     (la même, avec la compression de config.toml)
+ *   - republishWithTimestamp
+ *   - parseAndStore         (les trois réunis, compression de config.toml)
+ *
+ * mqtt_subscriber.c est compilé sans main() (-DSUBSCRIBER_NO_MAIN) et lié avec
+ * le client MQTT factice ci-dessous, qui acquitte chaque envoi sans copier le
+ * payload : seul le code du serveur est mesuré. La base est :memory: par
+ * défaut, ou le chemin donné (tmpfs : /dev/shm/bench.db).
+ *
+ * Les allocations sont comptées en interposant malloc/calloc/realloc (glibc),
+ * y compris celles de SQLite et json-c.
+ *
+ * Usage : build/bench_stages [iterations] [base] [config.toml]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "mqtt_subscriber.h"
+
+#define DEFAULT_ITERATIONS 200000
+
+// ===== COMPTAGE DES ALLOCATIONS =====
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static unsigned long long alloc_count = 0;
+
+void *malloc(size_t size)
+{
+  alloc_count++;
+  return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size)
+{
+  alloc_count++;
+  return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+  alloc_count++;
+  return __libc_realloc(ptr, size);
+}
+
+// ===== CLIENT MQTT FACTICE =====
+
+int MQTTAsync_sendMessage(MQTTAsync handle, const char *destinationName, const MQTTAsync_message *msg,
+                          MQTTAsync_responseOptions *response)
+{
+  (void)handle;
+  (void)destinationName;
+  (void)msg;
+
+  // PUBACK immédiat : la fenêtre de republication ne se remplit pas
+  if (response && response->onSuccess)
+  {
+    MQTTAsync_successData data;
+    memset(&data, 0, sizeof(data));
+    response->onSuccess(response->context, &data);
+  }
+  return MQTTASYNC_SUCCESS;
+}
+
+int MQTTAsync_subscribe(MQTTAsync handle, const char *topic, int qos, MQTTAsync_responseOptions *response)
+{
+  (void)handle;
+  (void)topic;
+  (void)qos;
+  (void)response;
+  return MQTTASYNC_SUCCESS;
+}
+
+void MQTTAsync_freeMessage(MQTTAsync_message **msg)
+{
+  free((*msg)->payload);
+  free(*msg);
+  *msg = NULL;
+}
+
+void MQTTAsync_free(void *ptr)
+{
+  free(ptr);
+}
+
+// ===== ÉTAPES =====
+
+// Payloads représentatifs de sendSensorData() (ArduinoJson, sans espaces)
+static const char *payloads[] = {
+    "{\"temperature\":21.5,\"pression\":1013.2,\"humidite\":45.1}",
+    "{\"temperature\":-3.7,\"pression\":987.6,\"humidite\":99.9}",
+    "{\"temperature\":0,\"pression\":1020,\"humidite\":50}",
+    "{\"temperature\":23.9,\"pression\":1009.8,\"humidite\":38.4}",
+};
+#define PAYLOAD_COUNT (sizeof(payloads) / sizeof(payloads[0]))
+
+static size_t lengths[PAYLOAD_COUNT];
+static volatile double sink = 0;
+
+// Instants simulés : une mesure par milliseconde, jamais deux fois le même
+static int64_t next_ts_ms = 0;
+
+static void opTimestamp(long n)
+{
+  char buffer[64];
+  (void)n;
+  getUTCTimestamp(buffer, sizeof(buffer));
+  sink += buffer[18];
+}
+
+static void opParse(long n)
+{
+  SensorSample sample;
+  size_t i = (size_t)n % PAYLOAD_COUNT;
+  payload_parse(payloads[i], lengths[i], &sample);
+  sink += sample.temperature;
+}
+
+static void opInsert(long n)
+{
+  insertData(next_ts_ms++, 21.5 + (double)(n % 10) / 10.0, 1013.2, 45.1);
+}
+
+static void opRepublish(long n)
+{
+  republishWithTimestamp(0, "2025-01-02 14:30:00", 21.5 + (double)(n % 10) / 10.0, 1013.2, 45.1);
+}
+
+static void opParseAndStore(long n)
+{
+  size_t i = (size_t)n % PAYLOAD_COUNT;
+  parseAndStore(payloads[i], lengths[i], -1, next_ts_ms++);
+}
+
+// Mode de compression, avec les tolérances de la configuration
+static void setCompression(CompressionMode mode)
+{
+  const double tolerance[COMPRESSION_METRICS] = {app_config.compression.temperature, app_config.compression.pression,
+                                                 app_config.compression.humidite};
+  compression_init(mode, tolerance, (int64_t)app_config.compression.max_gap_s * 1000);
+}
+
+static double nowSeconds(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void runStage(const char *name, long iterations, void (*op)(long), int commit_after)
+{
+  // Chauffe : caches, statements et partition courante
+  for (long n = 0; n < iterations / 100 + 1; n++)
+    op(n);
+  if (commit_after)
+    commitPendingData();
+
+  unsigned long long allocs = alloc_count;
+  double start = nowSeconds();
+
+  for (long n = 0; n < iterations; n++)
+    op(n);
+  if (commit_after)
+    commitPendingData();
+
+  double elapsed = nowSeconds() - start;
+  allocs = alloc_count - allocs;
+
+  double ns = elapsed * 1e9 / (double)iterations;
+  printf("%-24s %10.1f ns/op %8.2f allocs/op %12.0f op/s\n",
+         name, ns, (double)allocs / (double)iterations, (double)iterations / elapsed);
+}
+
+int main(int argc, char *argv[])
+{
+  long iterations = (argc > 1) ? atol(argv[1]) : DEFAULT_ITERATIONS;
+  const char *db_path = (argc > 2) ? argv[2] : ":memory:";
+  const char *config_file = (argc > 3) ? argv[3] : "config.toml";
+
+  if (iterations <= 0)
+  {
+    fprintf(stderr, "Usage : %s [iterations] [base] [config.toml]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  // Réglages de production (lot, agrégats...) si config.toml est lisible
+  if (config_load(&app_config, config_file) != 0)
+    config_init_defaults(&app_config);
+
+  snprintf(app_config.database.path, sizeof(app_config.database.path), "%s", db_path);
+  app_config.logging.display_messages = 0;
+
+  for (size_t i = 0; i < PAYLOAD_COUNT; i++)
+    lengths[i] = strlen(payloads[i]);
+
+  if (initDatabase(&app_config) != SQLITE_OK)
+    return EXIT_FAILURE;
+
+  if (app_config.query.enabled)
+    recent_cache_init((int64_t)app_config.database.retention_hours * 3600 * 1000,
+                      (size_t)app_config.query.max_samples);
+
+  next_ts_ms = getEpochMillis();
+
+  printf("=== Benchmark par étape (%ld itérations, base %s, lot de %d) ===\n",
+         iterations, db_path, app_config.database.batch_size);
+
+  runStage("getUTCTimestamp", iterations, opTimestamp, 0);
+  runStage("payload_parse", iterations, opParse, 0);
+
+  // Stockage seul, puis avec la compression : l'écart est le coût du filtre
+  int mode = compression_parse_mode(app_config.compression.mode);
+  setCompression(COMPRESSION_OFF);
+  runStage("insertData", iterations, opInsert, 1);
+  if (mode > COMPRESSION_OFF)
+  {
+    char name[32];
+    snprintf(name, sizeof(name), "insertData+%s", compression_mode_name((CompressionMode)mode));
+    setCompression((CompressionMode)mode);
+    runStage(name, iterations, opInsert, 1);
+  }
+
+  runStage("republishWithTimestamp", iterations, opRepublish, 0);
+  runStage("parseAndStore", iterations, opParseAndStore, 1);
+
+  recent_cache_close();
+  closeDatabase();
+
+  (void)sink;
+  return EXIT_SUCCESS;
+}
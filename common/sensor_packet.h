@@ -0,0 +1,467 @@
+#ifndef SENSOR_PACKET_H
+#define SENSOR_PACKET_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ===== FORMAT BINAIRE DES MESURES =====
+
+/*
+ * Partagé par le firmware (encodeur) et le serveur (décodeur). 16 octets,
+ * petit-boutiste, champs alignés :
+ *
+ *   0  u8   magic        SENSOR_PACKET_MAGIC (jamais le début d'un JSON)
+ *   1  u8   version      SENSOR_PACKET_VERSION
+ *   2  u8   flags        SENSOR_FLAG_*
+ *   3  u8   réservé      0
+ *   4  u16  device_id
+ *   6  u16  humidite     dixièmes de %
+ *   8  u32  sequence     incrémentée à chaque message, repart de 0 au démarrage
+ *  12  i16  temperature  dixièmes de °C
+ *  14  u16  pression     dixièmes de hPa
+ *
+ * Les valeurs sont les dixièmes déjà publiés en JSON (round(x * 10)) : le
+ * serveur retrouve exactement les mêmes doubles (n / 10.0).
+ *
+ * Lot (version 2) : plusieurs mesures d'un appareil dans un seul message,
+ * en-tête de 12 octets puis count mesures de 8 octets :
+ *
+ *   0  u8   magic        SENSOR_PACKET_MAGIC
+ *   1  u8   version      SENSOR_BATCH_VERSION
+ *   2  u8   flags        SENSOR_FLAG_* (première mesure du lot)
+ *   3  u8   count        1..SENSOR_BATCH_MAX
+ *   4  u16  device_id
+ *   6  u16  réservé      0
+ *   8  u32  sequence     de la première mesure, +1 pour chacune des suivantes
+ *
+ *   +0 u16  age          dixièmes de seconde écoulés entre la mesure et l'envoi
+ *   +2 i16  temperature
+ *   +4 u16  pression
+ *   +6 u16  humidite
+ *
+ * L'appareil n'a pas d'horloge absolue : le serveur date chaque mesure par
+ * réception - age.
+ *
+ * Rattrapage (version 3) : mesures conservées pendant une coupure, datées par
+ * l'horloge de l'appareil (secondes, conservée à travers les redémarrages
+ * logiciels mais sans origine absolue). En-tête de 16 octets puis count
+ * mesures de 12 octets :
+ *
+ *   0  u8   magic        SENSOR_PACKET_MAGIC
+ *   1  u8   version      SENSOR_BACKFILL_VERSION
+ *   2  u8   flags        SENSOR_FLAG_*
+ *   3  u8   count        1..SENSOR_BATCH_MAX
+ *   4  u16  device_id
+ *   6  u16  réservé      0
+ *   8  u32  sequence     de la première mesure
+ *  12  u32  clock        horloge de l'appareil à l'envoi
+ *
+ *   +0 u32  time         horloge de l'appareil à la mesure
+ *   +4 i16  temperature
+ *   +6 u16  pression
+ *   +8 u16  humidite
+ *  +10 u16  réservé      0
+ *
+ * Le serveur date chaque mesure par réception - (clock - time).
+ *
+ * Résumés (version 4) : l'appareil suréchantillonne et n'envoie, par
+ * intervalle, que moyenne, min, max et écart-type de ses lectures. En-tête de
+ * la version 2 puis count résumés de 28 octets :
+ *
+ *   +0 u16  age          dixièmes de seconde entre le milieu de l'intervalle et l'envoi
+ *   +2 u16  readings     lectures résumées
+ *   +4      temperature  SensorStat (8 octets)
+ *  +12      pression     SensorStat
+ *  +20      humidite     SensorStat
+ *
+ * SensorStat : i16 moyenne, i16 min, i16 max en dixièmes, u16 écart-type en
+ * centièmes. count est limité à SENSOR_SUMMARY_MAX (message < 1 Ko).
+ *
+ * Tout message (binaire ou JSON) tient dans SENSOR_MESSAGE_MAX octets : c'est
+ * la taille d'un emplacement de la file du serveur, qui ignore les messages
+ * plus longs. Le firmware dimensionne ses lots JSON sur cette limite.
+ */
+
+#define SENSOR_MESSAGE_MAX 1024
+
+#define SENSOR_PACKET_MAGIC 0xB5
+#define SENSOR_PACKET_VERSION 1
+#define SENSOR_PACKET_SIZE 16
+
+#define SENSOR_BATCH_VERSION 2
+#define SENSOR_BATCH_HEADER_SIZE 12
+#define SENSOR_BATCH_READING_SIZE 8
+#define SENSOR_BATCH_MAX 64
+#define SENSOR_BATCH_SIZE(count) (SENSOR_BATCH_HEADER_SIZE + (count) * SENSOR_BATCH_READING_SIZE)
+
+#define SENSOR_BACKFILL_VERSION 3
+#define SENSOR_BACKFILL_HEADER_SIZE 16
+#define SENSOR_BACKFILL_READING_SIZE 12
+#define SENSOR_BACKFILL_SIZE(count) (SENSOR_BACKFILL_HEADER_SIZE + (count) * SENSOR_BACKFILL_READING_SIZE)
+
+#define SENSOR_SUMMARY_VERSION 4
+#define SENSOR_SUMMARY_READING_SIZE 28
+#define SENSOR_SUMMARY_MAX 32
+#define SENSOR_SUMMARY_SIZE(count) (SENSOR_BATCH_HEADER_SIZE + (count) * SENSOR_SUMMARY_READING_SIZE)
+
+#define SENSOR_FLAG_BOOT 0x01 // premier message depuis le démarrage
+
+typedef struct
+{
+  uint8_t version;
+  uint8_t flags;
+  uint16_t device_id;
+  uint32_t sequence;
+  int16_t temperature; // dixièmes de °C
+  uint16_t pression;   // dixièmes de hPa
+  uint16_t humidite;   // dixièmes de %
+} SensorPacket;
+
+typedef struct
+{
+  uint16_t age; // dixièmes de seconde avant l'envoi
+  int16_t temperature;
+  uint16_t pression;
+  uint16_t humidite;
+} SensorReading;
+
+typedef struct
+{
+  int16_t mean; // dixièmes
+  int16_t min;
+  int16_t max;
+  uint16_t stddev; // centièmes
+} SensorStat;
+
+typedef struct
+{
+  uint16_t age;      // dixièmes de seconde avant l'envoi
+  uint16_t readings; // lectures résumées
+  SensorStat temperature;
+  SensorStat pression;
+  SensorStat humidite;
+} SensorSummary;
+
+typedef struct
+{
+  uint32_t time; // horloge de l'appareil, en secondes
+  int16_t temperature;
+  uint16_t pression;
+  uint16_t humidite;
+} SensorRecord;
+
+static inline void sensor_packet_put16(uint8_t *p, uint16_t v)
+{
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+}
+
+static inline void sensor_packet_put32(uint8_t *p, uint32_t v)
+{
+  sensor_packet_put16(p, (uint16_t)v);
+  sensor_packet_put16(p + 2, (uint16_t)(v >> 16));
+}
+
+static inline uint16_t sensor_packet_get16(const uint8_t *p)
+{
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t sensor_packet_get32(const uint8_t *p)
+{
+  return (uint32_t)sensor_packet_get16(p) | ((uint32_t)sensor_packet_get16(p + 2) << 16);
+}
+
+/**
+ * @brief Encode une mesure
+ * @param packet Mesure (version ignorée : SENSOR_PACKET_VERSION)
+ * @param out Buffer d'au moins SENSOR_PACKET_SIZE octets
+ * @return SENSOR_PACKET_SIZE
+ */
+static inline size_t sensor_packet_encode(const SensorPacket *packet, uint8_t *out)
+{
+  out[0] = SENSOR_PACKET_MAGIC;
+  out[1] = SENSOR_PACKET_VERSION;
+  out[2] = packet->flags;
+  out[3] = 0;
+  sensor_packet_put16(out + 4, packet->device_id);
+  sensor_packet_put16(out + 6, packet->humidite);
+  sensor_packet_put32(out + 8, packet->sequence);
+  sensor_packet_put16(out + 12, (uint16_t)packet->temperature);
+  sensor_packet_put16(out + 14, packet->pression);
+  return SENSOR_PACKET_SIZE;
+}
+
+/**
+ * @brief Décode une mesure, directement depuis le buffer reçu
+ * @param data Payload
+ * @param len Longueur du payload
+ * @param packet Mesure décodée
+ * @return 0 si succès, -1 si ce n'est pas un paquet de cette version
+ */
+static inline int sensor_packet_decode(const void *data, size_t len, SensorPacket *packet)
+{
+  const uint8_t *p = (const uint8_t *)data;
+
+  if (len != SENSOR_PACKET_SIZE || p[0] != SENSOR_PACKET_MAGIC || p[1] != SENSOR_PACKET_VERSION)
+    return -1;
+
+  packet->version = p[1];
+  packet->flags = p[2];
+  packet->device_id = sensor_packet_get16(p + 4);
+  packet->humidite = sensor_packet_get16(p + 6);
+  packet->sequence = sensor_packet_get32(p + 8);
+  packet->temperature = (int16_t)sensor_packet_get16(p + 12);
+  packet->pression = sensor_packet_get16(p + 14);
+  return 0;
+}
+
+/**
+ * @brief Encode un lot de mesures
+ * @param header Appareil, flags et séquence de la première mesure (autres champs ignorés)
+ * @param readings Mesures, de la plus ancienne à la plus récente
+ * @param count Nombre de mesures (1..SENSOR_BATCH_MAX)
+ * @param out Buffer d'au moins SENSOR_BATCH_SIZE(count) octets
+ * @return Taille écrite, 0 si count est hors limites
+ */
+static inline size_t sensor_batch_encode(const SensorPacket *header, const SensorReading *readings, size_t count,
+                                         uint8_t *out)
+{
+  if (count < 1 || count > SENSOR_BATCH_MAX)
+    return 0;
+
+  out[0] = SENSOR_PACKET_MAGIC;
+  out[1] = SENSOR_BATCH_VERSION;
+  out[2] = header->flags;
+  out[3] = (uint8_t)count;
+  sensor_packet_put16(out + 4, header->device_id);
+  sensor_packet_put16(out + 6, 0);
+  sensor_packet_put32(out + 8, header->sequence);
+
+  uint8_t *p = out + SENSOR_BATCH_HEADER_SIZE;
+  for (size_t i = 0; i < count; i++, p += SENSOR_BATCH_READING_SIZE)
+  {
+    sensor_packet_put16(p, readings[i].age);
+    sensor_packet_put16(p + 2, (uint16_t)readings[i].temperature);
+    sensor_packet_put16(p + 4, readings[i].pression);
+    sensor_packet_put16(p + 6, readings[i].humidite);
+  }
+
+  return SENSOR_BATCH_SIZE(count);
+}
+
+/**
+ * @brief Lit l'en-tête d'un lot
+ * @param data Payload
+ * @param len Longueur du payload
+ * @param header Appareil, flags et séquence de la première mesure
+ * @return Nombre de mesures, -1 si ce n'est pas un lot valide
+ */
+static inline int sensor_batch_decode_header(const void *data, size_t len, SensorPacket *header)
+{
+  const uint8_t *p = (const uint8_t *)data;
+
+  if (len < SENSOR_BATCH_HEADER_SIZE || p[0] != SENSOR_PACKET_MAGIC || p[1] != SENSOR_BATCH_VERSION)
+    return -1;
+
+  int count = p[3];
+  if (count < 1 || count > SENSOR_BATCH_MAX || len != (size_t)SENSOR_BATCH_SIZE(count))
+    return -1;
+
+  header->version = p[1];
+  header->flags = p[2];
+  header->device_id = sensor_packet_get16(p + 4);
+  header->sequence = sensor_packet_get32(p + 8);
+  header->temperature = 0;
+  header->pression = 0;
+  header->humidite = 0;
+  return count;
+}
+
+/**
+ * @brief Lit la mesure index d'un lot validé par sensor_batch_decode_header
+ */
+static inline void sensor_batch_reading(const void *data, int index, SensorReading *reading)
+{
+  const uint8_t *p = (const uint8_t *)data + SENSOR_BATCH_HEADER_SIZE + (size_t)index * SENSOR_BATCH_READING_SIZE;
+
+  reading->age = sensor_packet_get16(p);
+  reading->temperature = (int16_t)sensor_packet_get16(p + 2);
+  reading->pression = sensor_packet_get16(p + 4);
+  reading->humidite = sensor_packet_get16(p + 6);
+}
+
+/**
+ * @brief Encode un lot de rattrapage
+ * @param header Appareil, flags et séquence de la première mesure (autres champs ignorés)
+ * @param clock Horloge de l'appareil à l'envoi
+ * @param records Mesures, de la plus ancienne à la plus récente
+ * @param count Nombre de mesures (1..SENSOR_BATCH_MAX)
+ * @param out Buffer d'au moins SENSOR_BACKFILL_SIZE(count) octets
+ * @return Taille écrite, 0 si count est hors limites
+ */
+static inline size_t sensor_backfill_encode(const SensorPacket *header, uint32_t clock, const SensorRecord *records,
+                                            size_t count, uint8_t *out)
+{
+  if (count < 1 || count > SENSOR_BATCH_MAX)
+    return 0;
+
+  out[0] = SENSOR_PACKET_MAGIC;
+  out[1] = SENSOR_BACKFILL_VERSION;
+  out[2] = header->flags;
+  out[3] = (uint8_t)count;
+  sensor_packet_put16(out + 4, header->device_id);
+  sensor_packet_put16(out + 6, 0);
+  sensor_packet_put32(out + 8, header->sequence);
+  sensor_packet_put32(out + 12, clock);
+
+  uint8_t *p = out + SENSOR_BACKFILL_HEADER_SIZE;
+  for (size_t i = 0; i < count; i++, p += SENSOR_BACKFILL_READING_SIZE)
+  {
+    sensor_packet_put32(p, records[i].time);
+    sensor_packet_put16(p + 4, (uint16_t)records[i].temperature);
+    sensor_packet_put16(p + 6, records[i].pression);
+    sensor_packet_put16(p + 8, records[i].humidite);
+    sensor_packet_put16(p + 10, 0);
+  }
+
+  return SENSOR_BACKFILL_SIZE(count);
+}
+
+/**
+ * @brief Lit l'en-tête d'un lot de rattrapage
+ * @param data Payload
+ * @param len Longueur du payload
+ * @param header Appareil, flags et séquence de la première mesure
+ * @param clock Horloge de l'appareil à l'envoi
+ * @return Nombre de mesures, -1 si ce n'est pas un lot de rattrapage valide
+ */
+static inline int sensor_backfill_decode_header(const void *data, size_t len, SensorPacket *header, uint32_t *clock)
+{
+  const uint8_t *p = (const uint8_t *)data;
+
+  if (len < SENSOR_BACKFILL_HEADER_SIZE || p[0] != SENSOR_PACKET_MAGIC || p[1] != SENSOR_BACKFILL_VERSION)
+    return -1;
+
+  int count = p[3];
+  if (count < 1 || count > SENSOR_BATCH_MAX || len != (size_t)SENSOR_BACKFILL_SIZE(count))
+    return -1;
+
+  header->version = p[1];
+  header->flags = p[2];
+  header->device_id = sensor_packet_get16(p + 4);
+  header->sequence = sensor_packet_get32(p + 8);
+  header->temperature = 0;
+  header->pression = 0;
+  header->humidite = 0;
+  *clock = sensor_packet_get32(p + 12);
+  return count;
+}
+
+/**
+ * @brief Lit la mesure index d'un lot validé par sensor_backfill_decode_header
+ */
+static inline void sensor_backfill_record(const void *data, int index, SensorRecord *record)
+{
+  const uint8_t *p = (const uint8_t *)data + SENSOR_BACKFILL_HEADER_SIZE + (size_t)index * SENSOR_BACKFILL_READING_SIZE;
+
+  record->time = sensor_packet_get32(p);
+  record->temperature = (int16_t)sensor_packet_get16(p + 4);
+  record->pression = sensor_packet_get16(p + 6);
+  record->humidite = sensor_packet_get16(p + 8);
+}
+
+static inline void sensor_stat_put(uint8_t *p, const SensorStat *stat)
+{
+  sensor_packet_put16(p, (uint16_t)stat->mean);
+  sensor_packet_put16(p + 2, (uint16_t)stat->min);
+  sensor_packet_put16(p + 4, (uint16_t)stat->max);
+  sensor_packet_put16(p + 6, stat->stddev);
+}
+
+static inline void sensor_stat_get(const uint8_t *p, SensorStat *stat)
+{
+  stat->mean = (int16_t)sensor_packet_get16(p);
+  stat->min = (int16_t)sensor_packet_get16(p + 2);
+  stat->max = (int16_t)sensor_packet_get16(p + 4);
+  stat->stddev = sensor_packet_get16(p + 6);
+}
+
+/**
+ * @brief Encode un lot de résumés
+ * @param header Appareil, flags et séquence du premier résumé (autres champs ignorés)
+ * @param summaries Résumés, du plus ancien au plus récent
+ * @param count Nombre de résumés (1..SENSOR_SUMMARY_MAX)
+ * @param out Buffer d'au moins SENSOR_SUMMARY_SIZE(count) octets
+ * @return Taille écrite, 0 si count est hors limites
+ */
+static inline size_t sensor_summary_encode(const SensorPacket *header, const SensorSummary *summaries, size_t count,
+                                           uint8_t *out)
+{
+  if (count < 1 || count > SENSOR_SUMMARY_MAX)
+    return 0;
+
+  out[0] = SENSOR_PACKET_MAGIC;
+  out[1] = SENSOR_SUMMARY_VERSION;
+  out[2] = header->flags;
+  out[3] = (uint8_t)count;
+  sensor_packet_put16(out + 4, header->device_id);
+  sensor_packet_put16(out + 6, 0);
+  sensor_packet_put32(out + 8, header->sequence);
+
+  uint8_t *p = out + SENSOR_BATCH_HEADER_SIZE;
+  for (size_t i = 0; i < count; i++, p += SENSOR_SUMMARY_READING_SIZE)
+  {
+    sensor_packet_put16(p, summaries[i].age);
+    sensor_packet_put16(p + 2, summaries[i].readings);
+    sensor_stat_put(p + 4, &summaries[i].temperature);
+    sensor_stat_put(p + 12, &summaries[i].pression);
+    sensor_stat_put(p + 20, &summaries[i].humidite);
+  }
+
+  return SENSOR_SUMMARY_SIZE(count);
+}
+
+/**
+ * @brief Lit l'en-tête d'un lot de résumés
+ * @param data Payload
+ * @param len Longueur du payload
+ * @param header Appareil, flags et séquence du premier résumé
+ * @return Nombre de résumés, -1 si ce n'est pas un lot de résumés valide
+ */
+static inline int sensor_summary_decode_header(const void *data, size_t len, SensorPacket *header)
+{
+  const uint8_t *p = (const uint8_t *)data;
+
+  if (len < SENSOR_BATCH_HEADER_SIZE || p[0] != SENSOR_PACKET_MAGIC || p[1] != SENSOR_SUMMARY_VERSION)
+    return -1;
+
+  int count = p[3];
+  if (count < 1 || count > SENSOR_SUMMARY_MAX || len != (size_t)SENSOR_SUMMARY_SIZE(count))
+    return -1;
+
+  header->version = p[1];
+  header->flags = p[2];
+  header->device_id = sensor_packet_get16(p + 4);
+  header->sequence = sensor_packet_get32(p + 8);
+  header->temperature = 0;
+  header->pression = 0;
+  header->humidite = 0;
+  return count;
+}
+
+/**
+ * @brief Lit le résumé index d'un lot validé par sensor_summary_decode_header
+ */
+static inline void sensor_summary_reading(const void *data, int index, SensorSummary *summary)
+{
+  const uint8_t *p = (const uint8_t *)data + SENSOR_BATCH_HEADER_SIZE + (size_t)index * SENSOR_SUMMARY_READING_SIZE;
+
+  summary->age = sensor_packet_get16(p);
+  summary->readings = sensor_packet_get16(p + 2);
+  sensor_stat_get(p + 4, &summary->temperature);
+  sensor_stat_get(p + 12, &summary->pression);
+  sensor_stat_get(p + 20, &summary->humidite);
+}
+
+#endif // SENSOR_PACKET_H
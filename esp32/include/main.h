@@ -7,8 +7,11 @@
 #include <PubSubClient.h>
 #include <SPI.h>
 #include <Wire.h>
+#include <sys/time.h>
+#include <esp_system.h>
 #include <Adafruit_Sensor.h>
 #include <Adafruit_BME280.h>
+#include "sensor_packet.h"
 
 // ===== CONFIG W5500 =====
 #define ETH_CS 5
@@ -24,19 +27,81 @@ extern IPAddress gateway;
 extern IPAddress subnet;
 
 // ===== CONFIG MQTT =====
+// Nom de l'appareil, unique dans la flotte (ni '/', ni '+', ni '#')
+#define DEVICE_NAME "esp32-01"
+
 extern IPAddress mqttServer;
 extern const int mqttPort;
+extern const char *deviceName;
+extern const char *mqttClientId;
 extern const char *mqttTopic;
+extern const char *backfillTopic;
 extern const int mqttQos;
 
+// ===== FORMAT DES MESURES =====
+extern const bool binaryPayload;
+extern const uint16_t deviceId;
+extern uint32_t sequenceNumber;
+
+// ===== LOT DE MESURES =====
+struct BufferedSample
+{
+  unsigned long takenAt; // millis() de la mesure (milieu de l'intervalle pour un résumé)
+  int16_t temperature;   // dixièmes de °C
+  uint16_t pression;     // dixièmes de hPa
+  uint16_t humidite;     // dixièmes de %
+  uint16_t readings;     // lectures résumées, 0 pour une lecture simple
+  SensorStat temperatureStat; // si readings > 0 ; moyennes = valeurs ci-dessus
+  SensorStat pressionStat;
+  SensorStat humiditeStat;
+};
+
+// Cumul d'un intervalle de suréchantillonnage (Welford)
+struct RunningStat
+{
+  uint32_t n;
+  double mean;
+  double m2;
+  float min;
+  float max;
+};
+
+extern const int batchSize;
+extern const unsigned long batchMaxAge;
+extern BufferedSample sampleBuffer[SENSOR_BATCH_MAX];
+extern int sampleCount;
+
+// Lots JSON : taille maximale d'un objet sérialisé, pour tenir dans SENSOR_MESSAGE_MAX
+#define JSON_READING_MAX 96  // 3 valeurs (8 caractères au plus) et age_ms
+#define JSON_SUMMARY_MAX 320 // plus n et <métrique>_min, _max, _std
+#define JSON_BATCH_MAX(entry) ((SENSOR_MESSAGE_MAX - 2) / (entry))
+
+// ===== RÉSERVE HORS CONNEXION =====
+#define BACKLOG_CAPACITY 320 // 12 octets par mesure : ~27 min à 5 s
+#define BACKLOG_MAGIC 0x424B4C47
+
+struct Backlog
+{
+  uint32_t magic;
+  uint16_t head;
+  uint16_t count;
+  uint32_t dropped;  // mesures écartées, réserve pleine
+  uint32_t replayed; // mesures rejouées depuis la mise sous tension
+  SensorRecord records[BACKLOG_CAPACITY];
+};
+
+extern Backlog backlog;
+extern const int backfillBurst;
+
 // ===== OBJETS =====
 extern EthernetClient ethClient;
 extern PubSubClient mqttClient;
 extern Adafruit_BME280 bme;
 
 // ===== TIMING =====
-extern unsigned long previousMillis;
 extern const long interval;
+extern const bool oversampling;
+extern const long fastInterval;
 extern unsigned long lastReconnectAttempt;
 extern const long reconnectInterval;
 
@@ -44,6 +109,18 @@ extern const long reconnectInterval;
 extern unsigned long consecutiveFailures;
 extern const unsigned long max_failures;
 
+// ===== TÂCHES =====
+#define SAMPLING_CORE 1 // cœur applicatif, seul avec la mesure
+#define NETWORK_CORE 0
+#define SAMPLING_TASK_STACK 4096
+#define NETWORK_TASK_STACK 8192 // JSON et lots encodés sur la pile
+
+extern QueueHandle_t sampleQueue;
+extern const int sampleQueueLength;
+extern TaskHandle_t samplingTaskHandle;
+extern TaskHandle_t networkTaskHandle;
+extern volatile uint32_t samplesLost;
+
 // ===== FONCTIONS =====
 
 /**
@@ -52,6 +129,11 @@ extern const unsigned long max_failures;
  */
 bool initEthernet();
 
+/**
+ * @brief Configure le BME280 : mode forcé sans filtre, ou mode normal suréchantillonné avec filtre IIR
+ */
+void configureBME280();
+
 /**
  * @brief Initialise la connexion avec le capteur BME280
  * @return true si l'initialisation est réussite, false sinon
@@ -85,9 +167,136 @@ void resetSystem();
 bool reconnectMQTT();
 
 /**
- * @brief Génère et envoie des données de capteurs via MQTT
+ * @brief Lit les trois métriques (tâche de mesure uniquement)
+ * @return true si la lecture est valide, false sinon
+ */
+bool readRaw(float &temperature, float &pression, float &humidite);
+
+/**
+ * @brief Lit le capteur (tâche de mesure uniquement)
+ * @param sample Mesure horodatée (millis) en dixièmes
+ * @return true si la lecture est valide, false sinon
+ */
+bool readSensor(BufferedSample &sample);
+
+void statReset(RunningStat &stat);
+void statAdd(RunningStat &stat, float value);
+
+/**
+ * @brief Moyenne, extrêmes (dixièmes) et écart-type (centièmes) de l'intervalle
+ */
+SensorStat statSummary(const RunningStat &stat);
+
+/**
+ * @brief Dépose une mesure dans sampleQueue, sans attendre (perte comptée si pleine)
+ */
+void queueSample(const BufferedSample &sample);
+
+/**
+ * @brief Boucle de suréchantillonnage : lecture toutes les fastInterval ms,
+ * un résumé par interval
+ */
+void oversamplingLoop();
+
+/**
+ * @brief Ajoute une mesure au lot en cours (tâche réseau)
+ *
+ * Buffer plein : il est d'abord déplacé dans la réserve (stashSamples).
+ */
+void addSample(const BufferedSample &sample);
+
+/**
+ * @brief Vide la file de mesures dans le lot en cours, sans attendre
+ * @return Nombre de mesures lues
+ */
+int drainSampleQueue();
+
+/**
+ * @brief Tâche de mesure : une lecture toutes les interval ms, envoyée dans sampleQueue
+ *
+ * Épinglée sur SAMPLING_CORE, priorité au-dessus de la tâche réseau : la
+ * cadence ne dépend ni de la reconnexion MQTT ni d'Ethernet.maintain().
+ */
+void samplingTask(void *param);
+
+/**
+ * @brief Tâche réseau : Ethernet, MQTT, lots, réserve et rattrapage
+ *
+ * Épinglée sur NETWORK_CORE ; seule à utiliser le W5500 et le client MQTT.
+ */
+void networkTask(void *param);
+
+/**
+ * @brief Le lot doit-il partir (batchSize mesures, ou la plus ancienne a batchMaxAge ms) ?
+ */
+bool batchReady();
+
+/**
+ * @brief Mesures par message selon le format (SENSOR_MESSAGE_MAX octets au plus)
+ */
+int messageCapacity();
+
+/**
+ * @brief Remplit un objet JSON capteur, avec "n" et <métrique>_min/_max/_std pour un résumé
+ */
+void fillJson(JsonObject entry, const BufferedSample &sample);
+
+/**
+ * @brief Publie les count premières mesures du buffer en un message
+ *
+ * Lot binaire (version 2 de sensor_packet.h, version 4 pour les résumés) si
+ * binaryPayload, tableau JSON avec "age_ms" sinon ; message d'une mesure si
+ * batchSize <= 1 sans suréchantillonnage.
+ *
+ * @return true si l'envoi a réussi, false sinon
+ */
+bool publishSamples(int count);
+
+/**
+ * @brief Envoie les mesures en attente, en autant de messages que nécessaire
+ *
+ * En cas d'échec, les mesures non envoyées restent dans le buffer.
+ *
+ * @return true si tous les envois ont réussi, false sinon
+ */
+bool flushSamples();
+
+/**
+ * @brief Horloge de l'appareil en secondes, conservée à travers les redémarrages logiciels
+ */
+uint32_t deviceClock();
+
+/**
+ * @brief Valide la réserve en RTC RAM, vidée à la mise sous tension
+ */
+void initBacklog();
+
+/**
+ * @brief Déplace les mesures en attente dans la réserve, datées par deviceClock()
+ *
+ * Réserve pleine : les mesures les plus anciennes sont écartées.
+ */
+void stashSamples();
+
+/**
+ * @brief Rejoue la réserve sur backfillTopic, au plus backfillBurst messages
+ *
+ * Lots de rattrapage (version 3 de sensor_packet.h) si binaryPayload,
+ * tableaux JSON avec "age_ms" sinon. Une mesure ne quitte la réserve
+ * qu'une fois son message envoyé.
+ *
+ * @return true si tous les envois ont réussi, false sinon
+ */
+bool replayBacklog();
+
+/**
+ * @brief Envoie une mesure seule via MQTT
+ *
+ * Paquet binaire de SENSOR_PACKET_SIZE octets si binaryPayload, JSON sinon.
+ *
+ * @param sample Mesure à envoyer (séquence : sequenceNumber)
  * @return true si l'envoi a réussi, false sinon
  */
-bool sendSensorData();
+bool sendSensorData(const BufferedSample &sample);
 
 #endif // ESP32_MQTT_PUBLISHER_H
\ No newline at end of file
@@ -1,5 +1,10 @@
 #include "main.h"
 
+// Tout lot binaire tient dans un emplacement de la file du serveur
+static_assert(SENSOR_BATCH_SIZE(SENSOR_BATCH_MAX) <= SENSOR_MESSAGE_MAX, "lot binaire trop long");
+static_assert(SENSOR_SUMMARY_SIZE(SENSOR_SUMMARY_MAX) <= SENSOR_MESSAGE_MAX, "lot de résumés trop long");
+static_assert(SENSOR_BACKFILL_SIZE(SENSOR_BATCH_MAX) <= SENSOR_MESSAGE_MAX, "lot de rattrapage trop long");
+
 // ===== DÉFINITION DES VARIABLES GLOBALES =====
 byte mac[] = {0xDE, 0xAD, 0xBE, 0xEF, 0xFE, 0xED};
 IPAddress ip(192, 168, 69, 2);
@@ -8,21 +13,51 @@ IPAddress subnet(255, 255, 255, 0);
 
 IPAddress mqttServer(192, 168, 69, 1);
 const int mqttPort = 1883;
-const char *mqttTopic = "esp32/data";
+// Le serveur identifie l'appareil par ce niveau de topic (esp32/+/data)
+const char *deviceName = DEVICE_NAME;
+const char *mqttClientId = "ESP32_" DEVICE_NAME;
+const char *mqttTopic = "esp32/" DEVICE_NAME "/data";
+const char *backfillTopic = "esp32/" DEVICE_NAME "/backfill";
 const int mqttQoS = 1;
 
+// Paquet binaire de 16 octets (sensor_packet.h) au lieu d'un JSON d'environ 55 octets
+const bool binaryPayload = true;
+const uint16_t deviceId = 0;
+uint32_t sequenceNumber = 0;
+
+// Lot : batchSize mesures par message, envoyé au plus tard batchMaxAge ms après la plus ancienne
+const int batchSize = 6;
+const unsigned long batchMaxAge = 30000;
+BufferedSample sampleBuffer[SENSOR_BATCH_MAX];
+int sampleCount = 0;
+
+// Mesures non envoyées pendant une coupure : en RTC RAM, conservées par resetSystem()
+RTC_NOINIT_ATTR Backlog backlog;
+const int backfillBurst = 2;
+
 EthernetClient ethClient;
 PubSubClient mqttClient(ethClient);
 Adafruit_BME280 bme;
 
-unsigned long previousMillis = 0;
 const long interval = 5000;
+
+// Suréchantillonnage : lecture toutes les fastInterval ms en mode normal (filtre IIR),
+// un résumé (moyenne, min, max, écart-type) publié par interval
+const bool oversampling = true;
+const long fastInterval = 50;
 unsigned long lastReconnectAttempt = 0;
 const long reconnectInterval = 15000;
 
 unsigned long consecutiveFailures = 0;
 const unsigned long max_failures = 3;
 
+// Mesure (cœur 1) et réseau (cœur 0) découplés par une file FreeRTOS
+QueueHandle_t sampleQueue = NULL;
+const int sampleQueueLength = 64;
+TaskHandle_t samplingTaskHandle = NULL;
+TaskHandle_t networkTaskHandle = NULL;
+volatile uint32_t samplesLost = 0;
+
 // ===== IMPLÉMENTATION DES FONCTIONS =====
 
 bool initEthernet()
@@ -49,6 +84,27 @@ bool initEthernet()
   return true;
 }
 
+void configureBME280()
+{
+  if (oversampling)
+  {
+    // ~46 ms par conversion (T x2, P x16, H x1) : ~21 Hz en continu
+    bme.setSampling(Adafruit_BME280::MODE_NORMAL,
+                    Adafruit_BME280::SAMPLING_X2,
+                    Adafruit_BME280::SAMPLING_X16,
+                    Adafruit_BME280::SAMPLING_X1,
+                    Adafruit_BME280::FILTER_X4,
+                    Adafruit_BME280::STANDBY_MS_0_5);
+    return;
+  }
+
+  bme.setSampling(Adafruit_BME280::MODE_FORCED,
+                  Adafruit_BME280::SAMPLING_X1,
+                  Adafruit_BME280::SAMPLING_X1,
+                  Adafruit_BME280::SAMPLING_X1,
+                  Adafruit_BME280::FILTER_OFF);
+}
+
 bool initBME280()
 {
   Serial.println("Initialisation du BME280...");
@@ -57,11 +113,7 @@ bool initBME280()
   {
     Serial.println("BME280 détecté à l'adresse 0x76");
 
-    bme.setSampling(Adafruit_BME280::MODE_FORCED,
-                    Adafruit_BME280::SAMPLING_X1,
-                    Adafruit_BME280::SAMPLING_X1,
-                    Adafruit_BME280::SAMPLING_X1,
-                    Adafruit_BME280::FILTER_OFF);
+    configureBME280();
     return true;
   }
 
@@ -69,11 +121,7 @@ bool initBME280()
   {
     Serial.println("BME280 détecté à l'adresse 0x77");
 
-    bme.setSampling(Adafruit_BME280::MODE_FORCED,
-                    Adafruit_BME280::SAMPLING_X1,
-                    Adafruit_BME280::SAMPLING_X1,
-                    Adafruit_BME280::SAMPLING_X1,
-                    Adafruit_BME280::FILTER_OFF);
+    configureBME280();
     return true;
   }
 
@@ -85,7 +133,8 @@ void setupMQTT()
 {
   mqttClient.setServer(mqttServer, mqttPort);
 
-  mqttClient.setBufferSize(512);
+  // Message (SENSOR_MESSAGE_MAX au plus), plus l'en-tête MQTT et le topic
+  mqttClient.setBufferSize(SENSOR_MESSAGE_MAX + 128);
 
   Serial.println("MQTT configuré");
 }
@@ -141,6 +190,10 @@ void resetSystem()
 {
   Serial.println("\nRESET COMPLET DU SYSTÈME");
 
+  // Le buffer en RAM et la file seraient perdus : ils rejoignent la réserve en RTC RAM
+  drainSampleQueue();
+  stashSamples();
+
   Serial.println("  Fermeture MQTT...");
   mqttClient.disconnect();
   delay(500);
@@ -170,7 +223,7 @@ bool reconnectMQTT()
       checkNetworkStatus();
       Serial.print("Connexion au broker MQTT...");
 
-      if (mqttClient.connect("ESP32_Publisher"))
+      if (mqttClient.connect(mqttClientId))
       {
         Serial.println("OK !");
         consecutiveFailures = 0;
@@ -198,13 +251,15 @@ bool reconnectMQTT()
   return mqttClient.connected();
 }
 
-bool sendSensorData()
+bool readRaw(float &temperature, float &pression, float &humidite)
 {
-  bme.takeForcedMeasurement();
+  // Mode normal : le capteur convertit en continu, on lit la dernière conversion filtrée
+  if (!oversampling)
+    bme.takeForcedMeasurement();
 
-  float temperature = bme.readTemperature();
-  float pression = bme.readPressure() / 100.0F;
-  float humidite = bme.readHumidity();
+  temperature = bme.readTemperature();
+  pression = bme.readPressure() / 100.0F;
+  humidite = bme.readHumidity();
 
   if (isnan(temperature) || isnan(pression) || isnan(humidite))
   {
@@ -212,29 +267,494 @@ bool sendSensorData()
     return false;
   }
 
+  return true;
+}
+
+bool readSensor(BufferedSample &sample)
+{
+  float temperature, pression, humidite;
+
+  sample.takenAt = millis();
+  if (!readRaw(temperature, pression, humidite))
+    return false;
+
+  sample.temperature = (int16_t)lroundf(temperature * 10);
+  sample.pression = (uint16_t)lroundf(pression * 10);
+  sample.humidite = (uint16_t)lroundf(humidite * 10);
+  sample.readings = 0;
+  return true;
+}
+
+void statReset(RunningStat &stat)
+{
+  stat.n = 0;
+  stat.mean = 0;
+  stat.m2 = 0;
+  stat.min = INFINITY;
+  stat.max = -INFINITY;
+}
+
+void statAdd(RunningStat &stat, float value)
+{
+  // Welford : stable numériquement, une passe, sans garder les lectures
+  stat.n++;
+  double delta = value - stat.mean;
+  stat.mean += delta / stat.n;
+  stat.m2 += delta * (value - stat.mean);
+  stat.min = min(stat.min, value);
+  stat.max = max(stat.max, value);
+}
+
+SensorStat statSummary(const RunningStat &stat)
+{
+  SensorStat summary;
+  double stddev = (stat.n > 1) ? sqrt(stat.m2 / (stat.n - 1)) : 0.0;
+
+  summary.mean = (int16_t)lround(stat.mean * 10);
+  summary.min = (int16_t)lroundf(stat.min * 10);
+  summary.max = (int16_t)lroundf(stat.max * 10);
+  summary.stddev = (uint16_t)min(lround(stddev * 100), 65535L);
+  return summary;
+}
+
+void addSample(const BufferedSample &sample)
+{
+  // Buffer plein (envois en échec) : il rejoint la réserve
+  int capacity = min(max(batchSize, 1), SENSOR_BATCH_MAX);
+  if (sampleCount == capacity)
+    stashSamples();
+
+  sampleBuffer[sampleCount++] = sample;
+}
+
+int drainSampleQueue()
+{
+  BufferedSample sample;
+  int n = 0;
+
+  while (xQueueReceive(sampleQueue, &sample, 0) == pdTRUE)
+  {
+    addSample(sample);
+    n++;
+  }
+
+  return n;
+}
+
+void queueSample(const BufferedSample &sample)
+{
+  // Tâche réseau bloquée trop longtemps : la mesure est perdue, pas la cadence
+  if (xQueueSend(sampleQueue, &sample, 0) != pdTRUE)
+    samplesLost++;
+}
+
+void oversamplingLoop()
+{
+  TickType_t lastWake = xTaskGetTickCount();
+  unsigned long windowStart = millis();
+  RunningStat temperature, pression, humidite;
+
+  statReset(temperature);
+  statReset(pression);
+  statReset(humidite);
+
+  while (true)
+  {
+    vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(fastInterval));
+
+    float t, p, h;
+    if (readRaw(t, p, h))
+    {
+      statAdd(temperature, t);
+      statAdd(pression, p);
+      statAdd(humidite, h);
+    }
+
+    unsigned long now = millis();
+    if (now - windowStart < (unsigned long)interval)
+      continue;
+
+    if (temperature.n > 0)
+    {
+      // Daté au milieu de l'intervalle, instant représentatif de la moyenne
+      BufferedSample sample;
+      sample.takenAt = windowStart + (now - windowStart) / 2;
+      sample.readings = (uint16_t)(temperature.n > 65535 ? 65535 : temperature.n);
+      sample.temperatureStat = statSummary(temperature);
+      sample.pressionStat = statSummary(pression);
+      sample.humiditeStat = statSummary(humidite);
+      sample.temperature = sample.temperatureStat.mean;
+      sample.pression = (uint16_t)sample.pressionStat.mean;
+      sample.humidite = (uint16_t)sample.humiditeStat.mean;
+      queueSample(sample);
+    }
+
+    windowStart = now;
+    statReset(temperature);
+    statReset(pression);
+    statReset(humidite);
+  }
+}
+
+void samplingTask(void *param)
+{
+  (void)param;
+
+  if (oversampling)
+    oversamplingLoop();
+
+  TickType_t lastWake = xTaskGetTickCount();
+
+  while (true)
+  {
+    // Période absolue : ni la durée de la mesure ni le réseau ne la décalent
+    vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(interval));
+
+    BufferedSample sample;
+    if (readSensor(sample))
+      queueSample(sample);
+  }
+}
+
+void networkTask(void *param)
+{
+  (void)param;
+  uint32_t reportedLost = 0;
+
+  while (true)
+  {
+    Ethernet.maintain();
+
+    reconnectMQTT();
+
+    mqttClient.loop();
+
+    // Réveil dès qu'une mesure arrive, sinon toutes les 50 ms pour MQTT
+    BufferedSample sample;
+    if (xQueueReceive(sampleQueue, &sample, pdMS_TO_TICKS(50)) == pdTRUE)
+    {
+      addSample(sample);
+      drainSampleQueue();
+    }
+
+    if (samplesLost != reportedLost)
+    {
+      reportedLost = samplesLost;
+      Serial.printf("ATTENTION : %lu mesures perdues, file pleine\n", (unsigned long)reportedLost);
+    }
+
+    if (batchReady())
+    {
+      if (mqttClient.connected())
+      {
+        flushSamples();
+      }
+      else
+      {
+        stashSamples();
+      }
+    }
+
+    // Direct d'abord : la réserve est rejouée par rafales entre deux lots
+    if (backlog.count > 0 && mqttClient.connected() && sampleCount < batchSize)
+    {
+      replayBacklog();
+    }
+  }
+}
+
+bool batchReady()
+{
+  if (sampleCount == 0)
+    return false;
+
+  return sampleCount >= batchSize || millis() - sampleBuffer[0].takenAt >= batchMaxAge;
+}
+
+int messageCapacity()
+{
+  // Le serveur ignore les messages de plus de SENSOR_MESSAGE_MAX octets
+  if (!binaryPayload)
+    return JSON_BATCH_MAX(oversampling ? JSON_SUMMARY_MAX : JSON_READING_MAX);
+  if (oversampling)
+    return SENSOR_SUMMARY_MAX;
+  return (batchSize <= 1) ? 1 : SENSOR_BATCH_MAX;
+}
+
+void fillJson(JsonObject entry, const BufferedSample &sample)
+{
+  entry["temperature"] = sample.temperature / 10.0;
+  entry["pression"] = sample.pression / 10.0;
+  entry["humidite"] = sample.humidite / 10.0;
+
+  if (sample.readings == 0)
+    return;
+
+  const char *names[3] = {"temperature", "pression", "humidite"};
+  const SensorStat *stats[3] = {&sample.temperatureStat, &sample.pressionStat, &sample.humiditeStat};
+  char key[24];
+
+  entry["n"] = sample.readings;
+  for (int m = 0; m < 3; m++)
+  {
+    snprintf(key, sizeof(key), "%s_min", names[m]);
+    entry[key] = stats[m]->min / 10.0;
+    snprintf(key, sizeof(key), "%s_max", names[m]);
+    entry[key] = stats[m]->max / 10.0;
+    snprintf(key, sizeof(key), "%s_std", names[m]);
+    entry[key] = stats[m]->stddev / 100.0;
+  }
+}
+
+bool publishSamples(int count)
+{
+  unsigned long now = millis();
+
+  if (count == 1 && batchSize <= 1 && !oversampling)
+    return sendSensorData(sampleBuffer[0]);
+
+  if (binaryPayload)
+  {
+    SensorPacket header;
+    header.flags = (sequenceNumber == 0) ? SENSOR_FLAG_BOOT : 0;
+    header.device_id = deviceId;
+    header.sequence = sequenceNumber;
+
+    // 908 octets : couvre aussi SENSOR_BATCH_SIZE(SENSOR_BATCH_MAX)
+    uint8_t buffer[SENSOR_SUMMARY_SIZE(SENSOR_SUMMARY_MAX)];
+    size_t len;
+
+    if (oversampling)
+    {
+      SensorSummary summaries[SENSOR_SUMMARY_MAX];
+      for (int i = 0; i < count; i++)
+      {
+        unsigned long age = (now - sampleBuffer[i].takenAt + 50) / 100;
+        summaries[i].age = (uint16_t)min(age, 65535UL);
+        summaries[i].readings = sampleBuffer[i].readings;
+        summaries[i].temperature = sampleBuffer[i].temperatureStat;
+        summaries[i].pression = sampleBuffer[i].pressionStat;
+        summaries[i].humidite = sampleBuffer[i].humiditeStat;
+      }
+      len = sensor_summary_encode(&header, summaries, count, buffer);
+    }
+    else
+    {
+      SensorReading readings[SENSOR_BATCH_MAX];
+      for (int i = 0; i < count; i++)
+      {
+        // Ancienneté en dixièmes de seconde, plafonnée à ~109 min
+        unsigned long age = (now - sampleBuffer[i].takenAt + 50) / 100;
+        readings[i].age = (uint16_t)min(age, 65535UL);
+        readings[i].temperature = sampleBuffer[i].temperature;
+        readings[i].pression = sampleBuffer[i].pression;
+        readings[i].humidite = sampleBuffer[i].humidite;
+      }
+      len = sensor_batch_encode(&header, readings, count, buffer);
+    }
+
+    Serial.print("\n=== Envoi ===\n");
+    Serial.printf("Lot #%lu : %d %s (%u octets)\n", (unsigned long)header.sequence, count,
+                  oversampling ? "résumés" : "mesures", (unsigned)len);
+
+    return mqttClient.publish(mqttTopic, buffer, len, false);
+  }
+
   JsonDocument doc;
-  doc["temperature"] = round(temperature * 10) / 10.0;
-  doc["pression"] = round(pression * 10) / 10.0;
-  doc["humidite"] = round(humidite * 10) / 10.0;
+  JsonArray array = doc.to<JsonArray>();
+
+  for (int i = 0; i < count; i++)
+  {
+    JsonObject entry = array.add<JsonObject>();
+    fillJson(entry, sampleBuffer[i]);
+    entry["age_ms"] = now - sampleBuffer[i].takenAt;
+  }
 
-  char jsonBuffer[256];
-  serializeJson(doc, jsonBuffer);
+  String json;
+  serializeJson(doc, json);
 
   Serial.print("\n=== Envoi ===\n");
-  Serial.println(jsonBuffer);
+  Serial.printf("Lot de %d mesures (%u octets)\n", count, (unsigned)json.length());
 
-  bool success = mqttClient.publish(mqttTopic, jsonBuffer, false);
+  return mqttClient.publish(mqttTopic, json.c_str(), false);
+}
 
-  if (success)
+bool flushSamples()
+{
+  while (sampleCount > 0)
   {
-    Serial.println("=== Envoyé ===");
-    return true;
+    int count = min(sampleCount, messageCapacity());
+
+    if (!publishSamples(count))
+    {
+      // Mesures conservées : renvoyées avec le lot suivant
+      Serial.println("=== Échec ===");
+      return false;
+    }
+
+    // Séquence du message suivant : celle de la mesure qui suit la dernière envoyée
+    sequenceNumber += count;
+    sampleCount -= count;
+    memmove(sampleBuffer, sampleBuffer + count, sampleCount * sizeof(BufferedSample));
+  }
+
+  Serial.println("=== Envoyé ===");
+  return true;
+}
+
+uint32_t deviceClock()
+{
+  // Temps système : continue à travers ESP.restart(), repart de 0 à la mise sous tension
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (uint32_t)tv.tv_sec;
+}
+
+void initBacklog()
+{
+  // Mise sous tension : contenu RTC indéfini, et l'horloge de l'appareil est repartie de 0
+  if (esp_reset_reason() == ESP_RST_POWERON || backlog.magic != BACKLOG_MAGIC ||
+      backlog.head >= BACKLOG_CAPACITY || backlog.count > BACKLOG_CAPACITY)
+  {
+    memset(&backlog, 0, sizeof(backlog));
+    backlog.magic = BACKLOG_MAGIC;
+  }
+
+  if (backlog.count > 0)
+    Serial.printf("Réserve : %u mesures à rejouer\n", (unsigned)backlog.count);
+}
+
+void stashSamples()
+{
+  if (sampleCount == 0)
+    return;
+
+  uint32_t clock = deviceClock();
+  unsigned long now = millis();
+
+  for (int i = 0; i < sampleCount; i++)
+  {
+    // Réserve pleine : la plus ancienne mesure est écartée
+    if (backlog.count == BACKLOG_CAPACITY)
+    {
+      backlog.head = (backlog.head + 1) % BACKLOG_CAPACITY;
+      backlog.count--;
+      backlog.dropped++;
+    }
+
+    SensorRecord &record = backlog.records[(backlog.head + backlog.count) % BACKLOG_CAPACITY];
+    record.time = clock - (uint32_t)((now - sampleBuffer[i].takenAt) / 1000);
+    record.temperature = sampleBuffer[i].temperature;
+    record.pression = sampleBuffer[i].pression;
+    record.humidite = sampleBuffer[i].humidite;
+    backlog.count++;
+  }
+
+  Serial.printf("MQTT déconnecté - %d mesures mises en réserve (%u/%d)\n", sampleCount, (unsigned)backlog.count,
+                BACKLOG_CAPACITY);
+
+  sequenceNumber += sampleCount;
+  sampleCount = 0;
+}
+
+bool replayBacklog()
+{
+  int chunk = binaryPayload ? SENSOR_BATCH_MAX : JSON_BATCH_MAX(JSON_READING_MAX);
+
+  for (int burst = 0; burst < backfillBurst && backlog.count > 0; burst++)
+  {
+    int count = min((int)backlog.count, chunk);
+    SensorRecord records[SENSOR_BATCH_MAX];
+    for (int i = 0; i < count; i++)
+      records[i] = backlog.records[(backlog.head + i) % BACKLOG_CAPACITY];
+
+    uint32_t clock = deviceClock();
+    bool success;
+
+    if (binaryPayload)
+    {
+      SensorPacket header;
+      header.flags = 0;
+      header.device_id = deviceId;
+      header.sequence = backlog.replayed;
+
+      uint8_t backfillBuffer[SENSOR_BACKFILL_SIZE(SENSOR_BATCH_MAX)];
+      size_t len = sensor_backfill_encode(&header, clock, records, count, backfillBuffer);
+      success = mqttClient.publish(backfillTopic, backfillBuffer, len, false);
+    }
+    else
+    {
+      JsonDocument doc;
+      JsonArray array = doc.to<JsonArray>();
+
+      for (int i = 0; i < count; i++)
+      {
+        JsonObject entry = array.add<JsonObject>();
+        entry["temperature"] = records[i].temperature / 10.0;
+        entry["pression"] = records[i].pression / 10.0;
+        entry["humidite"] = records[i].humidite / 10.0;
+        entry["age_ms"] = (uint64_t)(clock - records[i].time) * 1000;
+      }
+
+      String json;
+      serializeJson(doc, json);
+      success = mqttClient.publish(backfillTopic, json.c_str(), false);
+    }
+
+    if (!success)
+    {
+      Serial.println("=== Échec rattrapage ===");
+      return false;
+    }
+
+    backlog.head = (backlog.head + count) % BACKLOG_CAPACITY;
+    backlog.count -= count;
+    backlog.replayed += count;
+
+    Serial.printf("Rattrapage : %d mesures envoyées, %u restantes\n", count, (unsigned)backlog.count);
+  }
+
+  return true;
+}
+
+bool sendSensorData(const BufferedSample &sample)
+{
+  bool success;
+
+  if (binaryPayload)
+  {
+    SensorPacket packet;
+    packet.flags = (sequenceNumber == 0) ? SENSOR_FLAG_BOOT : 0;
+    packet.device_id = deviceId;
+    packet.sequence = sequenceNumber;
+    packet.temperature = sample.temperature;
+    packet.pression = sample.pression;
+    packet.humidite = sample.humidite;
+
+    uint8_t packetBuffer[SENSOR_PACKET_SIZE];
+    size_t len = sensor_packet_encode(&packet, packetBuffer);
+
+    Serial.print("\n=== Envoi ===\n");
+    Serial.printf("#%lu : %.1f °C, %.1f hPa, %.1f %% (%u octets)\n", (unsigned long)packet.sequence,
+                  packet.temperature / 10.0, packet.pression / 10.0, packet.humidite / 10.0, (unsigned)len);
+
+    success = mqttClient.publish(mqttTopic, packetBuffer, len, false);
   }
   else
   {
-    Serial.println("=== Échec ===");
-    return false;
+    JsonDocument doc;
+    fillJson(doc.to<JsonObject>(), sample);
+
+    char jsonBuffer[256];
+    serializeJson(doc, jsonBuffer);
+
+    Serial.print("\n=== Envoi ===\n");
+    Serial.println(jsonBuffer);
+
+    success = mqttClient.publish(mqttTopic, jsonBuffer, false);
   }
+
+  return success;
 }
 
 // ===== SETUP ET LOOP =====
@@ -247,6 +767,8 @@ void setup()
   Serial.println("\n=== ESP32 Publisher MQTT ===");
 
   Wire.begin();
+  // Lectures à ~20 Hz : bus I2C en mode rapide
+  Wire.setClock(400000);
 
   if (!initBME280())
   {
@@ -262,38 +784,40 @@ void setup()
       delay(1000);
   }
 
+  initBacklog();
+
   displayNetworkInfo();
   setupMQTT();
 
   Serial.printf("\nConfiguration :\n");
-  Serial.printf("  - Intervalle envoi : %lu ms\n", interval);
+  Serial.printf("  - Appareil : %s (topic %s)\n", deviceName, mqttTopic);
+  Serial.printf("  - Intervalle mesure : %lu ms\n", interval);
+  if (oversampling)
+    Serial.printf("  - Suréchantillonnage : lecture toutes les %lu ms, résumé par intervalle\n", fastInterval);
+  Serial.printf("  - Lot : %d mesures, %lu ms max\n", batchSize, batchMaxAge);
+  Serial.printf("  - Réserve hors connexion : %d mesures\n", BACKLOG_CAPACITY);
   Serial.printf("  - Intervalle reconnexion : %lu ms\n", reconnectInterval);
-  Serial.printf("  - Max échecs avant reset : %lu\n\n", max_failures);
+  Serial.printf("  - Max échecs avant reset : %lu\n", max_failures);
+  Serial.printf("  - Tâches : mesure cœur %d, réseau cœur %d\n\n", SAMPLING_CORE, NETWORK_CORE);
+
+  sampleQueue = xQueueCreate(sampleQueueLength, sizeof(BufferedSample));
+  if (!sampleQueue)
+  {
+    Serial.println("Système en pause - file de mesures non allouée");
+    while (true)
+      delay(1000);
+  }
+
+  // Bus I2C réservé à la tâche de mesure, SPI (W5500) à la tâche réseau
+  xTaskCreatePinnedToCore(networkTask, "network", NETWORK_TASK_STACK, NULL, 1, &networkTaskHandle, NETWORK_CORE);
+  xTaskCreatePinnedToCore(samplingTask, "sampling", SAMPLING_TASK_STACK, NULL, 2, &samplingTaskHandle,
+                          SAMPLING_CORE);
 
   Serial.println("Prêt à envoyer des données...");
 }
 
 void loop()
 {
-  Ethernet.maintain();
-
-  reconnectMQTT();
-
-  mqttClient.loop();
-
-  unsigned long currentMillis = millis();
-
-  if (currentMillis - previousMillis >= interval)
-  {
-    previousMillis = currentMillis;
-
-    if (mqttClient.connected())
-    {
-      sendSensorData();
-    }
-    else
-    {
-      Serial.println("MQTT déconnecté - en attente de reconnexion...");
-    }
-  }
+  // Tout tourne dans samplingTask et networkTask
+  vTaskDelete(NULL);
 }
\ No newline at end of file
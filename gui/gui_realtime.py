@@ -3,6 +3,7 @@ from PyQt5.QtWidgets import (QWidget, QVBoxLayout, QHBoxLayout, QLabel,
 from PyQt5.QtCore import Qt, QThread, pyqtSignal
 import paho.mqtt.client as mqtt
 import json
+import socket
 import requests
 
 lat, lon = 48.856667, 2.350987
@@ -33,13 +34,16 @@ humidite = data["hourly"]["relativehumidity_2m"][0]
 class MQTTThread(QThread):
     """Thread pour gérer la connexion MQTT sans bloquer l'interface"""
     message_received = pyqtSignal(str)
+    stats_received = pyqtSignal(str)
     connection_status = pyqtSignal(bool, str)
     
-    def __init__(self, host, port, topic):
+    def __init__(self, host, port, topic, stats_topic=None, latest_topic=None):
         super().__init__()
         self.host = host
         self.port = port
         self.topic = topic
+        self.stats_topic = stats_topic
+        self.latest_topic = latest_topic
         self.client = None
         self.running = False
     
@@ -47,6 +51,11 @@ class MQTTThread(QThread):
         if rc == 0:
             self.connection_status.emit(True, "Connecté")
             client.subscribe(self.topic)
+            if self.stats_topic:
+                client.subscribe(self.stats_topic)
+            if self.latest_topic:
+                # Dernière mesure retenue : affichée dès la connexion
+                client.subscribe(self.latest_topic)
         else:
             self.connection_status.emit(False, f"Erreur de connexion ({rc})")
     
@@ -54,7 +63,15 @@ class MQTTThread(QThread):
         try:
             message = msg.payload.decode('utf-8')
             data = json.loads(message)
-            self.message_received.emit(json.dumps(data))
+            if self.latest_topic and mqtt.topic_matches_sub(self.latest_topic, msg.topic):
+                # Seul l'état retenu sert ; la suite arrive sur le topic principal
+                client.unsubscribe(self.latest_topic)
+                if msg.retain:
+                    self.message_received.emit(json.dumps(data))
+            elif self.stats_topic and mqtt.topic_matches_sub(self.stats_topic, msg.topic):
+                self.stats_received.emit(json.dumps(data))
+            else:
+                self.message_received.emit(json.dumps(data))
         except json.JSONDecodeError as e:
             self.message_received.emit(f"Erreur JSON : {str(e)}")
         except Exception as e:
@@ -82,6 +99,65 @@ class MQTTThread(QThread):
             self.client.disconnect()
             self.client.loop_stop()
 
+class FanoutThread(QThread):
+    """Lecture de la diffusion locale du serveur C (socket Unix, une trame par ligne)"""
+    message_received = pyqtSignal(str)
+    stats_received = pyqtSignal(str)
+    connection_status = pyqtSignal(bool, str)
+
+    def __init__(self, socket_path, topic, stats_topic=None, latest_topic=None):
+        super().__init__()
+        self.socket_path = socket_path
+        self.topic = topic
+        self.stats_topic = stats_topic
+        self.latest_topic = latest_topic
+        self.sock = None
+        self.running = False
+
+    def dispatch(self, line):
+        topic, _, message = line.partition(" ")
+        try:
+            data = json.loads(message)
+        except json.JSONDecodeError as e:
+            self.message_received.emit(f"Erreur JSON : {str(e)}")
+            return
+
+        if self.latest_topic and mqtt.topic_matches_sub(self.latest_topic, topic):
+            # Première trame : dernière mesure rejouée à l'abonnement, la suite arrive sur le topic principal
+            self.latest_topic = None
+            self.message_received.emit(json.dumps(data))
+        elif self.stats_topic and mqtt.topic_matches_sub(self.stats_topic, topic):
+            self.stats_received.emit(json.dumps(data))
+        elif mqtt.topic_matches_sub(self.topic, topic):
+            self.message_received.emit(json.dumps(data))
+
+    def run(self):
+        self.running = True
+        try:
+            self.sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+            self.sock.connect(self.socket_path)
+            for topic in (self.topic, self.stats_topic, self.latest_topic):
+                if topic:
+                    self.sock.sendall(f"SUB {topic}\n".encode('utf-8'))
+            self.connection_status.emit(True, "Connecté (socket locale)")
+
+            for line in self.sock.makefile('r', encoding='utf-8'):
+                self.dispatch(line.rstrip("\n"))
+            self.connection_status.emit(False, "Déconnecté")
+        except Exception as e:
+            # Socket fermée par stop() : simple déconnexion
+            self.connection_status.emit(False, "Déconnecté" if not self.running else f"Erreur : {str(e)}")
+        self.running = False
+
+    def stop(self):
+        self.running = False
+        if self.sock:
+            try:
+                self.sock.shutdown(socket.SHUT_RDWR)
+            except OSError:
+                pass
+            self.sock.close()
+
 class RealtimeTab(QWidget):
     """
     Onglet 1: Affichage des données en temps réel via MQTT
@@ -98,14 +174,9 @@ class RealtimeTab(QWidget):
         self.mqtt_config = {
             'host': None,
             'port': None,
-            'topic': None
+            'topic': None,
+            'socket': None
         }
-        self.data_history = {
-            'temperature': [],
-            'pression': [],
-            'humidite': []
-        }
-        self.max_history = 2160
         self.init_ui()
     
     def init_ui(self):
@@ -235,14 +306,29 @@ class RealtimeTab(QWidget):
         else:
             self.connect_mqtt()
     
+    @staticmethod
+    def derived_topic(topic, suffix):
+        """Topic voisin publié par le serveur C : /window ([window]), /latest ([republish])"""
+        if topic and topic.endswith("/data"):
+            return topic[:-len("/data")] + suffix
+        return None
+
     def connect_mqtt(self):
         try:
-            self.mqtt_thread = MQTTThread(
-                self.mqtt_config['host'],
-                self.mqtt_config['port'],
-                self.mqtt_config['topic']
-            )
+            derived = (self.derived_topic(self.mqtt_config['topic'], "/window"),
+                       self.derived_topic(self.mqtt_config['topic'], "/latest"))
+            if self.mqtt_config['socket']:
+                # Serveur C sur la même machine : pas de connexion au broker
+                self.mqtt_thread = FanoutThread(self.mqtt_config['socket'], self.mqtt_config['topic'], *derived)
+            else:
+                self.mqtt_thread = MQTTThread(
+                    self.mqtt_config['host'],
+                    self.mqtt_config['port'],
+                    self.mqtt_config['topic'],
+                    *derived
+                )
             self.mqtt_thread.message_received.connect(self.display_message)
+            self.mqtt_thread.stats_received.connect(self.display_stats)
             self.mqtt_thread.connection_status.connect(self.update_connection_status)
             self.mqtt_thread.start()
         except Exception as e:
@@ -254,10 +340,11 @@ class RealtimeTab(QWidget):
             self.mqtt_thread.wait()
             self.mqtt_thread = None
             
-    def update_mqtt_config(self, host, port, topic):
+    def update_mqtt_config(self, host, port, topic, socket_path=None):
         self.mqtt_config['host'] = host
         self.mqtt_config['port'] = port
         self.mqtt_config['topic'] = topic
+        self.mqtt_config['socket'] = socket_path or None
     
     def update_connection_status(self, connected, message):
         self.is_connected = connected
@@ -268,52 +355,39 @@ class RealtimeTab(QWidget):
         try:
             data = json.loads(message)
 
-            key_mapping = {
-                0: None,
-                1: 'temperature',
-                2: 'pression',
-                3: 'humidite'
-            }
-
             for i, (key, value) in enumerate(data.items()):
                 if i < len(self.data_labels):
                     self.data_labels[i][1].setText(value)
 
-                    if i != 0 and key_mapping[i]:
-                        data_key = key_mapping[i]
-                        try:
-                            num_value = float(value)
-
-                            self.data_history[data_key].append(num_value)
-                            if len(self.data_history[data_key]) > self.max_history:
-                                self.data_history[data_key].pop(0)
-
-                            values = self.data_history[data_key]
-                            if len(values) > 0:
-                                moy = sum(values) / len(values)
-                                max_val = max(values)
-                                min_val = min(values)
-
-                                self.stats_labels[i][1].setText(f"{moy:.2f}")
-                                self.stats_labels[i][2].setText(f"{max_val:.2f}")
-                                self.stats_labels[i][3].setText(f"{min_val:.2f}")
-                        except ValueError:
-                            self.stats_labels[i][2].setText("-")
-                            self.stats_labels[i][3].setText("-")
-                            self.stats_labels[i][4].setText("-")
-                        
         except json.JSONDecodeError as e:
             self.data_labels[0][1].setText(f"Erreur JSON : {str(e)}")
     
+    def display_stats(self, message):
+        """
+        Statistiques calculées par le serveur sur fenêtres glissantes :
+        la plus large (3 h par défaut) remplace l'historique de 2160 mesures
+        """
+        try:
+            data = json.loads(message)
+            windows = data.get("windows", [])
+            if not windows:
+                return
+
+            window = max(windows, key=lambda w: w["window_s"])
+            for i, key in enumerate(['temperature', 'pression', 'humidite'], start=1):
+                metric = window[key]
+                self.stats_labels[i][1].setText(f"{metric['mean']:.2f}")
+                self.stats_labels[i][2].setText(f"{metric['max']:.2f}")
+                self.stats_labels[i][3].setText(f"{metric['min']:.2f}")
+        except (json.JSONDecodeError, KeyError, TypeError):
+            for i in range(1, 4):
+                for j in range(1, 4):
+                    self.stats_labels[i][j].setText("-")
+
     def clear_display(self):
         for i in range(4):
             self.data_labels[i][1].setText("-")
         
-        self.data_history = {
-            'temperature': [],
-            'pression': [],
-            'humidite': []
-        }
         for i in range(1, 4):
             for j in range(1, 4):
                 self.stats_labels[i][j].setText("-")
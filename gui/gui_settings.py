@@ -36,9 +36,14 @@ class SettingsTab(QWidget):
         mqtt_layout.addRow("Port :", self.mqtt_port)
         
         self.mqtt_topic = QLineEdit()
-        self.mqtt_topic.setPlaceholderText("server/data")
-        self.mqtt_topic.setText("server/data")
+        self.mqtt_topic.setPlaceholderText("server/<appareil>/data")
+        self.mqtt_topic.setText("server/esp32-01/data")
         mqtt_layout.addRow("Topic :", self.mqtt_topic)
+
+        # Diffusion locale du serveur C : remplace le broker si renseignée
+        self.fanout_socket = QLineEdit()
+        self.fanout_socket.setPlaceholderText("data/fanout.sock (vide : broker MQTT)")
+        mqtt_layout.addRow("Socket locale :", self.fanout_socket)
         
         # Bouton de connection
         status_container = QWidget()
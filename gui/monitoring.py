@@ -77,15 +77,16 @@ class MainWindow(QMainWindow):
         host = self.settings_tab.mqtt_host.text().strip()
         port = int(self.settings_tab.mqtt_port.text().strip())
         topic = self.settings_tab.mqtt_topic.text().strip()
+        socket_path = self.settings_tab.fanout_socket.text().strip()
 
-        if not host:
+        if not host and not socket_path:
             self.settings_tab.status_label.setText("Erreur : Hôte vide")
             return
         if not topic:
             self.settings_tab.status_label.setText("Erreur : Topic vide")
             return
 
-        self.realtime_tab.update_mqtt_config(host, port, topic)
+        self.realtime_tab.update_mqtt_config(host, port, topic, socket_path)
         self.realtime_tab.toggle_connection()
         
     def update_settings_connection_status(self, connected, message):
@@ -0,0 +1,399 @@
+#include "alerts.h"
+#include "devices.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INITIAL_CAPACITY 16
+#define STALE_CHECK_MS 1000
+
+// Règle compilée : x = sign * valeur, levée si x > raise, retombée si x <= clear
+typedef struct
+{
+  AlertKind kind;
+  int metric;
+  int device; // -1 : tous
+  double sign;
+  double raise;
+  double clear;
+  int64_t window_ms; // rate : largeur ; stale : délai
+  int rate_slot;     // rate : file de l'appareil
+  int name;          // index dans rule_names
+  double threshold;
+} CompiledRule;
+
+typedef struct
+{
+  int64_t ts_ms;
+  double value;
+} RatePoint;
+
+typedef struct
+{
+  RatePoint *points;
+  size_t capacity;
+  size_t head;
+  size_t count;
+} RateQueue;
+
+typedef struct
+{
+  int seen;
+  int64_t last_ts;
+  uint8_t *active;  // une entrée par règle : règles par mesure puis stale
+  RateQueue *rates; // une file par règle rate
+} DeviceAlerts;
+
+static CompiledRule sample_rules[ALERT_MAX_RULES];
+static int sample_rule_count = 0;
+static CompiledRule stale_rules[ALERT_MAX_RULES];
+static int stale_rule_count = 0;
+static int rate_rule_count = 0;
+static char rule_names[ALERT_MAX_RULES][64];
+
+static DeviceAlerts *devices = NULL;
+static int device_capacity = 0;
+static int64_t next_stale_check_ms = 0;
+
+static const char *kind_names[] = {"above", "below", "rate", "stale"};
+static const char *metric_names[ALERT_METRICS] = {"temperature", "pression", "humidite"};
+
+static int parseName(const char *name, const char **names, int count)
+{
+  for (int i = 0; i < count; i++)
+  {
+    if (strcmp(name, names[i]) == 0)
+      return i;
+  }
+  return -1;
+}
+
+const char *alerts_kind_name(AlertKind kind)
+{
+  return (kind >= ALERT_ABOVE && kind <= ALERT_STALE) ? kind_names[kind] : "?";
+}
+
+static int compileRule(const AlertRuleConfig *r, int index, CompiledRule *c)
+{
+  int kind = parseName(r->kind, kind_names, 4);
+  if (kind < 0)
+  {
+    fprintf(stderr, "Alerte %s : type inconnu \"%s\" (above, below, rate, stale)\n", r->name, r->kind);
+    return -1;
+  }
+
+  memset(c, 0, sizeof(*c));
+  c->kind = (AlertKind)kind;
+  c->name = index;
+  c->threshold = r->threshold;
+  c->rate_slot = -1;
+  c->metric = -1;
+  c->device = -1;
+
+  if (r->device[0])
+  {
+    c->device = devices_intern(r->device, strlen(r->device));
+    if (c->device < 0)
+    {
+      fprintf(stderr, "Alerte %s : nom d'appareil invalide \"%s\"\n", r->name, r->device);
+      return -1;
+    }
+  }
+
+  if (c->kind == ALERT_STALE)
+  {
+    if (r->timeout_s <= 0)
+    {
+      fprintf(stderr, "Alerte %s : timeout_s requis (> 0)\n", r->name);
+      return -1;
+    }
+    c->window_ms = (int64_t)r->timeout_s * 1000;
+    return 0;
+  }
+
+  c->metric = parseName(r->metric, metric_names, ALERT_METRICS);
+  if (c->metric < 0)
+  {
+    fprintf(stderr, "Alerte %s : métrique inconnue \"%s\" (temperature, pression, humidite)\n", r->name,
+            r->metric);
+    return -1;
+  }
+
+  if (r->hysteresis < 0)
+  {
+    fprintf(stderr, "Alerte %s : hysteresis négative\n", r->name);
+    return -1;
+  }
+
+  switch (c->kind)
+  {
+  case ALERT_ABOVE:
+    c->sign = 1.0;
+    break;
+  case ALERT_BELOW:
+    c->sign = -1.0;
+    break;
+  default:
+    if (r->window_s <= 0 || r->threshold == 0)
+    {
+      fprintf(stderr, "Alerte %s : window_s (> 0) et threshold (non nul) requis\n", r->name);
+      return -1;
+    }
+    c->sign = (r->threshold > 0) ? 1.0 : -1.0;
+    c->window_ms = (int64_t)r->window_s * 1000;
+    break;
+  }
+
+  c->raise = c->sign * r->threshold;
+  c->clear = c->raise - r->hysteresis;
+  return 0;
+}
+
+int alerts_init(const AlertRuleConfig *rules, int count)
+{
+  sample_rule_count = 0;
+  stale_rule_count = 0;
+  rate_rule_count = 0;
+
+  for (int i = 0; i < count && i < ALERT_MAX_RULES; i++)
+  {
+    CompiledRule c;
+    if (compileRule(&rules[i], i, &c) != 0)
+      return -1;
+
+    snprintf(rule_names[i], sizeof(rule_names[i]), "%s", rules[i].name);
+
+    if (c.kind == ALERT_STALE)
+    {
+      stale_rules[stale_rule_count++] = c;
+      continue;
+    }
+
+    if (c.kind == ALERT_RATE)
+      c.rate_slot = rate_rule_count++;
+    sample_rules[sample_rule_count++] = c;
+  }
+
+  return 0;
+}
+
+static int growDevices(int device)
+{
+  int capacity = device_capacity ? device_capacity : 8;
+  while (capacity <= device)
+    capacity *= 2;
+
+  DeviceAlerts *grown = realloc(devices, (size_t)capacity * sizeof(DeviceAlerts));
+  if (!grown)
+    return -1;
+
+  memset(grown + device_capacity, 0, (size_t)(capacity - device_capacity) * sizeof(DeviceAlerts));
+  devices = grown;
+  device_capacity = capacity;
+  return 0;
+}
+
+// État d'un appareil, alloué à sa première mesure
+static DeviceAlerts *deviceState(int device)
+{
+  if (device >= device_capacity && growDevices(device) != 0)
+    return NULL;
+
+  DeviceAlerts *d = &devices[device];
+  if (d->active)
+    return d;
+
+  d->active = calloc((size_t)(sample_rule_count + stale_rule_count) + 1, 1);
+  d->rates = calloc((size_t)rate_rule_count + 1, sizeof(RateQueue));
+  if (!d->active || !d->rates)
+  {
+    free(d->active);
+    free(d->rates);
+    d->active = NULL;
+    d->rates = NULL;
+    return NULL;
+  }
+  return d;
+}
+
+static int ratePush(RateQueue *q, int64_t ts_ms, double value)
+{
+  if (q->count == q->capacity)
+  {
+    size_t capacity = q->capacity ? q->capacity * 2 : INITIAL_CAPACITY;
+    RatePoint *grown = malloc(capacity * sizeof(RatePoint));
+    if (!grown)
+      return -1;
+
+    for (size_t i = 0; i < q->count; i++)
+      grown[i] = q->points[(q->head + i) & (q->capacity - 1)];
+
+    free(q->points);
+    q->points = grown;
+    q->capacity = capacity;
+    q->head = 0;
+  }
+
+  q->points[(q->head + q->count) & (q->capacity - 1)] = (RatePoint){ts_ms, value};
+  q->count++;
+  return 0;
+}
+
+// Variation depuis la plus ancienne mesure de la fenêtre, après ajout de la mesure
+static int rateDelta(RateQueue *q, int64_t ts_ms, double value, int64_t window_ms, double *delta)
+{
+  if (ratePush(q, ts_ms, value) != 0)
+    return -1;
+
+  while (q->count > 1 && q->points[q->head].ts_ms <= ts_ms - window_ms)
+  {
+    q->head = (q->head + 1) & (q->capacity - 1);
+    q->count--;
+  }
+
+  *delta = value - q->points[q->head].value;
+  return 0;
+}
+
+static void emit(AlertCallback callback, void *ctx, int device, int64_t ts_ms, const CompiledRule *rule, int raised,
+                 double value)
+{
+  AlertEvent event = {
+      .device = device,
+      .ts_ms = ts_ms,
+      .rule = rule_names[rule->name],
+      .kind = rule->kind,
+      .metric = rule->metric,
+      .raised = raised,
+      .value = value,
+      .threshold = rule->threshold,
+  };
+  callback(ctx, &event);
+}
+
+int alerts_evaluate(int device, int64_t ts_ms, const double value[ALERT_METRICS], AlertCallback callback,
+                    void *ctx)
+{
+  if (device < 0 || sample_rule_count + stale_rule_count == 0)
+    return 0;
+
+  DeviceAlerts *d = deviceState(device);
+  if (!d)
+    return -1;
+
+  if (d->seen && ts_ms < d->last_ts)
+    ts_ms = d->last_ts;
+
+  int events = 0;
+
+  for (int i = 0; i < sample_rule_count; i++)
+  {
+    const CompiledRule *rule = &sample_rules[i];
+    if (rule->device >= 0 && rule->device != device)
+      continue;
+
+    double x = value[rule->metric];
+    if (rule->kind == ALERT_RATE && rateDelta(&d->rates[rule->rate_slot], ts_ms, x, rule->window_ms, &x) != 0)
+      return -1;
+
+    if (!d->active[i] && rule->sign * x > rule->raise)
+    {
+      d->active[i] = 1;
+      emit(callback, ctx, device, ts_ms, rule, 1, x);
+      events++;
+    }
+    else if (d->active[i] && rule->sign * x <= rule->clear)
+    {
+      d->active[i] = 0;
+      emit(callback, ctx, device, ts_ms, rule, 0, x);
+      events++;
+    }
+  }
+
+  // Mesure reçue : les règles stale levées retombent
+  uint8_t *stale_active = d->active + sample_rule_count;
+  for (int i = 0; i < stale_rule_count; i++)
+  {
+    if (stale_active[i])
+    {
+      stale_active[i] = 0;
+      emit(callback, ctx, device, ts_ms, &stale_rules[i], 0, (double)(ts_ms - d->last_ts) / 1000.0);
+      events++;
+    }
+  }
+
+  d->seen = 1;
+  d->last_ts = ts_ms;
+  return events;
+}
+
+int alerts_check_stale(int64_t now_ms, AlertCallback callback, void *ctx)
+{
+  if (stale_rule_count == 0 || now_ms < next_stale_check_ms)
+    return 0;
+
+  next_stale_check_ms = now_ms + STALE_CHECK_MS;
+  int events = 0;
+
+  for (int device = 0; device < device_capacity; device++)
+  {
+    DeviceAlerts *d = &devices[device];
+    if (!d->seen)
+      continue;
+
+    uint8_t *stale_active = d->active + sample_rule_count;
+    for (int i = 0; i < stale_rule_count; i++)
+    {
+      const CompiledRule *rule = &stale_rules[i];
+      if (stale_active[i] || (rule->device >= 0 && rule->device != device))
+        continue;
+
+      if (now_ms - d->last_ts >= rule->window_ms)
+      {
+        stale_active[i] = 1;
+        emit(callback, ctx, device, now_ms, rule, 1, (double)(now_ms - d->last_ts) / 1000.0);
+        events++;
+      }
+    }
+  }
+
+  return events;
+}
+
+int alerts_format(char *buffer, size_t size, const char *timestamp, const AlertEvent *event)
+{
+  char metric[48] = "";
+  if (event->metric >= 0 && event->metric < ALERT_METRICS)
+    snprintf(metric, sizeof(metric), "\"metric\": \"%s\", ", metric_names[event->metric]);
+
+  int len = snprintf(buffer, size,
+                     "{\"timestamp\": \"%s\", \"rule\": \"%s\", \"kind\": \"%s\", %s\"state\": \"%s\", "
+                     "\"value\": %.2f, \"threshold\": %.2f}",
+                     timestamp, event->rule, alerts_kind_name(event->kind), metric,
+                     event->raised ? "raised" : "cleared", event->value, event->threshold);
+
+  return (len < 0 || (size_t)len >= size) ? -1 : len;
+}
+
+void alerts_close(void)
+{
+  for (int i = 0; i < device_capacity; i++)
+  {
+    if (devices[i].rates)
+    {
+      for (int r = 0; r < rate_rule_count; r++)
+        free(devices[i].rates[r].points);
+    }
+    free(devices[i].rates);
+    free(devices[i].active);
+  }
+
+  free(devices);
+  devices = NULL;
+  device_capacity = 0;
+  sample_rule_count = 0;
+  stale_rule_count = 0;
+  rate_rule_count = 0;
+  next_stale_check_ms = 0;
+}
@@ -0,0 +1,112 @@
+#ifndef ALERTS_H
+#define ALERTS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "config.h"
+
+#define ALERT_METRICS 3
+
+// ===== ALERTES =====
+
+/*
+ * Règles de [[alerts.rule]], compilées au démarrage en une table de seuils
+ * (nom d'appareil résolu en clé, seuils de levée et de retombée précalculés)
+ * et évaluées à chaque mesure en direct :
+ *   - above / below : valeur au-dessus / au-dessous de threshold, retombée
+ *     à threshold -/+ hysteresis ;
+ *   - rate : variation depuis la plus ancienne mesure des window_s dernières
+ *     secondes, hausse si threshold > 0, baisse si threshold < 0 ;
+ *   - stale : aucune mesure depuis timeout_s (appareil déjà vu), vérifié par
+ *     alerts_check_stale(), retombée à la mesure suivante.
+ *
+ * Un événement n'est émis qu'au changement d'état (levée, retombée) d'une
+ * règle pour un appareil. Coût par mesure : une comparaison par règle, plus
+ * une file de mesures par règle rate (O(1) amorti).
+ *
+ * Uniquement utilisé par le thread d'écriture : aucun verrou.
+ */
+
+typedef enum
+{
+  ALERT_ABOVE = 0,
+  ALERT_BELOW,
+  ALERT_RATE,
+  ALERT_STALE
+} AlertKind;
+
+/**
+ * @brief Changement d'état d'une règle pour un appareil
+ */
+typedef struct
+{
+  int device;
+  int64_t ts_ms;     // mesure déclenchante, ou instant de la vérification (stale)
+  const char *rule;  // nom de la règle
+  AlertKind kind;
+  int metric;        // 0 temperature, 1 pression, 2 humidite ; -1 pour stale
+  int raised;        // 1 levée, 0 retombée
+  double value;      // valeur, variation (rate) ou silence en secondes (stale)
+  double threshold;
+} AlertEvent;
+
+/**
+ * @brief Appelé pour chaque événement
+ */
+typedef void (*AlertCallback)(void *ctx, const AlertEvent *event);
+
+/**
+ * @brief Compile les règles
+ *
+ * Les appareils nommés sont internés (clé attribuée s'ils n'ont encore
+ * rien publié) : devices_init() doit avoir été appelé.
+ *
+ * @return 0 si succès, -1 si une règle est invalide (message sur stderr)
+ */
+int alerts_init(const AlertRuleConfig *rules, int count);
+
+/**
+ * @brief Évalue les règles pour une mesure
+ * @param device Appareil
+ * @param ts_ms Instant de la mesure (une mesure antérieure à la précédente est datée comme elle)
+ * @param value temperature, pression, humidite
+ * @param callback Appelé pour chaque changement d'état
+ * @param ctx Contexte passé à callback
+ * @return Nombre d'événements, -1 en cas d'erreur d'allocation
+ */
+int alerts_evaluate(int device, int64_t ts_ms, const double value[ALERT_METRICS], AlertCallback callback,
+                    void *ctx);
+
+/**
+ * @brief Lève les règles stale des appareils muets
+ *
+ * Parcourt appareils et règles au plus une fois par seconde : peut être
+ * appelé à chaque tour du thread d'écriture.
+ *
+ * @param now_ms Instant courant (epoch ms)
+ * @return Nombre d'événements
+ */
+int alerts_check_stale(int64_t now_ms, AlertCallback callback, void *ctx);
+
+/**
+ * @brief Nom d'un type de règle
+ */
+const char *alerts_kind_name(AlertKind kind);
+
+/**
+ * @brief Sérialise un événement en JSON
+ *
+ * {"timestamp": "...", "rule": "serre_chaude", "kind": "above", "metric":
+ * "temperature", "state": "raised", "value": 31.20, "threshold": 30.00}
+ * (pas de "metric" pour stale).
+ *
+ * @return Longueur écrite, -1 si le buffer est trop petit
+ */
+int alerts_format(char *buffer, size_t size, const char *timestamp, const AlertEvent *event);
+
+/**
+ * @brief Libère règles et état par appareil
+ */
+void alerts_close(void);
+
+#endif // ALERTS_H
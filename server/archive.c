@@ -0,0 +1,758 @@
+#include "archive.h"
+#include "partitions.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DAY_MS (86400 * 1000LL)
+#define INDEX_ENTRY_SIZE 40
+
+static const uint8_t block_magic[4] = {'S', 'M', 'A', '1'};
+
+enum
+{
+  COLUMN_FIXED = 0, // valeur x10 exacte, deltas entiers
+  COLUMN_XOR = 1    // doubles bruts, XOR avec la valeur précédente
+};
+
+typedef struct
+{
+  uint32_t device;
+  uint32_t count;
+  int64_t t_min;
+  int64_t t_max;
+  uint64_t offset;
+  uint32_t length;
+  uint32_t reserved;
+} IndexEntry;
+
+_Static_assert(sizeof(IndexEntry) == INDEX_ENTRY_SIZE, "entrée d'index de 40 octets");
+
+// ===== CRC32 =====
+
+static uint32_t crc32(const uint8_t *data, size_t len)
+{
+  uint32_t crc = 0xFFFFFFFFu;
+  for (size_t i = 0; i < len; i++)
+  {
+    crc ^= data[i];
+    for (int k = 0; k < 8; k++)
+      crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+  }
+  return ~crc;
+}
+
+// ===== FLUX DE BITS =====
+
+typedef struct
+{
+  uint8_t *buf;
+  size_t size;
+  size_t bit;
+} BitWriter;
+
+typedef struct
+{
+  const uint8_t *buf;
+  size_t size;
+  size_t bit;
+  int overrun;
+} BitReader;
+
+// Écrit les nbits de poids faible de value, bit de poids fort en premier
+static int putBits(BitWriter *w, uint64_t value, int nbits)
+{
+  if (w->bit + (size_t)nbits > w->size * 8)
+    return -1;
+
+  for (int i = nbits - 1; i >= 0; i--)
+  {
+    size_t byte = w->bit >> 3;
+    if ((w->bit & 7) == 0)
+      w->buf[byte] = 0;
+    if ((value >> i) & 1)
+      w->buf[byte] |= (uint8_t)(0x80 >> (w->bit & 7));
+    w->bit++;
+  }
+  return 0;
+}
+
+static uint64_t getBits(BitReader *r, int nbits)
+{
+  uint64_t value = 0;
+
+  if (r->bit + (size_t)nbits > r->size * 8)
+  {
+    r->overrun = 1;
+    return 0;
+  }
+
+  for (int i = 0; i < nbits; i++)
+  {
+    value = (value << 1) | ((r->buf[r->bit >> 3] >> (7 - (r->bit & 7))) & 1);
+    r->bit++;
+  }
+  return value;
+}
+
+/*
+ * Entier signé en code préfixé, après zigzag :
+ *   0            zéro
+ *   10   + 6     < 64
+ *   110  + 9     < 512
+ *   1110 + 13    < 8192
+ *   11110 + 32   < 2^32
+ *   11111 + 64   le reste
+ * Une cadence régulière (delta-de-delta nul) coûte un bit par mesure.
+ */
+static int putSigned(BitWriter *w, int64_t v)
+{
+  uint64_t zz = ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+
+  if (zz == 0)
+    return putBits(w, 0, 1);
+  if (zz < 64)
+    return putBits(w, 0x2, 2) | putBits(w, zz, 6);
+  if (zz < 512)
+    return putBits(w, 0x6, 3) | putBits(w, zz, 9);
+  if (zz < 8192)
+    return putBits(w, 0xE, 4) | putBits(w, zz, 13);
+  if (zz < (1ULL << 32))
+    return putBits(w, 0x1E, 5) | putBits(w, zz, 32);
+  return putBits(w, 0x1F, 5) | putBits(w, zz, 64);
+}
+
+static int64_t getSigned(BitReader *r)
+{
+  static const int widths[] = {6, 9, 13, 32};
+  uint64_t zz;
+  int ones = 0;
+
+  while (ones < 5 && getBits(r, 1) == 1)
+    ones++;
+
+  if (ones == 0)
+    return 0;
+  zz = getBits(r, ones < 5 ? widths[ones - 1] : 64);
+
+  return (int64_t)(zz >> 1) ^ -(int64_t)(zz & 1);
+}
+
+static uint64_t doubleBits(double v)
+{
+  uint64_t bits;
+  memcpy(&bits, &v, sizeof(bits));
+  return bits;
+}
+
+static double bitsDouble(uint64_t bits)
+{
+  double v;
+  memcpy(&v, &bits, sizeof(v));
+  return v;
+}
+
+// ===== COLONNES =====
+
+// Valeur au dixième exacte : la division de l'entier redonne le même double
+static int isFixedColumn(const double *values, int count)
+{
+  for (int i = 0; i < count; i++)
+  {
+    double scaled = values[i] * 10.0;
+    if (!(fabs(scaled) < 9e15))
+      return 0;
+
+    double back = (double)llround(scaled) / 10.0;
+    if (doubleBits(back) != doubleBits(values[i]))
+      return 0;
+  }
+  return 1;
+}
+
+static int encodeFixed(BitWriter *w, const double *values, int count)
+{
+  int64_t prev = 0;
+  int rc = 0;
+
+  for (int i = 0; i < count && rc == 0; i++)
+  {
+    int64_t v = llround(values[i] * 10.0);
+    rc = putSigned(w, v - prev);
+    prev = v;
+  }
+  return rc;
+}
+
+static void decodeFixed(BitReader *r, double *values, int count)
+{
+  int64_t v = 0;
+
+  for (int i = 0; i < count; i++)
+  {
+    v += getSigned(r);
+    values[i] = (double)v / 10.0;
+  }
+}
+
+// XOR avec la valeur précédente : '0' si identique, sinon '1', zéros de tête (6 bits), longueur - 1 (6 bits), bits
+static int encodeXor(BitWriter *w, const double *values, int count)
+{
+  uint64_t prev = 0;
+  int rc = 0;
+
+  for (int i = 0; i < count && rc == 0; i++)
+  {
+    uint64_t bits = doubleBits(values[i]);
+    uint64_t x = bits ^ prev;
+    prev = bits;
+
+    if (x == 0)
+    {
+      rc = putBits(w, 0, 1);
+      continue;
+    }
+
+    int lead = __builtin_clzll(x);
+    int trail = __builtin_ctzll(x);
+    int len = 64 - lead - trail;
+
+    rc = putBits(w, 1, 1) | putBits(w, (uint64_t)lead, 6) | putBits(w, (uint64_t)(len - 1), 6) |
+         putBits(w, x >> trail, len);
+  }
+  return rc;
+}
+
+static void decodeXor(BitReader *r, double *values, int count)
+{
+  uint64_t prev = 0;
+
+  for (int i = 0; i < count; i++)
+  {
+    if (getBits(r, 1) == 1)
+    {
+      int lead = (int)getBits(r, 6);
+      int len = (int)getBits(r, 6) + 1;
+      int trail = 64 - lead - len;
+      if (trail < 0)
+      {
+        r->overrun = 1;
+        return;
+      }
+      prev ^= getBits(r, len) << trail;
+    }
+    values[i] = bitsDouble(prev);
+  }
+}
+
+// ===== BLOCS =====
+
+/*
+ * En-tête (32 octets) :
+ *   magic "SMA1" | device u32 | count u32 | t_first i64 |
+ *   modes u8[3] | réservé u8 | taille des données u32 | crc32 des données u32
+ */
+
+size_t archive_block_bound(int count)
+{
+  // Pire cas par mesure : 69 bits pour ts et 77 bits par métrique
+  return ARCHIVE_HEADER_SIZE + (size_t)count * 38 + 16;
+}
+
+long archive_encode_block(int device, const int64_t *ts, const double *values[3], int count,
+                          uint8_t *out, size_t size)
+{
+  if (count <= 0 || count > ARCHIVE_BLOCK_MAX || size < ARCHIVE_HEADER_SIZE)
+    return -1;
+
+  BitWriter w = {out + ARCHIVE_HEADER_SIZE, size - ARCHIVE_HEADER_SIZE, 0};
+  uint8_t modes[3];
+  int rc = 0;
+
+  // Instants : premier delta puis delta-de-delta
+  int64_t prev_delta = 0;
+  for (int i = 1; i < count && rc == 0; i++)
+  {
+    int64_t delta = ts[i] - ts[i - 1];
+    rc = putSigned(&w, delta - prev_delta);
+    prev_delta = delta;
+  }
+
+  for (int c = 0; c < 3 && rc == 0; c++)
+  {
+    modes[c] = isFixedColumn(values[c], count) ? COLUMN_FIXED : COLUMN_XOR;
+    rc = (modes[c] == COLUMN_FIXED) ? encodeFixed(&w, values[c], count) : encodeXor(&w, values[c], count);
+  }
+
+  if (rc != 0)
+    return -1;
+
+  uint32_t payload_len = (uint32_t)((w.bit + 7) / 8);
+  uint32_t udevice = (uint32_t)device;
+  uint32_t ucount = (uint32_t)count;
+  uint32_t crc = crc32(out + ARCHIVE_HEADER_SIZE, payload_len);
+
+  memcpy(out, block_magic, 4);
+  memcpy(out + 4, &udevice, 4);
+  memcpy(out + 8, &ucount, 4);
+  memcpy(out + 12, &ts[0], 8);
+  memcpy(out + 20, modes, 3);
+  out[23] = 0;
+  memcpy(out + 24, &payload_len, 4);
+  memcpy(out + 28, &crc, 4);
+
+  return ARCHIVE_HEADER_SIZE + (long)payload_len;
+}
+
+int archive_decode_block(const uint8_t *block, size_t size, int *device, int64_t *ts, double *values[3])
+{
+  uint32_t udevice, count, payload_len, crc;
+  uint8_t modes[3];
+
+  if (size < ARCHIVE_HEADER_SIZE || memcmp(block, block_magic, 4) != 0)
+    return -1;
+
+  memcpy(&udevice, block + 4, 4);
+  memcpy(&count, block + 8, 4);
+  memcpy(&ts[0], block + 12, 8);
+  memcpy(modes, block + 20, 3);
+  memcpy(&payload_len, block + 24, 4);
+  memcpy(&crc, block + 28, 4);
+
+  if (count == 0 || count > ARCHIVE_BLOCK_MAX || payload_len > size - ARCHIVE_HEADER_SIZE ||
+      crc32(block + ARCHIVE_HEADER_SIZE, payload_len) != crc)
+    return -1;
+
+  BitReader r = {block + ARCHIVE_HEADER_SIZE, payload_len, 0, 0};
+
+  int64_t delta = 0;
+  for (uint32_t i = 1; i < count; i++)
+  {
+    delta += getSigned(&r);
+    ts[i] = ts[i - 1] + delta;
+  }
+
+  for (int c = 0; c < 3; c++)
+  {
+    if (modes[c] == COLUMN_FIXED)
+      decodeFixed(&r, values[c], (int)count);
+    else
+      decodeXor(&r, values[c], (int)count);
+  }
+
+  if (r.overrun)
+    return -1;
+
+  *device = (int)udevice;
+  return (int)count;
+}
+
+// ===== FICHIERS =====
+
+static void dayName(int64_t ts_ms, char *name, size_t size)
+{
+  time_t t = (time_t)(ts_ms / 1000);
+  struct tm utc_time;
+  gmtime_r(&t, &utc_time);
+  strftime(name, size, "%Y%m%d", &utc_time);
+}
+
+static int64_t dayStart(int64_t ts_ms)
+{
+  int64_t day = ts_ms / DAY_MS;
+  if (ts_ms < 0 && ts_ms % DAY_MS != 0)
+    day--;
+  return day * DAY_MS;
+}
+
+// Fichiers du jour en cours d'écriture et index déjà présent (reprise après échec)
+typedef struct
+{
+  const char *dir;
+  char day[16];
+  FILE *data;
+  FILE *index;
+  IndexEntry *entries;
+  size_t entry_count;
+  int64_t *check_ts;      // relecture des blocs (ARCHIVE_BLOCK_MAX)
+  double *check_values[3];
+} DayWriter;
+
+static IndexEntry *loadIndex(const char *path, size_t *count)
+{
+  FILE *fp = fopen(path, "rb");
+  IndexEntry *entries = NULL;
+
+  *count = 0;
+  if (!fp)
+    return NULL;
+
+  if (fseek(fp, 0, SEEK_END) == 0)
+  {
+    long size = ftell(fp);
+    size_t n = (size > 0) ? (size_t)size / INDEX_ENTRY_SIZE : 0;
+    if (n > 0 && (entries = malloc(n * sizeof(IndexEntry))) != NULL)
+    {
+      rewind(fp);
+      *count = fread(entries, sizeof(IndexEntry), n, fp);
+    }
+  }
+
+  fclose(fp);
+  return entries;
+}
+
+static int syncFile(FILE *fp)
+{
+  return (fflush(fp) == 0 && fsync(fileno(fp)) == 0) ? 0 : -1;
+}
+
+static void closeDay(DayWriter *dw)
+{
+  if (dw->data)
+    fclose(dw->data);
+  if (dw->index)
+    fclose(dw->index);
+  free(dw->entries);
+  dw->data = NULL;
+  dw->index = NULL;
+  dw->entries = NULL;
+  dw->entry_count = 0;
+  dw->day[0] = '\0';
+}
+
+static int openDay(DayWriter *dw, const char *day)
+{
+  char path[1024];
+
+  if (dw->data && strcmp(dw->day, day) == 0)
+    return 0;
+
+  closeDay(dw);
+  snprintf(dw->day, sizeof(dw->day), "%s", day);
+
+  snprintf(path, sizeof(path), "%s/%s.idx", dw->dir, day);
+  dw->entries = loadIndex(path, &dw->entry_count);
+  dw->index = fopen(path, "ab");
+
+  snprintf(path, sizeof(path), "%s/%s.sma", dw->dir, day);
+  dw->data = fopen(path, "ab");
+
+  if (!dw->index || !dw->data)
+  {
+    fprintf(stderr, "Erreur archive : ouverture %s : %s\n", path, strerror(errno));
+    closeDay(dw);
+    return -1;
+  }
+  return 0;
+}
+
+static int alreadyArchived(const DayWriter *dw, const IndexEntry *entry)
+{
+  for (size_t i = 0; i < dw->entry_count; i++)
+  {
+    const IndexEntry *e = &dw->entries[i];
+    if (e->device == entry->device && e->t_min == entry->t_min && e->t_max == entry->t_max &&
+        e->count == entry->count)
+      return 1;
+  }
+  return 0;
+}
+
+// Relit le bloc encodé : la partition n'est supprimée que si l'archive rend exactement ses lignes
+static int verifyBlock(const DayWriter *dw, const uint8_t *block, size_t size, int device, const int64_t *ts,
+                       const double *values[3], int count)
+{
+  int decoded_device;
+  double *check[3] = {dw->check_values[0], dw->check_values[1], dw->check_values[2]};
+
+  if (archive_decode_block(block, size, &decoded_device, dw->check_ts, check) != count || decoded_device != device)
+    return -1;
+
+  for (int i = 0; i < count; i++)
+  {
+    if (dw->check_ts[i] != ts[i])
+      return -1;
+    for (int m = 0; m < 3; m++)
+    {
+      if (memcmp(&check[m][i], &values[m][i], sizeof(double)) != 0)
+        return -1;
+    }
+  }
+  return 0;
+}
+
+// Bloc d'abord, index ensuite : un arrêt entre les deux laisse un bloc orphelin ignoré à la lecture
+static int writeBlock(DayWriter *dw, int device, const int64_t *ts, const double *values[3], int count,
+                      uint8_t *buf, size_t size)
+{
+  char day[16];
+  dayName(ts[0], day, sizeof(day));
+
+  if (openDay(dw, day) != 0)
+    return -1;
+
+  IndexEntry entry = {(uint32_t)device, (uint32_t)count, ts[0], ts[count - 1], 0, 0, 0};
+  if (alreadyArchived(dw, &entry))
+    return 0;
+
+  long len = archive_encode_block(device, ts, values, count, buf, size);
+  if (len < 0)
+    return -1;
+
+  if (verifyBlock(dw, buf, (size_t)len, device, ts, values, count) != 0)
+  {
+    fprintf(stderr, "Erreur archive : bloc de l'appareil %d relu différent (%d mesures)\n", device, count);
+    return -1;
+  }
+
+  if (fseek(dw->data, 0, SEEK_END) != 0)
+    return -1;
+
+  long offset = ftell(dw->data);
+  if (offset < 0 || fwrite(buf, 1, (size_t)len, dw->data) != (size_t)len || syncFile(dw->data) != 0)
+    return -1;
+
+  entry.offset = (uint64_t)offset;
+  entry.length = (uint32_t)len;
+
+  if (fwrite(&entry, sizeof(entry), 1, dw->index) != 1 || syncFile(dw->index) != 0)
+    return -1;
+
+  return 0;
+}
+
+static int ensureDir(const char *dir)
+{
+  if (mkdir(dir, 0755) == 0 || errno == EEXIST)
+    return 0;
+
+  fprintf(stderr, "Erreur archive : création %s : %s\n", dir, strerror(errno));
+  return -1;
+}
+
+long archive_partition(sqlite3 *db, const char *table, const char *dir)
+{
+  DayWriter dw = {dir, "", NULL, NULL, NULL, 0, NULL, {NULL, NULL, NULL}};
+  sqlite3_stmt *stmt = NULL;
+  size_t buf_size = archive_block_bound(ARCHIVE_BLOCK_MAX);
+  int64_t *ts = malloc(2 * ARCHIVE_BLOCK_MAX * sizeof(int64_t));
+  double *columns = malloc(6 * ARCHIVE_BLOCK_MAX * sizeof(double));
+  uint8_t *buf = malloc(buf_size);
+  const double *values[3] = {columns, columns + ARCHIVE_BLOCK_MAX, columns + 2 * ARCHIVE_BLOCK_MAX};
+  long archived = -1;
+
+  if (!ts || !columns || !buf || ensureDir(dir) != 0)
+    goto done;
+
+  dw.check_ts = ts + ARCHIVE_BLOCK_MAX;
+  for (int m = 0; m < 3; m++)
+    dw.check_values[m] = columns + (3 + m) * ARCHIVE_BLOCK_MAX;
+
+  // Partition compacte : dixièmes entiers, ramenés en unités à la lecture
+  double scale = partitions_scale(db, table);
+  char *sql = sqlite3_mprintf("SELECT device, ts, temperature, pression, humidite FROM \"%w\" ORDER BY device, ts;",
+                              table);
+  int rc = sql ? sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) : SQLITE_NOMEM;
+  sqlite3_free(sql);
+  if (rc != SQLITE_OK)
+  {
+    fprintf(stderr, "Erreur archive %s : %s\n", table, sqlite3_errmsg(db));
+    goto done;
+  }
+
+  // Un bloc par appareil et par jour UTC, découpé à ARCHIVE_BLOCK_MAX mesures
+  int device = 0, count = 0;
+  int64_t day_end = 0;
+  long total = 0;
+
+  while ((rc = sqlite3_step(stmt)) == SQLITE_ROW)
+  {
+    int row_device = sqlite3_column_int(stmt, 0);
+    int64_t row_ts = sqlite3_column_int64(stmt, 1);
+
+    if (count > 0 && (row_device != device || row_ts >= day_end || count == ARCHIVE_BLOCK_MAX))
+    {
+      if (writeBlock(&dw, device, ts, values, count, buf, buf_size) != 0)
+        goto done;
+      total += count;
+      count = 0;
+    }
+
+    if (count == 0)
+    {
+      device = row_device;
+      day_end = dayStart(row_ts) + DAY_MS;
+    }
+
+    ts[count] = row_ts;
+    columns[count] = sqlite3_column_double(stmt, 2) / scale;
+    columns[ARCHIVE_BLOCK_MAX + count] = sqlite3_column_double(stmt, 3) / scale;
+    columns[2 * ARCHIVE_BLOCK_MAX + count] = sqlite3_column_double(stmt, 4) / scale;
+    count++;
+  }
+
+  if (rc != SQLITE_DONE)
+  {
+    fprintf(stderr, "Erreur archive %s : %s\n", table, sqlite3_errmsg(db));
+    goto done;
+  }
+
+  if (count > 0)
+  {
+    if (writeBlock(&dw, device, ts, values, count, buf, buf_size) != 0)
+      goto done;
+    total += count;
+  }
+
+  archived = total;
+
+done:
+  if (archived < 0)
+    fprintf(stderr, "Erreur archive : %s conservée\n", table);
+  sqlite3_finalize(stmt);
+  closeDay(&dw);
+  free(buf);
+  free(columns);
+  free(ts);
+  return archived;
+}
+
+static int compareDays(const void *a, const void *b)
+{
+  int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+  return (x > y) - (x < y);
+}
+
+// Jours présents dans l'archive (fichiers AAAAMMJJ.idx) qui recoupent [from_ms, to_ms[, triés
+static int64_t *listDays(const char *dir, int64_t from_ms, int64_t to_ms, size_t *count)
+{
+  DIR *d = opendir(dir);
+  int64_t *days = NULL;
+  size_t cap = 0;
+  struct dirent *entry;
+
+  *count = 0;
+  if (!d)
+    return NULL;
+
+  while ((entry = readdir(d)) != NULL)
+  {
+    struct tm day_tm = {0};
+    char suffix[8];
+
+    if (strlen(entry->d_name) != 12 ||
+        sscanf(entry->d_name, "%4d%2d%2d.%3s", &day_tm.tm_year, &day_tm.tm_mon, &day_tm.tm_mday, suffix) != 4 ||
+        strcmp(suffix, "idx") != 0)
+      continue;
+
+    day_tm.tm_year -= 1900;
+    day_tm.tm_mon -= 1;
+    int64_t day = (int64_t)timegm(&day_tm) * 1000;
+    if (day + DAY_MS <= from_ms || day >= to_ms)
+      continue;
+
+    if (*count == cap)
+    {
+      cap = cap ? cap * 2 : 16;
+      int64_t *grown = realloc(days, cap * sizeof(int64_t));
+      if (!grown)
+        break;
+      days = grown;
+    }
+    days[(*count)++] = day;
+  }
+
+  closedir(d);
+  if (days)
+    qsort(days, *count, sizeof(int64_t), compareDays);
+  return days;
+}
+
+int archive_query_range(const char *dir, int device, int64_t from_ms, int64_t to_ms,
+                        ArchiveRowCallback cb, void *ctx)
+{
+  int64_t *ts = malloc(ARCHIVE_BLOCK_MAX * sizeof(int64_t));
+  double *columns = malloc(3 * ARCHIVE_BLOCK_MAX * sizeof(double));
+  uint8_t *buf = malloc(archive_block_bound(ARCHIVE_BLOCK_MAX));
+  double *values[3] = {columns, columns + ARCHIVE_BLOCK_MAX, columns + 2 * ARCHIVE_BLOCK_MAX};
+  int rc = 0, stop = 0;
+
+  if (!ts || !columns || !buf)
+  {
+    rc = -1;
+    goto done;
+  }
+
+  // Les blocs ne chevauchent pas minuit : seuls les fichiers des jours de la plage sont lus
+  size_t day_count;
+  int64_t *days = listDays(dir, from_ms, to_ms, &day_count);
+
+  for (size_t d = 0; d < day_count && !stop && rc == 0; d++)
+  {
+    char name[16], path[1024];
+    size_t entry_count;
+
+    dayName(days[d], name, sizeof(name));
+    snprintf(path, sizeof(path), "%s/%s.idx", dir, name);
+    IndexEntry *entries = loadIndex(path, &entry_count);
+    if (!entries)
+      continue;
+
+    snprintf(path, sizeof(path), "%s/%s.sma", dir, name);
+    FILE *data = fopen(path, "rb");
+
+    for (size_t i = 0; data && i < entry_count && !stop; i++)
+    {
+      const IndexEntry *e = &entries[i];
+      if ((device >= 0 && e->device != (uint32_t)device) || e->t_max < from_ms || e->t_min >= to_ms)
+        continue;
+
+      int block_device;
+      int count = -1;
+      if (e->length <= archive_block_bound(ARCHIVE_BLOCK_MAX) &&
+          fseek(data, (long)e->offset, SEEK_SET) == 0 &&
+          fread(buf, 1, e->length, data) == e->length)
+      {
+        count = archive_decode_block(buf, e->length, &block_device, ts, values);
+      }
+
+      if (count < 0)
+      {
+        fprintf(stderr, "Erreur archive : bloc invalide dans %s à l'octet %llu\n",
+                path, (unsigned long long)e->offset);
+        rc = -1;
+        break;
+      }
+
+      for (int k = 0; k < count; k++)
+      {
+        if (ts[k] < from_ms || ts[k] >= to_ms)
+          continue;
+        if (cb(ctx, block_device, ts[k], values[0][k], values[1][k], values[2][k]) != 0)
+        {
+          stop = 1;
+          break;
+        }
+      }
+    }
+
+    if (data)
+      fclose(data);
+    free(entries);
+  }
+  free(days);
+
+done:
+  free(buf);
+  free(columns);
+  free(ts);
+  return rc;
+}
@@ -0,0 +1,86 @@
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sqlite3.h>
+
+#define ARCHIVE_BLOCK_MAX 4096
+#define ARCHIVE_HEADER_SIZE 32
+
+// ===== ARCHIVE COLONNAIRE =====
+
+/*
+ * Archive froide des partitions sorties de la rétention. Un fichier de blocs
+ * par jour UTC (AAAAMMJJ.sma) et son index (AAAAMMJJ.idx). Un bloc contient
+ * jusqu'à ARCHIVE_BLOCK_MAX mesures d'un appareil, stockées par colonne :
+ *   - ts : premier instant brut, puis delta-de-delta en codes préfixés
+ *   - métriques : virgule fixe (x10, deltas) si exacte, sinon XOR de doubles
+ * Une mesure toutes les 5 s coûte 2 à 3 octets. L'index (appareil, plage
+ * de temps, position) est écrit après le bloc : un bloc non indexé est ignoré.
+ * Format natif little-endian.
+ */
+
+/**
+ * @brief Callback de parcours d'une plage de mesures archivées
+ * @param ctx Contexte utilisateur
+ * @return 0 pour continuer, autre valeur pour arrêter le parcours
+ */
+typedef int (*ArchiveRowCallback)(void *ctx, int device, int64_t ts_ms,
+                                  double temp, double press, double hum);
+
+/**
+ * @brief Encode un bloc de mesures d'un appareil, triées par instant
+ * @param device Appareil
+ * @param ts Instants (epoch UTC en millisecondes)
+ * @param values Colonnes temperature, pression, humidite
+ * @param count Nombre de mesures (1 à ARCHIVE_BLOCK_MAX)
+ * @param out Buffer de sortie
+ * @param size Taille du buffer (archive_block_bound(count) suffit)
+ * @return Taille du bloc encodé, -1 en cas d'erreur
+ */
+long archive_encode_block(int device, const int64_t *ts, const double *values[3], int count,
+                          uint8_t *out, size_t size);
+
+/**
+ * @brief Taille maximale d'un bloc de count mesures
+ */
+size_t archive_block_bound(int count);
+
+/**
+ * @brief Décode un bloc
+ * @param block Bloc encodé (en-tête compris)
+ * @param size Taille du bloc
+ * @param device Appareil lu
+ * @param ts Instants décodés (ARCHIVE_BLOCK_MAX éléments)
+ * @param values Colonnes décodées (ARCHIVE_BLOCK_MAX éléments chacune)
+ * @return Nombre de mesures, -1 si le bloc est invalide
+ */
+int archive_decode_block(const uint8_t *block, size_t size, int *device, int64_t *ts, double *values[3]);
+
+/**
+ * @brief Archive toutes les lignes d'une table de mesures (une partition)
+ *
+ * Chaque bloc est relu et comparé aux lignes avant d'être écrit.
+ *
+ * @param db Base de données
+ * @param table Nom de la table
+ * @param dir Dossier de l'archive (créé si besoin)
+ * @return Nombre de mesures archivées, -1 en cas d'erreur (la table ne doit pas être supprimée)
+ */
+long archive_partition(sqlite3 *db, const char *table, const char *dir);
+
+/**
+ * @brief Parcourt les mesures archivées de [from_ms, to_ms[
+ * @param dir Dossier de l'archive
+ * @param device Appareil, -1 pour tous
+ * @param from_ms Début de plage inclus
+ * @param to_ms Fin de plage exclue
+ * @param cb Callback appelé pour chaque mesure, par bloc puis instant
+ * @param ctx Contexte passé au callback
+ * @return 0 si succès, -1 en cas d'erreur de lecture
+ */
+int archive_query_range(const char *dir, int device, int64_t from_ms, int64_t to_ms,
+                        ArchiveRowCallback cb, void *ctx);
+
+#endif // ARCHIVE_H
@@ -0,0 +1,223 @@
+#include "compression.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct
+{
+  int active;                // archived renseigné
+  int held_valid;            // porte pivotante : dernière lecture, pas encore tranchée
+  CompressedPoint archived;  // dernière ligne stockée
+  CompressedPoint held;
+  double up[COMPRESSION_METRICS]; // corridor des pentes depuis archived (par ms)
+  double lo[COMPRESSION_METRICS];
+} DeviceState;
+
+static CompressionMode mode = COMPRESSION_OFF;
+static double tolerance[COMPRESSION_METRICS];
+static int64_t max_gap_ms = 0;
+static DeviceState *states = NULL;
+static int device_capacity = 0;
+
+static const char *mode_names[] = {"off", "deadband", "swinging_door"};
+
+void compression_init(CompressionMode m, const double tol[COMPRESSION_METRICS], int64_t max_gap)
+{
+  mode = m;
+  memcpy(tolerance, tol, sizeof(tolerance));
+  max_gap_ms = max_gap;
+}
+
+int compression_parse_mode(const char *name)
+{
+  for (int i = 0; i < (int)(sizeof(mode_names) / sizeof(mode_names[0])); i++)
+  {
+    if (strcmp(name, mode_names[i]) == 0)
+      return i;
+  }
+  return -1;
+}
+
+const char *compression_mode_name(CompressionMode m)
+{
+  return (m >= COMPRESSION_OFF && m <= COMPRESSION_SWINGING_DOOR) ? mode_names[m] : "?";
+}
+
+static int growDevices(int device)
+{
+  int capacity = device_capacity ? device_capacity : 8;
+  while (capacity <= device)
+    capacity *= 2;
+
+  DeviceState *grown = realloc(states, (size_t)capacity * sizeof(DeviceState));
+  if (!grown)
+    return -1;
+
+  memset(grown + device_capacity, 0, (size_t)(capacity - device_capacity) * sizeof(DeviceState));
+  states = grown;
+  device_capacity = capacity;
+  return 0;
+}
+
+static void archive(DeviceState *s, const CompressedPoint *p, CompressedPoint *out)
+{
+  s->archived = *p;
+  s->active = 1;
+  s->held_valid = 0;
+  *out = *p;
+}
+
+// Nouveau corridor depuis archived, limité par la lecture p
+static void openCorridor(DeviceState *s, const CompressedPoint *p)
+{
+  double dt = (double)(p->ts_ms - s->archived.ts_ms);
+
+  for (int m = 0; m < COMPRESSION_METRICS; m++)
+  {
+    s->up[m] = (p->value[m] + tolerance[m] - s->archived.value[m]) / dt;
+    s->lo[m] = (p->value[m] - tolerance[m] - s->archived.value[m]) / dt;
+  }
+  s->held = *p;
+  s->held_valid = 1;
+}
+
+/*
+ * Stocke la lecture en attente, ramenée sur la pente du corridor la plus
+ * proche de la sienne : la droite depuis archived reste alors à moins de la
+ * tolérance de toutes les lectures filtrées, elle comprise.
+ */
+static void archiveHeld(DeviceState *s, CompressedPoint *out)
+{
+  CompressedPoint p = s->held;
+  double dt = (double)(p.ts_ms - s->archived.ts_ms);
+
+  for (int m = 0; m < COMPRESSION_METRICS; m++)
+  {
+    double slope = (p.value[m] - s->archived.value[m]) / dt;
+    slope = fmin(fmax(slope, s->lo[m]), s->up[m]);
+    p.value[m] = s->archived.value[m] + slope * dt;
+  }
+
+  archive(s, &p, out);
+}
+
+static int offerDeadband(DeviceState *s, const CompressedPoint *p, CompressedPoint out[2])
+{
+  int changed = (p->ts_ms - s->archived.ts_ms >= max_gap_ms);
+
+  for (int m = 0; m < COMPRESSION_METRICS && !changed; m++)
+    changed = fabs(p->value[m] - s->archived.value[m]) > tolerance[m];
+
+  if (!changed)
+    return 0;
+
+  archive(s, p, &out[0]);
+  return 1;
+}
+
+static int offerSwingingDoor(DeviceState *s, const CompressedPoint *p, CompressedPoint out[2])
+{
+  int n = 0;
+
+  // Battement : la lecture en attente puis, si l'écart reste trop grand, celle-ci
+  if (p->ts_ms - s->archived.ts_ms >= max_gap_ms && s->held_valid)
+    archiveHeld(s, &out[n++]);
+
+  if (p->ts_ms - s->archived.ts_ms >= max_gap_ms)
+  {
+    archive(s, p, &out[n++]);
+    return n;
+  }
+
+  if (!s->held_valid)
+  {
+    openCorridor(s, p);
+    return n;
+  }
+
+  double dt = (double)(p->ts_ms - s->archived.ts_ms);
+  double up[COMPRESSION_METRICS], lo[COMPRESSION_METRICS];
+  int open = 0;
+
+  for (int m = 0; m < COMPRESSION_METRICS; m++)
+  {
+    up[m] = fmin(s->up[m], (p->value[m] + tolerance[m] - s->archived.value[m]) / dt);
+    lo[m] = fmax(s->lo[m], (p->value[m] - tolerance[m] - s->archived.value[m]) / dt);
+    open |= (lo[m] > up[m]);
+  }
+
+  // Plus aucune droite depuis archived ne couvre toutes les lectures : la porte s'ouvre
+  if (open)
+  {
+    archiveHeld(s, &out[n++]);
+    openCorridor(s, p);
+    return n;
+  }
+
+  memcpy(s->up, up, sizeof(up));
+  memcpy(s->lo, lo, sizeof(lo));
+  s->held = *p;
+  return n;
+}
+
+int compression_offer(int device, int64_t ts_ms, const double value[COMPRESSION_METRICS], CompressedPoint out[2])
+{
+  CompressedPoint p = {.ts_ms = ts_ms};
+  memcpy(p.value, value, sizeof(p.value));
+
+  if (mode == COMPRESSION_OFF || device < 0)
+  {
+    out[0] = p;
+    return 1;
+  }
+
+  if (device >= device_capacity && growDevices(device) != 0)
+    return -1;
+
+  DeviceState *s = &states[device];
+  if (!s->active)
+  {
+    archive(s, &p, &out[0]);
+    return 1;
+  }
+
+  // Rattrapage ou doublon : hors de la séquence filtrée, stocké tel quel
+  int64_t last_ts = s->held_valid ? s->held.ts_ms : s->archived.ts_ms;
+  if (ts_ms <= last_ts)
+  {
+    out[0] = p;
+    return 1;
+  }
+
+  if (mode == COMPRESSION_DEADBAND)
+    return offerDeadband(s, &p, out);
+
+  return offerSwingingDoor(s, &p, out);
+}
+
+int compression_flush(int64_t before_ms, CompressionStoreCallback store, void *ctx)
+{
+  int flushed = 0;
+
+  for (int d = 0; d < device_capacity; d++)
+  {
+    DeviceState *s = &states[d];
+    if (!s->held_valid || s->held.ts_ms >= before_ms)
+      continue;
+
+    CompressedPoint point;
+    archiveHeld(s, &point);
+    if (store(ctx, d, &point) == 0)
+      flushed++;
+  }
+
+  return flushed;
+}
+
+void compression_close(void)
+{
+  free(states);
+  states = NULL;
+  device_capacity = 0;
+}
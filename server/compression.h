@@ -0,0 +1,101 @@
+#ifndef COMPRESSION_H
+#define COMPRESSION_H
+
+#include <stdint.h>
+
+#define COMPRESSION_METRICS 3
+
+// ===== COMPRESSION À L'INGESTION =====
+
+/*
+ * Filtre les lectures avant leur écriture dans mesures, par appareil. Une
+ * ligne est écrite dès qu'une des trois métriques (temperature, pression,
+ * humidite) sort de sa tolérance ; les agrégats et la fenêtre récente
+ * reçoivent toujours toutes les lectures.
+ *
+ * Garantie de reconstruction, pour toute lecture filtrée à l'instant t :
+ *   - bande morte : la dernière ligne stockée avant t est à moins de la
+ *     tolérance (valeur tenue jusqu'à la ligne suivante) ;
+ *   - porte pivotante : l'interpolation linéaire entre les lignes stockées
+ *     qui encadrent t est à moins de la tolérance. Les lignes stockées sont
+ *     ramenées dans le corridor : leur valeur peut différer de la lecture
+ *     brute, de la tolérance au plus.
+ * Le stockage compact (dixièmes entiers) ajoute au plus 0,05.
+ *
+ * Battement : deux lignes stockées d'un appareil actif sont espacées d'au
+ * plus max_gap_ms (plus un intervalle de mesure). Les lectures antérieures
+ * au dernier point retenu (rattrapage) sont stockées telles quelles.
+ *
+ * Uniquement utilisé par le thread d'écriture : aucun verrou.
+ */
+
+typedef enum
+{
+  COMPRESSION_OFF = 0,
+  COMPRESSION_DEADBAND,
+  COMPRESSION_SWINGING_DOOR
+} CompressionMode;
+
+/**
+ * @brief Ligne à stocker
+ */
+typedef struct
+{
+  int64_t ts_ms;
+  double value[COMPRESSION_METRICS]; // temperature, pression, humidite
+} CompressedPoint;
+
+/**
+ * @brief Appelé pour chaque ligne retenue par compression_flush()
+ * @return 0 si succès, autre valeur en cas d'erreur
+ */
+typedef int (*CompressionStoreCallback)(void *ctx, int device, const CompressedPoint *point);
+
+/**
+ * @brief Initialise le filtre
+ * @param mode Mode de compression
+ * @param tolerance Écart toléré par métrique (°C, hPa, %)
+ * @param max_gap_ms Écart maximal entre deux lignes stockées d'un appareil
+ */
+void compression_init(CompressionMode mode, const double tolerance[COMPRESSION_METRICS], int64_t max_gap_ms);
+
+/**
+ * @brief Mode lu dans la configuration ("off", "deadband", "swinging_door")
+ * @return Mode, -1 si le nom est inconnu
+ */
+int compression_parse_mode(const char *name);
+
+/**
+ * @brief Nom d'un mode
+ */
+const char *compression_mode_name(CompressionMode mode);
+
+/**
+ * @brief Soumet une lecture
+ * @param device Appareil
+ * @param ts_ms Instant de la lecture
+ * @param value Valeurs de la lecture
+ * @param out Lignes à stocker, dans l'ordre (2 au plus)
+ * @return Nombre de lignes à stocker (0 : lecture filtrée), -1 en cas d'erreur d'allocation
+ */
+int compression_offer(int device, int64_t ts_ms, const double value[COMPRESSION_METRICS], CompressedPoint out[2]);
+
+/**
+ * @brief Retient les lectures en attente des appareils muets depuis before_ms
+ *
+ * La porte pivotante garde la dernière lecture jusqu'à la suivante : un
+ * appareil qui se tait la laisserait en mémoire. INT64_MAX : toutes (arrêt).
+ *
+ * @param before_ms Lectures en attente antérieures à cet instant
+ * @param store Appelé pour chaque ligne retenue
+ * @param ctx Contexte passé à store
+ * @return Nombre de lignes retenues
+ */
+int compression_flush(int64_t before_ms, CompressionStoreCallback store, void *ctx);
+
+/**
+ * @brief Libère l'état par appareil
+ */
+void compression_close(void);
+
+#endif // COMPRESSION_H
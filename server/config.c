@@ -7,18 +7,84 @@ void config_init_defaults(Config *cfg)
   // MQTT
   strcpy(cfg->mqtt.broker_address, "tcp://localhost:1883");
   strcpy(cfg->mqtt.topic, "esp32/data");
-  strcpy(cfg->mqtt.topic, "server/data");
+  strcpy(cfg->mqtt.topic_republish, "server/data");
   strcpy(cfg->mqtt.client_id, "UnixSubscriber");
   cfg->mqtt.qos = 1;
   cfg->mqtt.keepalive_interval = 60;
+  cfg->mqtt.max_inflight = 32;
+  strcpy(cfg->mqtt.share_group, "mqtt_subscriber");
+  strcpy(cfg->mqtt.backfill_topic, "esp32/backfill");
+
+  // Republication
+  strcpy(cfg->republish.mode, "all");
+  cfg->republish.min_interval_ms = 1000;
+  cfg->republish.temperature = 0.5;
+  cfg->republish.pression = 1.0;
+  cfg->republish.humidite = 2.0;
+  strcpy(cfg->republish.snapshot_topic, "server/+/latest");
 
   // Database
   strcpy(cfg->database.path, "data/donnees_esp32.db");
   cfg->database.retention_hours = 3;
-  cfg->database.cleanup_batch_size = 2000;
+  cfg->database.partition_hours = 1;
+  cfg->database.max_devices = 256;
+  cfg->database.compact_values = 1;
+  cfg->database.batch_size = 100;
+  cfg->database.batch_timeout_ms = 1000;
+
+  // Rollup
+  cfg->rollup.enabled = 1;
+  cfg->rollup.retention_1m_hours = 48;
+  cfg->rollup.retention_1h_hours = 24 * 365;
+
+  strcpy(cfg->compression.mode, "off");
+  cfg->compression.temperature = 0.1;
+  cfg->compression.pression = 0.2;
+  cfg->compression.humidite = 0.5;
+  cfg->compression.max_gap_s = 300;
+
+  // Fenêtres glissantes
+  cfg->window.enabled = 1;
+  cfg->window.sizes_s[0] = 60;
+  cfg->window.sizes_s[1] = 900;
+  cfg->window.sizes_s[2] = 10800;
+  cfg->window.size_count = 3;
+  strcpy(cfg->window.topic, "server/+/window");
+
+  // Alertes (règles : [[alerts.rule]])
+  cfg->alerts.enabled = 1;
+  strcpy(cfg->alerts.topic, "server/+/alert");
+
+  // Archive
+  cfg->archive.enabled = 1;
+  strcpy(cfg->archive.dir, "data/archive");
+
+  // Queue
+  cfg->queue.capacity = 1024;
+  cfg->queue.stats_interval = 60;
+  cfg->queue.workers = 1;
+  cfg->queue.backfill_capacity = 256;
+  cfg->queue.backfill_burst = 4;
+
+  // Query
+  cfg->query.enabled = 1;
+  strcpy(cfg->query.socket_path, "data/query.sock");
+  cfg->query.max_samples = 65536;
+
+  // Fanout
+  cfg->fanout.enabled = 0;
+  strcpy(cfg->fanout.socket_path, "data/fanout.sock");
+  cfg->fanout.max_clients = 64;
+  cfg->fanout.client_queue = 256;
+
+  // Stats
+  cfg->stats.enabled = 1;
+  cfg->stats.interval = 10;
+  strcpy(cfg->stats.topic, "server/sys/stats");
+  strcpy(cfg->stats.prometheus_file, "data/mqtt_subscriber.prom");
 
   // Logging
-  strcpy(cfg->logging.cleanup_log, "scripts/cleanbd.log");
+  strcpy(cfg->logging.cleanup_log, "data/retention.log");
   cfg->logging.display_messages = 1;
 
   // Paths
@@ -86,7 +152,7 @@ int config_load(Config *cfg, const char *config_file)
     toml_datum_t topic_republish = toml_string_in(mqtt, "topic_republish");
     if (topic_republish.ok)
     {
-      strncpy(cfg->mqtt.topic_republish, topic.u.s, sizeof(cfg->mqtt.topic_republish) - 1);
+      strncpy(cfg->mqtt.topic_republish, topic_republish.u.s, sizeof(cfg->mqtt.topic_republish) - 1);
       free(topic_republish.u.s);
     }
 
@@ -104,6 +170,60 @@ int config_load(Config *cfg, const char *config_file)
     toml_datum_t keepalive = toml_int_in(mqtt, "keepalive_interval");
     if (keepalive.ok)
       cfg->mqtt.keepalive_interval = (int)keepalive.u.i;
+
+    toml_datum_t max_inflight = toml_int_in(mqtt, "max_inflight");
+    if (max_inflight.ok)
+      cfg->mqtt.max_inflight = (int)max_inflight.u.i;
+
+    toml_datum_t share_group = toml_string_in(mqtt, "share_group");
+    if (share_group.ok)
+    {
+      strncpy(cfg->mqtt.share_group, share_group.u.s, sizeof(cfg->mqtt.share_group) - 1);
+      free(share_group.u.s);
+    }
+
+    toml_datum_t backfill_topic = toml_string_in(mqtt, "backfill_topic");
+    if (backfill_topic.ok)
+    {
+      strncpy(cfg->mqtt.backfill_topic, backfill_topic.u.s, sizeof(cfg->mqtt.backfill_topic) - 1);
+      free(backfill_topic.u.s);
+    }
+  }
+
+  // ===== SECTION [republish] =====
+  toml_table_t *republish = toml_table_in(conf, "republish");
+  if (republish)
+  {
+    toml_datum_t mode = toml_string_in(republish, "mode");
+    if (mode.ok)
+    {
+      strncpy(cfg->republish.mode, mode.u.s, sizeof(cfg->republish.mode) - 1);
+      free(mode.u.s);
+    }
+
+    toml_datum_t min_interval = toml_int_in(republish, "min_interval_ms");
+    if (min_interval.ok)
+      cfg->republish.min_interval_ms = (int)min_interval.u.i;
+
+    // Écarts en flottants (0.5, 1.0) : un entier TOML n'est pas un double
+    toml_datum_t temperature = toml_double_in(republish, "temperature");
+    if (temperature.ok)
+      cfg->republish.temperature = temperature.u.d;
+
+    toml_datum_t pression = toml_double_in(republish, "pression");
+    if (pression.ok)
+      cfg->republish.pression = pression.u.d;
+
+    toml_datum_t humidite = toml_double_in(republish, "humidite");
+    if (humidite.ok)
+      cfg->republish.humidite = humidite.u.d;
+
+    toml_datum_t snapshot_topic = toml_string_in(republish, "snapshot_topic");
+    if (snapshot_topic.ok)
+    {
+      strncpy(cfg->republish.snapshot_topic, snapshot_topic.u.s, sizeof(cfg->republish.snapshot_topic) - 1);
+      free(snapshot_topic.u.s);
+    }
   }
 
   // ===== SECTION [database] =====
@@ -121,9 +241,278 @@ int config_load(Config *cfg, const char *config_file)
     if (retention.ok)
       cfg->database.retention_hours = (int)retention.u.i;
 
-    toml_datum_t batch = toml_int_in(database, "cleanup_batch_size");
-    if (batch.ok)
-      cfg->database.cleanup_batch_size = (int)batch.u.i;
+    toml_datum_t partition = toml_int_in(database, "partition_hours");
+    if (partition.ok)
+      cfg->database.partition_hours = (int)partition.u.i;
+
+    toml_datum_t max_devices = toml_int_in(database, "max_devices");
+    if (max_devices.ok)
+      cfg->database.max_devices = (int)max_devices.u.i;
+
+    toml_datum_t compact = toml_bool_in(database, "compact_values");
+    if (compact.ok)
+      cfg->database.compact_values = compact.u.b;
+
+    toml_datum_t batch_size = toml_int_in(database, "batch_size");
+    if (batch_size.ok)
+      cfg->database.batch_size = (int)batch_size.u.i;
+
+    toml_datum_t batch_timeout = toml_int_in(database, "batch_timeout_ms");
+    if (batch_timeout.ok)
+      cfg->database.batch_timeout_ms = (int)batch_timeout.u.i;
+  }
+
+  // ===== SECTION [rollup] =====
+  toml_table_t *rollup = toml_table_in(conf, "rollup");
+  if (rollup)
+  {
+    toml_datum_t enabled = toml_bool_in(rollup, "enabled");
+    if (enabled.ok)
+      cfg->rollup.enabled = enabled.u.b;
+
+    toml_datum_t retention_1m = toml_int_in(rollup, "retention_1m_hours");
+    if (retention_1m.ok)
+      cfg->rollup.retention_1m_hours = (int)retention_1m.u.i;
+
+    toml_datum_t retention_1h = toml_int_in(rollup, "retention_1h_hours");
+    if (retention_1h.ok)
+      cfg->rollup.retention_1h_hours = (int)retention_1h.u.i;
+  }
+
+  // ===== SECTION [archive] =====
+  toml_table_t *archive = toml_table_in(conf, "archive");
+  if (archive)
+  {
+    toml_datum_t enabled = toml_bool_in(archive, "enabled");
+    if (enabled.ok)
+      cfg->archive.enabled = enabled.u.b;
+
+    toml_datum_t dir = toml_string_in(archive, "dir");
+    if (dir.ok)
+    {
+      strncpy(cfg->archive.dir, dir.u.s, sizeof(cfg->archive.dir) - 1);
+      free(dir.u.s);
+    }
+  }
+
+  // ===== SECTION [compression] =====
+  toml_table_t *compression = toml_table_in(conf, "compression");
+  if (compression)
+  {
+    toml_datum_t mode = toml_string_in(compression, "mode");
+    if (mode.ok)
+    {
+      strncpy(cfg->compression.mode, mode.u.s, sizeof(cfg->compression.mode) - 1);
+      free(mode.u.s);
+    }
+
+    // Tolérances en flottants (0.1, 1.0) : un entier TOML n'est pas un double
+    toml_datum_t temperature = toml_double_in(compression, "temperature");
+    if (temperature.ok)
+      cfg->compression.temperature = temperature.u.d;
+
+    toml_datum_t pression = toml_double_in(compression, "pression");
+    if (pression.ok)
+      cfg->compression.pression = pression.u.d;
+
+    toml_datum_t humidite = toml_double_in(compression, "humidite");
+    if (humidite.ok)
+      cfg->compression.humidite = humidite.u.d;
+
+    toml_datum_t max_gap = toml_int_in(compression, "max_gap_s");
+    if (max_gap.ok)
+      cfg->compression.max_gap_s = (int)max_gap.u.i;
+  }
+
+  // ===== SECTION [window] =====
+  toml_table_t *window = toml_table_in(conf, "window");
+  if (window)
+  {
+    toml_datum_t enabled = toml_bool_in(window, "enabled");
+    if (enabled.ok)
+      cfg->window.enabled = enabled.u.b;
+
+    toml_array_t *sizes = toml_array_in(window, "sizes_s");
+    if (sizes)
+    {
+      int count = toml_array_nelem(sizes);
+      int max = (int)(sizeof(cfg->window.sizes_s) / sizeof(cfg->window.sizes_s[0]));
+      cfg->window.size_count = 0;
+      for (int i = 0; i < count && i < max; i++)
+      {
+        toml_datum_t size = toml_int_at(sizes, i);
+        if (size.ok)
+          cfg->window.sizes_s[cfg->window.size_count++] = (int)size.u.i;
+      }
+    }
+
+    toml_datum_t topic = toml_string_in(window, "topic");
+    if (topic.ok)
+    {
+      strncpy(cfg->window.topic, topic.u.s, sizeof(cfg->window.topic) - 1);
+      free(topic.u.s);
+    }
+  }
+
+  // ===== SECTION [alerts] =====
+  toml_table_t *alerts = toml_table_in(conf, "alerts");
+  if (alerts)
+  {
+    toml_datum_t enabled = toml_bool_in(alerts, "enabled");
+    if (enabled.ok)
+      cfg->alerts.enabled = enabled.u.b;
+
+    toml_datum_t topic = toml_string_in(alerts, "topic");
+    if (topic.ok)
+    {
+      strncpy(cfg->alerts.topic, topic.u.s, sizeof(cfg->alerts.topic) - 1);
+      free(topic.u.s);
+    }
+
+    toml_array_t *rules = toml_array_in(alerts, "rule");
+    int count = rules ? toml_array_nelem(rules) : 0;
+    if (count > ALERT_MAX_RULES)
+    {
+      fprintf(stderr, "Trop de règles d'alerte (%d), %d premières gardées\n", count, ALERT_MAX_RULES);
+      count = ALERT_MAX_RULES;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+      toml_table_t *rule = toml_table_at(rules, i);
+      if (!rule)
+        continue;
+
+      AlertRuleConfig *r = &cfg->alerts.rules[cfg->alerts.rule_count++];
+      const char *keys[] = {"name", "device", "kind", "metric"};
+      char *fields[] = {r->name, r->device, r->kind, r->metric};
+      size_t sizes[] = {sizeof(r->name), sizeof(r->device), sizeof(r->kind), sizeof(r->metric)};
+
+      for (int k = 0; k < 4; k++)
+      {
+        toml_datum_t value = toml_string_in(rule, keys[k]);
+        if (value.ok)
+        {
+          strncpy(fields[k], value.u.s, sizes[k] - 1);
+          free(value.u.s);
+        }
+      }
+      if (!r->name[0])
+        snprintf(r->name, sizeof(r->name), "regle_%d", i + 1);
+
+      // Seuils en flottants (30.0, -2.0) : un entier TOML n'est pas un double
+      toml_datum_t threshold = toml_double_in(rule, "threshold");
+      if (threshold.ok)
+        r->threshold = threshold.u.d;
+
+      toml_datum_t hysteresis = toml_double_in(rule, "hysteresis");
+      if (hysteresis.ok)
+        r->hysteresis = hysteresis.u.d;
+
+      toml_datum_t window_s = toml_int_in(rule, "window_s");
+      if (window_s.ok)
+        r->window_s = (int)window_s.u.i;
+
+      toml_datum_t timeout_s = toml_int_in(rule, "timeout_s");
+      if (timeout_s.ok)
+        r->timeout_s = (int)timeout_s.u.i;
+    }
+  }
+
+  // ===== SECTION [queue] =====
+  toml_table_t *queue = toml_table_in(conf, "queue");
+  if (queue)
+  {
+    toml_datum_t capacity = toml_int_in(queue, "capacity");
+    if (capacity.ok)
+      cfg->queue.capacity = (int)capacity.u.i;
+
+    toml_datum_t stats_interval = toml_int_in(queue, "stats_interval");
+    if (stats_interval.ok)
+      cfg->queue.stats_interval = (int)stats_interval.u.i;
+
+    toml_datum_t workers = toml_int_in(queue, "workers");
+    if (workers.ok)
+      cfg->queue.workers = (int)workers.u.i;
+
+    toml_datum_t backfill_capacity = toml_int_in(queue, "backfill_capacity");
+    if (backfill_capacity.ok)
+      cfg->queue.backfill_capacity = (int)backfill_capacity.u.i;
+
+    toml_datum_t backfill_burst = toml_int_in(queue, "backfill_burst");
+    if (backfill_burst.ok)
+      cfg->queue.backfill_burst = (int)backfill_burst.u.i;
+  }
+
+  // ===== SECTION [query] =====
+  toml_table_t *query = toml_table_in(conf, "query");
+  if (query)
+  {
+    toml_datum_t enabled = toml_bool_in(query, "enabled");
+    if (enabled.ok)
+      cfg->query.enabled = enabled.u.b;
+
+    toml_datum_t socket_path = toml_string_in(query, "socket");
+    if (socket_path.ok)
+    {
+      strncpy(cfg->query.socket_path, socket_path.u.s, sizeof(cfg->query.socket_path) - 1);
+      free(socket_path.u.s);
+    }
+
+    toml_datum_t max_samples = toml_int_in(query, "max_samples");
+    if (max_samples.ok)
+      cfg->query.max_samples = (int)max_samples.u.i;
+  }
+
+  // ===== SECTION [fanout] =====
+  toml_table_t *fanout = toml_table_in(conf, "fanout");
+  if (fanout)
+  {
+    toml_datum_t enabled = toml_bool_in(fanout, "enabled");
+    if (enabled.ok)
+      cfg->fanout.enabled = enabled.u.b;
+
+    toml_datum_t socket_path = toml_string_in(fanout, "socket");
+    if (socket_path.ok)
+    {
+      strncpy(cfg->fanout.socket_path, socket_path.u.s, sizeof(cfg->fanout.socket_path) - 1);
+      free(socket_path.u.s);
+    }
+
+    toml_datum_t max_clients = toml_int_in(fanout, "max_clients");
+    if (max_clients.ok)
+      cfg->fanout.max_clients = (int)max_clients.u.i;
+
+    toml_datum_t client_queue = toml_int_in(fanout, "client_queue");
+    if (client_queue.ok)
+      cfg->fanout.client_queue = (int)client_queue.u.i;
+  }
+
+  // ===== SECTION [stats] =====
+  toml_table_t *stats = toml_table_in(conf, "stats");
+  if (stats)
+  {
+    toml_datum_t enabled = toml_bool_in(stats, "enabled");
+    if (enabled.ok)
+      cfg->stats.enabled = enabled.u.b;
+
+    toml_datum_t interval = toml_int_in(stats, "interval");
+    if (interval.ok)
+      cfg->stats.interval = (int)interval.u.i;
+
+    toml_datum_t topic = toml_string_in(stats, "topic");
+    if (topic.ok)
+    {
+      strncpy(cfg->stats.topic, topic.u.s, sizeof(cfg->stats.topic) - 1);
+      free(topic.u.s);
+    }
+
+    toml_datum_t prometheus_file = toml_string_in(stats, "prometheus_file");
+    if (prometheus_file.ok)
+    {
+      strncpy(cfg->stats.prometheus_file, prometheus_file.u.s, sizeof(cfg->stats.prometheus_file) - 1);
+      free(prometheus_file.u.s);
+    }
   }
 
   // ===== SECTION [logging] =====
@@ -176,7 +565,8 @@ int config_load(Config *cfg, const char *config_file)
 
 void config_resolve_path(const Config *cfg, const char *relative_path, char *output, size_t output_size)
 {
-  if (relative_path[0] == '/')
+  // Chemins absolus et noms spéciaux SQLite (":memory:") inchangés
+  if (relative_path[0] == '/' || relative_path[0] == ':')
   {
     snprintf(output, output_size, "%s", relative_path);
   }
@@ -198,11 +588,98 @@ void config_display(const Config *cfg)
   printf("  Client ID : %s\n", cfg->mqtt.client_id);
   printf("  QoS : %d\n", cfg->mqtt.qos);
   printf("  Keepalive : %d s\n", cfg->mqtt.keepalive_interval);
+  printf("  Republications en vol : %d max\n", cfg->mqtt.max_inflight);
+  printf("  Topic rattrapage : %s\n", cfg->mqtt.backfill_topic[0] ? cfg->mqtt.backfill_topic : "(désactivé)");
+
+  printf("\n[Republish]\n");
+  if (strcmp(cfg->republish.mode, "conflate") == 0)
+    printf("  Mode : conflate (au plus une toutes les %d ms, ou écart de %.2f °C, %.2f hPa, %.2f %%)\n",
+           cfg->republish.min_interval_ms, cfg->republish.temperature, cfg->republish.pression,
+           cfg->republish.humidite);
+  else
+    printf("  Mode : %s\n", cfg->republish.mode);
+  printf("  Dernière mesure retenue : %s\n",
+         cfg->republish.snapshot_topic[0] ? cfg->republish.snapshot_topic : "(désactivée)");
 
   printf("\n[Database]\n");
   printf("  Path : %s\n", cfg->database.path);
   printf("  Rétention : %d heures\n", cfg->database.retention_hours);
-  printf("  Batch cleanup : %d\n", cfg->database.cleanup_batch_size);
+  printf("  Partitions : %d heure(s), valeurs %s\n", cfg->database.partition_hours,
+         cfg->database.compact_values ? "compactes (dixièmes entiers)" : "REAL");
+  printf("  Batch écriture : %d lignes / %d ms\n", cfg->database.batch_size, cfg->database.batch_timeout_ms);
+  printf("  Appareils : %d au plus\n", cfg->database.max_devices);
+
+  printf("\n[Rollup]\n");
+  printf("  Agrégats : %s\n", cfg->rollup.enabled ? "activés" : "désactivés");
+  printf("  Rétention 1 min : %d heures\n", cfg->rollup.retention_1m_hours);
+  printf("  Rétention 1 h : %d heures\n", cfg->rollup.retention_1h_hours);
+
+  printf("\n[Compression]\n");
+  printf("  Mode : %s\n", cfg->compression.mode);
+  if (strcmp(cfg->compression.mode, "off") != 0)
+    printf("  Tolérances : %.2f °C, %.2f hPa, %.2f %%, une ligne au moins toutes les %d s\n",
+           cfg->compression.temperature, cfg->compression.pression, cfg->compression.humidite,
+           cfg->compression.max_gap_s);
+
+  printf("\n[Window]\n");
+  printf("  Fenêtres glissantes : %s\n", cfg->window.enabled ? "activées" : "désactivées");
+  if (cfg->window.enabled)
+  {
+    printf("  Largeurs :");
+    for (int i = 0; i < cfg->window.size_count; i++)
+      printf(" %d s", cfg->window.sizes_s[i]);
+    printf("\n  Topic : %s\n", cfg->window.topic);
+  }
+
+  printf("\n[Alerts]\n");
+  printf("  Alertes : %s\n", cfg->alerts.enabled ? "activées" : "désactivées");
+  if (cfg->alerts.enabled)
+  {
+    printf("  Topic : %s\n", cfg->alerts.topic);
+    for (int i = 0; i < cfg->alerts.rule_count; i++)
+    {
+      const AlertRuleConfig *r = &cfg->alerts.rules[i];
+      printf("  %s : %s %s", r->name, r->kind, r->metric);
+      if (strcmp(r->kind, "stale") == 0)
+        printf("%d s", r->timeout_s);
+      else
+        printf(" %.2f (hystérésis %.2f)", r->threshold, r->hysteresis);
+      if (strcmp(r->kind, "rate") == 0)
+        printf(" sur %d s", r->window_s);
+      printf(", %s\n", r->device[0] ? r->device : "tous les appareils");
+    }
+  }
+
+  printf("\n[Archive]\n");
+  printf("  Archive froide : %s\n", cfg->archive.enabled ? "activée" : "désactivée");
+  printf("  Dossier : %s\n", cfg->archive.dir);
+
+  printf("\n[Queue]\n");
+  printf("  Capacité : %d messages\n", cfg->queue.capacity);
+  printf("  Compteurs : toutes les %d s\n", cfg->queue.stats_interval);
+  if (cfg->queue.workers > 1)
+    printf("  Workers : %d ($share/%s/%s)\n", cfg->queue.workers, cfg->mqtt.share_group, cfg->mqtt.topic);
+  else
+    printf("  Workers : 1\n");
+  if (cfg->mqtt.backfill_topic[0])
+    printf("  Rattrapage : %d messages, %d par tour d'écriture\n", cfg->queue.backfill_capacity,
+           cfg->queue.backfill_burst);
+
+  printf("\n[Query]\n");
+  printf("  Service de requêtes : %s\n", cfg->query.enabled ? "activé" : "désactivé");
+  printf("  Socket : %s\n", cfg->query.socket_path);
+  printf("  Fenêtre : %d heures, %d mesures max par appareil\n",
+         cfg->database.retention_hours, cfg->query.max_samples);
+
+  printf("\n[Fanout]\n");
+  printf("  Diffusion locale : %s\n", cfg->fanout.enabled ? "activée" : "désactivée");
+  printf("  Socket : %s\n", cfg->fanout.socket_path);
+  printf("  Lecteurs : %d max, %d trames en attente chacun\n", cfg->fanout.max_clients, cfg->fanout.client_queue);
+
+  printf("\n[Stats]\n");
+  printf("  Instrumentation : %s\n", cfg->stats.enabled ? "activée" : "désactivée");
+  printf("  Export : toutes les %d s sur %s et %s\n", cfg->stats.interval, cfg->stats.topic,
+         cfg->stats.prometheus_file[0] ? cfg->stats.prometheus_file : "(pas de fichier)");
 
   printf("\n[Logging]\n");
   printf("  Cleanup : %s\n", cfg->logging.cleanup_log);
@@ -10,6 +10,7 @@
 #include <limits.h>
 
 #define PATH_SIZE 256
+#define ALERT_MAX_RULES 64
 
 // ===== STRUCTURES DE CONFIGURATION =====
 
@@ -21,15 +22,114 @@ typedef struct
   char client_id[64];
   int qos;
   int keepalive_interval;
+  int max_inflight;
+  char share_group[64];
+  char backfill_topic[128];
 } MqttConfig;
 
+typedef struct
+{
+  char mode[16];          // all, conflate
+  int min_interval_ms;    // conflate : écart minimal par appareil
+  double temperature;     // écarts qui forcent une republication
+  double pression;
+  double humidite;
+  char snapshot_topic[128]; // dernière mesure retenue, '+' : nom de l'appareil
+} RepublishConfig;
+
 typedef struct
 {
   char path[512];
   int retention_hours;
-  int cleanup_batch_size;
+  int partition_hours;
+  int compact_values;
+  int batch_size;
+  int batch_timeout_ms;
+  int max_devices; // appareils nouveaux refusés au-delà
 } DatabaseConfig;
 
+typedef struct
+{
+  int enabled;
+  int retention_1m_hours;
+  int retention_1h_hours;
+} RollupConfig;
+
+typedef struct
+{
+  int enabled;
+  char dir[512];
+} ArchiveConfig;
+
+typedef struct
+{
+  char mode[32]; // off, deadband, swinging_door
+  double temperature; // tolérances, dans l'unité de la métrique
+  double pression;
+  double humidite;
+  int max_gap_s;
+} CompressionConfig;
+
+typedef struct
+{
+  int enabled;
+  int sizes_s[8]; // largeurs des fenêtres glissantes, croissantes
+  int size_count;
+  char topic[128]; // '+' remplacé par le nom de l'appareil
+} WindowConfig;
+
+typedef struct
+{
+  char name[64];
+  char device[32];  // "" : tous les appareils
+  char kind[16];    // above, below, rate, stale
+  char metric[16];  // temperature, pression, humidite (sauf stale)
+  double threshold; // seuil, variation sur window_s (rate, signée)
+  double hysteresis;
+  int window_s;     // rate
+  int timeout_s;    // stale
+} AlertRuleConfig;
+
+typedef struct
+{
+  int enabled;
+  char topic[128]; // '+' remplacé par le nom de l'appareil
+  int rule_count;
+  AlertRuleConfig rules[ALERT_MAX_RULES];
+} AlertsConfig;
+
+typedef struct
+{
+  int capacity;
+  int stats_interval;
+  int workers;
+  int backfill_capacity;
+  int backfill_burst;
+} QueueConfig;
+
+typedef struct
+{
+  int enabled;
+  char socket_path[512];
+  int max_samples;
+} QueryConfig;
+
+typedef struct
+{
+  int enabled;
+  char socket_path[512];
+  int max_clients;
+  int client_queue;
+} FanoutConfig;
+
+typedef struct
+{
+  int enabled;
+  int interval;
+  char topic[128];
+  char prometheus_file[512];
+} StatsConfig;
+
 typedef struct
 {
   char cleanup_log[512];
@@ -47,7 +147,17 @@ typedef struct
 typedef struct
 {
   MqttConfig mqtt;
+  RepublishConfig republish;
   DatabaseConfig database;
+  RollupConfig rollup;
+  ArchiveConfig archive;
+  CompressionConfig compression;
+  WindowConfig window;
+  AlertsConfig alerts;
+  QueueConfig queue;
+  QueryConfig query;
+  FanoutConfig fanout;
+  StatsConfig stats;
   LoggingConfig logging;
   PathsConfig paths;
   char project_root[512];
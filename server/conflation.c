@@ -0,0 +1,148 @@
+#include "conflation.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct
+{
+  int published;   // sent renseigné
+  int pending;     // latest pas encore transmise
+  int64_t sent_ms; // instant monotone de la dernière transmission
+  double sent[CONFLATION_METRICS];
+  int64_t latest_ts;
+  double latest[CONFLATION_METRICS];
+} DeviceLatest;
+
+static int64_t min_interval_ms = 0;
+static double delta[CONFLATION_METRICS];
+static DeviceLatest *devices = NULL;
+static int device_capacity = 0;
+static int pending_count = 0;
+
+void conflation_init(int64_t interval_ms, const double d[CONFLATION_METRICS])
+{
+  min_interval_ms = interval_ms;
+  memcpy(delta, d, sizeof(delta));
+}
+
+static int growDevices(int device)
+{
+  int capacity = device_capacity ? device_capacity : 8;
+  while (capacity <= device)
+    capacity *= 2;
+
+  DeviceLatest *grown = realloc(devices, (size_t)capacity * sizeof(DeviceLatest));
+  if (!grown)
+    return -1;
+
+  memset(grown + device_capacity, 0, (size_t)(capacity - device_capacity) * sizeof(DeviceLatest));
+  devices = grown;
+  device_capacity = capacity;
+  return 0;
+}
+
+static int transmit(DeviceLatest *d, int device, int64_t now_ms, ConflationPublishCallback publish, void *ctx)
+{
+  // Échec (fenêtre de publication pleine...) : nouvel essai à l'intervalle suivant
+  if (publish(ctx, device, d->latest_ts, d->latest) != 0)
+  {
+    d->sent_ms = now_ms;
+    return 0;
+  }
+
+  if (d->pending)
+    pending_count--;
+
+  d->published = 1;
+  d->pending = 0;
+  d->sent_ms = now_ms;
+  memcpy(d->sent, d->latest, sizeof(d->sent));
+  return 1;
+}
+
+static int changed(const DeviceLatest *d)
+{
+  for (int m = 0; m < CONFLATION_METRICS; m++)
+  {
+    if (delta[m] > 0 && fabs(d->latest[m] - d->sent[m]) >= delta[m])
+      return 1;
+  }
+  return 0;
+}
+
+int conflation_offer(int device, int64_t now_ms, int64_t ts_ms, const double value[CONFLATION_METRICS],
+                     ConflationPublishCallback publish, void *ctx)
+{
+  if (device < 0)
+    return -1;
+
+  if (device >= device_capacity && growDevices(device) != 0)
+    return -1;
+
+  DeviceLatest *d = &devices[device];
+
+  // Rattrapage plus ancien que la dernière mesure : l'état courant ne change pas
+  if ((d->pending || d->published) && ts_ms < d->latest_ts)
+    return 0;
+
+  d->latest_ts = ts_ms;
+  memcpy(d->latest, value, sizeof(d->latest));
+
+  if (!d->published || now_ms - d->sent_ms >= min_interval_ms || changed(d))
+  {
+    if (transmit(d, device, now_ms, publish, ctx))
+      return 1;
+  }
+
+  if (!d->pending)
+  {
+    d->pending = 1;
+    pending_count++;
+  }
+  return 0;
+}
+
+int conflation_flush(int64_t now_ms, ConflationPublishCallback publish, void *ctx)
+{
+  int sent = 0;
+
+  for (int device = 0; pending_count > 0 && device < device_capacity; device++)
+  {
+    DeviceLatest *d = &devices[device];
+    if (d->pending && now_ms - d->sent_ms >= min_interval_ms)
+      sent += transmit(d, device, now_ms, publish, ctx);
+  }
+
+  return sent;
+}
+
+int conflation_remaining_ms(int64_t now_ms)
+{
+  if (pending_count == 0)
+    return -1;
+
+  int64_t remaining = -1;
+  for (int device = 0; device < device_capacity; device++)
+  {
+    const DeviceLatest *d = &devices[device];
+    if (!d->pending)
+      continue;
+
+    int64_t due = d->sent_ms + min_interval_ms - now_ms;
+    if (due <= 0)
+      return 0;
+    if (remaining < 0 || due < remaining)
+      remaining = due;
+  }
+
+  return (int)remaining;
+}
+
+void conflation_close(void)
+{
+  free(devices);
+  devices = NULL;
+  device_capacity = 0;
+  pending_count = 0;
+}
@@ -0,0 +1,68 @@
+#ifndef CONFLATION_H
+#define CONFLATION_H
+
+#include <stdint.h>
+
+#define CONFLATION_METRICS 3
+
+// ===== CONFLATION DES REPUBLICATIONS =====
+
+/*
+ * Garde, par appareil, la dernière mesure stockée et ne la transmet qu'au
+ * plus une fois par min_interval_ms, ou aussitôt qu'une métrique s'écarte de
+ * delta (0 : désactivé pour cette métrique) de la dernière valeur transmise.
+ * Les mesures intermédiaires sont remplacées, jamais mises en file : un
+ * abonné reçoit l'état courant au rythme choisi, quel que soit le débit des
+ * capteurs.
+ *
+ * Une mesure retenue est transmise par conflation_flush() dès que
+ * l'intervalle est écoulé ; une transmission en échec est retentée à
+ * l'intervalle suivant.
+ *
+ * Uniquement utilisé par le thread d'écriture : aucun verrou.
+ */
+
+/**
+ * @brief Appelé pour chaque mesure à transmettre
+ * @param ts_ms Instant de la mesure (epoch ms)
+ * @return 0 si transmise, autre valeur pour réessayer à l'intervalle suivant
+ */
+typedef int (*ConflationPublishCallback)(void *ctx, int device, int64_t ts_ms,
+                                         const double value[CONFLATION_METRICS]);
+
+/**
+ * @brief Initialise la conflation
+ * @param min_interval_ms Écart minimal entre deux transmissions d'un appareil
+ * @param delta Écart qui force une transmission (°C, hPa, %)
+ */
+void conflation_init(int64_t min_interval_ms, const double delta[CONFLATION_METRICS]);
+
+/**
+ * @brief Soumet la dernière mesure d'un appareil
+ * @param now_ms Instant monotone courant
+ * @param ts_ms Instant de la mesure (epoch ms)
+ * @return 1 si transmise, 0 si retenue, -1 en cas d'erreur d'allocation
+ */
+int conflation_offer(int device, int64_t now_ms, int64_t ts_ms, const double value[CONFLATION_METRICS],
+                     ConflationPublishCallback publish, void *ctx);
+
+/**
+ * @brief Transmet les mesures retenues dont l'intervalle est écoulé
+ * @param now_ms Instant monotone courant
+ * @return Nombre de mesures transmises
+ */
+int conflation_flush(int64_t now_ms, ConflationPublishCallback publish, void *ctx);
+
+/**
+ * @brief Délai avant la prochaine transmission due
+ * @param now_ms Instant monotone courant
+ * @return Millisecondes (0 : due), -1 si rien n'est retenu
+ */
+int conflation_remaining_ms(int64_t now_ms);
+
+/**
+ * @brief Libère l'état par appareil
+ */
+void conflation_close(void);
+
+#endif // CONFLATION_H
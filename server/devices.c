@@ -0,0 +1,316 @@
+#include "devices.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define INITIAL_CAPACITY 16
+
+typedef char DeviceName[DEVICE_NAME_SIZE];
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static sqlite3 *ddb = NULL;
+static DeviceName *names = NULL; // indexé par clé, names[0] inutilisé
+static int name_capacity = 0;
+static int next_id = 1;
+static int persisted_id = 0; // clés <= persisted_id déjà dans la table
+static int written_id = 0;   // clés <= written_id insérées dans la transaction en cours
+static int max_devices = 0;  // 0 : sans limite
+static int *slots = NULL;    // table de hachage nom -> clé, 0 = libre
+static size_t slot_mask = 0;
+
+static uint32_t hashName(const char *name, size_t len)
+{
+  // FNV-1a
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < len; i++)
+  {
+    h ^= (unsigned char)name[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+static int *findSlot(const char *name, size_t len)
+{
+  size_t i = hashName(name, len) & slot_mask;
+  while (slots[i] != 0)
+  {
+    const char *candidate = names[slots[i]];
+    if (strncmp(candidate, name, len) == 0 && candidate[len] == '\0')
+      break;
+    i = (i + 1) & slot_mask;
+  }
+  return &slots[i];
+}
+
+// Table de hachage remplie au plus à moitié : sondage linéaire court
+static int growSlots(void)
+{
+  size_t count = slot_mask ? (slot_mask + 1) * 2 : INITIAL_CAPACITY * 2;
+  int *grown = calloc(count, sizeof(int));
+  if (!grown)
+    return -1;
+
+  int *old = slots;
+  size_t old_count = slot_mask ? slot_mask + 1 : 0;
+  slots = grown;
+  slot_mask = count - 1;
+
+  for (size_t i = 0; i < old_count; i++)
+  {
+    if (old[i] != 0)
+      *findSlot(names[old[i]], strlen(names[old[i]])) = old[i];
+  }
+  free(old);
+  return 0;
+}
+
+static int growNames(int id)
+{
+  int capacity = name_capacity ? name_capacity : INITIAL_CAPACITY;
+  while (capacity <= id)
+    capacity *= 2;
+
+  DeviceName *grown = realloc(names, (size_t)capacity * sizeof(DeviceName));
+  if (!grown)
+    return -1;
+
+  memset(grown + name_capacity, 0, (size_t)(capacity - name_capacity) * sizeof(DeviceName));
+  names = grown;
+  name_capacity = capacity;
+  return 0;
+}
+
+// Appelé verrou pris
+static int addName(int id, const char *name, size_t len)
+{
+  if (id >= name_capacity && growNames(id) != 0)
+    return -1;
+  if ((size_t)(next_id) * 2 >= slot_mask + 1 && growSlots() != 0)
+    return -1;
+
+  memcpy(names[id], name, len);
+  names[id][len] = '\0';
+  *findSlot(name, len) = id;
+  if (id >= next_id)
+    next_id = id + 1;
+  return 0;
+}
+
+static int validName(const char *name, size_t len)
+{
+  if (len == 0 || len >= DEVICE_NAME_SIZE)
+    return 0;
+
+  for (size_t i = 0; i < len; i++)
+  {
+    if (name[i] == '/' || name[i] == '+' || name[i] == '#' || name[i] == '\0')
+      return 0;
+  }
+  return 1;
+}
+
+int devices_init(sqlite3 *db, int max)
+{
+  sqlite3_stmt *stmt = NULL;
+  char *errMsg = NULL;
+
+  ddb = db;
+  max_devices = max;
+
+  int rc = sqlite3_exec(db,
+                        "CREATE TABLE IF NOT EXISTS devices ("
+                        "id INTEGER PRIMARY KEY,"
+                        "name TEXT NOT NULL UNIQUE,"
+                        "first_seen INTEGER NOT NULL"
+                        ");",
+                        NULL, NULL, &errMsg);
+  if (rc != SQLITE_OK)
+  {
+    fprintf(stderr, "Erreur création table devices : %s\n", errMsg);
+    sqlite3_free(errMsg);
+    return rc;
+  }
+
+  rc = sqlite3_prepare_v2(db, "SELECT id, name FROM devices ORDER BY id;", -1, &stmt, NULL);
+  if (rc != SQLITE_OK)
+    return rc;
+
+  pthread_mutex_lock(&lock);
+  while (sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    int id = sqlite3_column_int(stmt, 0);
+    const char *name = (const char *)sqlite3_column_text(stmt, 1);
+    size_t len = (size_t)sqlite3_column_bytes(stmt, 1);
+
+    if (id < 1 || !validName(name, len))
+      continue;
+    if (addName(id, name, len) != 0)
+    {
+      rc = SQLITE_NOMEM;
+      break;
+    }
+  }
+  persisted_id = next_id - 1;
+  written_id = persisted_id;
+  pthread_mutex_unlock(&lock);
+
+  sqlite3_finalize(stmt);
+  return rc;
+}
+
+int devices_intern(const char *name, size_t len)
+{
+  if (!validName(name, len))
+    return -1;
+
+  pthread_mutex_lock(&lock);
+
+  int id = -1;
+  if (slots)
+    id = *findSlot(name, len);
+
+  // Appareils déjà connus toujours servis ; un nouveau au-delà de la limite est refusé
+  if (id <= 0)
+  {
+    id = next_id;
+    if ((max_devices > 0 && next_id > max_devices) || addName(id, name, len) != 0)
+      id = -1;
+  }
+
+  pthread_mutex_unlock(&lock);
+  return id;
+}
+
+int devices_name(int id, char *name, size_t size)
+{
+  int rc = -1;
+
+  pthread_mutex_lock(&lock);
+  if (id > 0 && id < next_id && names[id][0] != '\0')
+  {
+    snprintf(name, size, "%s", names[id]);
+    rc = 0;
+  }
+  pthread_mutex_unlock(&lock);
+
+  return rc;
+}
+
+int devices_count(void)
+{
+  pthread_mutex_lock(&lock);
+  int count = next_id - 1;
+  pthread_mutex_unlock(&lock);
+  return count;
+}
+
+int devices_persist(void)
+{
+  sqlite3_stmt *stmt = NULL;
+  int rc = SQLITE_OK;
+
+  pthread_mutex_lock(&lock);
+
+  // Transaction précédente annulée : ses appareils sont réinsérés
+  written_id = persisted_id;
+
+  if (persisted_id + 1 < next_id)
+  {
+    rc = sqlite3_prepare_v2(ddb, "INSERT OR IGNORE INTO devices (id, name, first_seen) VALUES (?, ?, ?);",
+                            -1, &stmt, NULL);
+
+    sqlite3_int64 now_ms = (sqlite3_int64)time(NULL) * 1000;
+    int id = persisted_id + 1;
+    for (; rc == SQLITE_OK && id < next_id; id++)
+    {
+      sqlite3_bind_int(stmt, 1, id);
+      sqlite3_bind_text(stmt, 2, names[id], -1, SQLITE_STATIC);
+      sqlite3_bind_int64(stmt, 3, now_ms);
+      if (sqlite3_step(stmt) != SQLITE_DONE)
+        rc = SQLITE_ERROR;
+      sqlite3_reset(stmt);
+    }
+
+    if (rc == SQLITE_OK)
+      written_id = next_id - 1;
+    else
+      fprintf(stderr, "Erreur enregistrement appareil : %s\n", sqlite3_errmsg(ddb));
+  }
+
+  pthread_mutex_unlock(&lock);
+
+  sqlite3_finalize(stmt);
+  return rc;
+}
+
+void devices_mark_persisted(void)
+{
+  pthread_mutex_lock(&lock);
+  persisted_id = written_id;
+  pthread_mutex_unlock(&lock);
+}
+
+int devices_match_topic(const char *filter, const char *topic, char *name, size_t size)
+{
+  const char *plus = strchr(filter, '+');
+
+  if (!plus)
+  {
+    if (strcmp(filter, topic) != 0)
+      return -1;
+    if (name && size > 0)
+      name[0] = '\0';
+    return 0;
+  }
+
+  // Préfixe jusqu'au '+', un niveau sans '/', puis le suffixe exact
+  size_t prefix = (size_t)(plus - filter);
+  if (strncmp(filter, topic, prefix) != 0)
+    return -1;
+
+  const char *level = topic + prefix;
+  const char *end = strchr(level, '/');
+  if (!end)
+    end = level + strlen(level);
+
+  size_t len = (size_t)(end - level);
+  if (len == 0 || strcmp(plus + 1, end) != 0)
+    return -1;
+
+  if (name && size > 0)
+    snprintf(name, size, "%.*s", (int)len, level);
+  return (int)len;
+}
+
+int devices_format_topic(const char *pattern, const char *name, char *out, size_t size)
+{
+  const char *plus = strchr(pattern, '+');
+  int len;
+
+  if (!plus)
+    len = snprintf(out, size, "%s", pattern);
+  else
+    len = snprintf(out, size, "%.*s%s%s", (int)(plus - pattern), pattern, name, plus + 1);
+
+  return (len < 0 || (size_t)len >= size) ? -1 : 0;
+}
+
+void devices_close(void)
+{
+  pthread_mutex_lock(&lock);
+  free(names);
+  free(slots);
+  names = NULL;
+  slots = NULL;
+  name_capacity = 0;
+  slot_mask = 0;
+  next_id = 1;
+  persisted_id = 0;
+  ddb = NULL;
+  pthread_mutex_unlock(&lock);
+}
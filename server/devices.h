@@ -0,0 +1,97 @@
+#ifndef DEVICES_H
+#define DEVICES_H
+
+#include <stddef.h>
+#include <sqlite3.h>
+
+#define DEVICE_NAME_SIZE 64
+
+// ===== APPAREILS =====
+
+/*
+ * Le nom d'un appareil (niveau '+' du topic, ex. esp32/salon/data) est
+ * remplacé par une clé entière compacte, attribuée à la première mesure et
+ * conservée dans la table devices. Les clés sont denses à partir de 1 : les
+ * tableaux par appareil (agrégats, fenêtre récente) restent petits, et la
+ * clé primaire (device, ts) des partitions reste courte.
+ *
+ * Les callbacks MQTT internent, le thread d'écriture enregistre les nouveaux
+ * noms dans sa transaction : un verrou protège la table en mémoire.
+ */
+
+/**
+ * @brief Crée la table devices et charge les appareils connus
+ * @param db Base de données du thread d'écriture
+ * @param max_devices Clés attribuées au plus (0 : sans limite) ; borne la
+ *                    taille des tableaux par appareil de tous les modules
+ * @return SQLITE_OK si succès, code d'erreur sinon
+ */
+int devices_init(sqlite3 *db, int max_devices);
+
+/**
+ * @brief Clé d'un appareil, attribuée s'il est nouveau
+ * @param name Nom de l'appareil (non terminé par '\0')
+ * @param len Longueur du nom (< DEVICE_NAME_SIZE)
+ * @return Clé (>= 1), -1 si le nom est invalide, si max_devices est atteint ou en cas d'erreur d'allocation
+ */
+int devices_intern(const char *name, size_t len);
+
+/**
+ * @brief Nom d'un appareil
+ * @param id Clé de l'appareil
+ * @param name Buffer de DEVICE_NAME_SIZE octets au moins
+ * @return 0 si succès, -1 si la clé est inconnue
+ */
+int devices_name(int id, char *name, size_t size);
+
+/**
+ * @brief Nombre d'appareils connus
+ */
+int devices_count(void);
+
+/**
+ * @brief Enregistre les appareils internés depuis le dernier appel (thread d'écriture)
+ *
+ * À appeler dans la transaction courante, avant son commit.
+ *
+ * @return SQLITE_OK si succès, code d'erreur sinon
+ */
+int devices_persist(void);
+
+/**
+ * @brief Valide les appareils écrits par devices_persist (après le commit)
+ *
+ * Sans appel (commit en échec, ROLLBACK), le devices_persist suivant les
+ * réinsère.
+ */
+void devices_mark_persisted(void);
+
+/**
+ * @brief Compare un topic à un filtre avec au plus un niveau '+'
+ *
+ * Filtre sans '+' : égalité stricte, name vide.
+ *
+ * @param filter Filtre d'abonnement (ex. esp32/+/data)
+ * @param topic Topic reçu
+ * @param name Buffer du niveau capturé par '+' (peut être NULL)
+ * @param size Taille du buffer
+ * @return Longueur du niveau capturé (0 sans '+'), -1 si le topic ne correspond pas
+ */
+int devices_match_topic(const char *filter, const char *topic, char *name, size_t size);
+
+/**
+ * @brief Remplace le niveau '+' d'un topic par le nom d'un appareil
+ * @param pattern Topic, éventuellement avec '+' (ex. server/+/data)
+ * @param name Nom de l'appareil
+ * @param out Topic résultant
+ * @param size Taille de out
+ * @return 0 si succès, -1 si out est trop petit
+ */
+int devices_format_topic(const char *pattern, const char *name, char *out, size_t size);
+
+/**
+ * @brief Libère la table en mémoire
+ */
+void devices_close(void);
+
+#endif // DEVICES_H
@@ -0,0 +1,646 @@
+#include "fanout_server.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define MAX_PENDING 4096 // trames en attente du thread epoll
+#define MAX_EVENTS 64
+#define MAX_IOV 64
+
+// Trame partagée : "<topic> <payload>\n", libérée au dernier lecteur
+typedef struct Frame
+{
+  struct Frame *next; // file d'entrée
+  int refs;           // thread epoll uniquement, après remise
+  size_t topic_len;
+  size_t len;
+  int retained;
+  char data[];
+} Frame;
+
+typedef struct
+{
+  int fd;
+  Frame **queue; // anneau de client_queue trames
+  size_t head;
+  size_t count;
+  size_t offset; // octets de queue[head] déjà envoyés
+  int writing;   // EPOLLOUT demandé
+  int filter_count;
+  char filters[FANOUT_MAX_FILTERS][FANOUT_LINE_SIZE];
+  size_t len;
+  char line[FANOUT_LINE_SIZE];
+} FanoutClient;
+
+enum
+{
+  EVENT_WAKE = 0,
+  EVENT_LISTEN = 1,
+  EVENT_CLIENT = 2 // + index du client
+};
+
+static pthread_t server_thread;
+static int listen_fd = -1;
+static int epoll_fd = -1;
+static int wake_fd = -1;
+static int running = 0;
+static atomic_int started = 0;
+static atomic_int stopping = 0;
+static char bound_path[108];
+
+static FanoutClient *clients = NULL;
+static int client_capacity = 0;
+static size_t queue_capacity = 0;
+
+// File d'entrée, tous producteurs
+static pthread_mutex_t pending_lock = PTHREAD_MUTEX_INITIALIZER;
+static Frame *pending_head = NULL;
+static Frame *pending_tail = NULL;
+static int pending_count = 0;
+
+// Dernière trame retenue par topic (thread epoll)
+static Frame **retained = NULL;
+static int retained_count = 0;
+static int retained_capacity = 0;
+
+static atomic_int stat_clients = 0;
+static atomic_uint_least64_t stat_frames = 0;
+static atomic_uint_least64_t stat_dropped = 0;
+
+static void releaseFrame(Frame *f)
+{
+  if (--f->refs == 0)
+    free(f);
+}
+
+// Filtre MQTT : '+' un niveau, '#' en dernier tous les suivants
+static int topicMatches(const char *filter, const char *topic, size_t topic_len)
+{
+  const char *end = topic + topic_len;
+
+  while (*filter)
+  {
+    if (filter[0] == '#')
+      return 1;
+
+    if (filter[0] == '+')
+    {
+      while (topic < end && *topic != '/')
+        topic++;
+      filter++;
+    }
+    else
+    {
+      while (*filter && *filter != '/' && topic < end && *topic == *filter)
+      {
+        filter++;
+        topic++;
+      }
+      if (*filter && *filter != '/')
+        return 0;
+      if (topic < end && *topic != '/')
+        return 0;
+    }
+
+    if (*filter == '\0')
+      return topic == end;
+
+    // Séparateur : "a/#" couvre aussi "a"
+    if (topic == end)
+      return strcmp(filter, "/#") == 0;
+
+    filter++;
+    topic++;
+  }
+
+  return topic == end;
+}
+
+static int clientWants(const FanoutClient *c, const Frame *f)
+{
+  if (c->filter_count == 0)
+    return 1;
+
+  for (int i = 0; i < c->filter_count; i++)
+  {
+    if (topicMatches(c->filters[i], f->data, f->topic_len))
+      return 1;
+  }
+  return 0;
+}
+
+static void closeClient(FanoutClient *c)
+{
+  while (c->count > 0)
+  {
+    releaseFrame(c->queue[c->head]);
+    c->head = (c->head + 1) % queue_capacity;
+    c->count--;
+  }
+
+  epoll_ctl(epoll_fd, EPOLL_CTL_DEL, c->fd, NULL);
+  close(c->fd);
+  c->fd = -1;
+  c->offset = 0;
+  c->len = 0;
+  c->filter_count = 0;
+  c->writing = 0;
+  atomic_fetch_sub(&stat_clients, 1);
+}
+
+static void watchClient(FanoutClient *c, int index, int writing)
+{
+  if (c->writing == writing)
+    return;
+
+  struct epoll_event ev = {.events = EPOLLIN | (writing ? EPOLLOUT : 0), .data.u32 = EVENT_CLIENT + (uint32_t)index};
+  epoll_ctl(epoll_fd, EPOLL_CTL_MOD, c->fd, &ev);
+  c->writing = writing;
+}
+
+// Écrit la file du client jusqu'à la vider ou remplir la socket ; -1 si le client est perdu
+static int flushClient(FanoutClient *c, int index)
+{
+  while (c->count > 0)
+  {
+    struct iovec iov[MAX_IOV];
+    int n = 0;
+
+    for (size_t i = 0; i < c->count && n < MAX_IOV; i++)
+    {
+      Frame *f = c->queue[(c->head + i) % queue_capacity];
+      size_t skip = (i == 0) ? c->offset : 0;
+      iov[n++] = (struct iovec){f->data + skip, f->len - skip};
+    }
+
+    struct msghdr msg = {.msg_iov = iov, .msg_iovlen = (size_t)n};
+    ssize_t sent = sendmsg(c->fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (sent < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+      {
+        watchClient(c, index, 1);
+        return 0;
+      }
+      return -1;
+    }
+
+    // Trames entièrement envoyées
+    size_t done = (size_t)sent;
+    while (c->count > 0)
+    {
+      Frame *f = c->queue[c->head];
+      size_t left = f->len - c->offset;
+      if (done < left)
+      {
+        c->offset += done;
+        break;
+      }
+
+      done -= left;
+      c->offset = 0;
+      releaseFrame(f);
+      c->head = (c->head + 1) % queue_capacity;
+      c->count--;
+    }
+  }
+
+  watchClient(c, index, 0);
+  return 0;
+}
+
+static void enqueue(FanoutClient *c, Frame *f)
+{
+  if (c->count == queue_capacity)
+  {
+    // Lecteur lent : la plus ancienne trame laisse place, sauf si elle est en cours d'envoi
+    if (c->offset > 0)
+    {
+      atomic_fetch_add(&stat_dropped, 1);
+      return;
+    }
+
+    releaseFrame(c->queue[c->head]);
+    c->head = (c->head + 1) % queue_capacity;
+    c->count--;
+    atomic_fetch_add(&stat_dropped, 1);
+  }
+
+  f->refs++;
+  c->queue[(c->head + c->count) % queue_capacity] = f;
+  c->count++;
+}
+
+static void keepRetained(Frame *f)
+{
+  for (int i = 0; i < retained_count; i++)
+  {
+    Frame *old = retained[i];
+    if (old->topic_len == f->topic_len && memcmp(old->data, f->data, f->topic_len) == 0)
+    {
+      f->refs++;
+      retained[i] = f;
+      releaseFrame(old);
+      return;
+    }
+  }
+
+  if (retained_count == retained_capacity)
+  {
+    int capacity = retained_capacity ? retained_capacity * 2 : 16;
+    Frame **grown = realloc(retained, (size_t)capacity * sizeof(Frame *));
+    if (!grown)
+      return;
+    retained = grown;
+    retained_capacity = capacity;
+  }
+
+  f->refs++;
+  retained[retained_count++] = f;
+}
+
+static void distribute(Frame *f)
+{
+  if (f->retained)
+    keepRetained(f);
+
+  for (int i = 0; i < client_capacity; i++)
+  {
+    FanoutClient *c = &clients[i];
+    if (c->fd < 0 || !clientWants(c, f))
+      continue;
+
+    enqueue(c, f);
+  }
+
+  atomic_fetch_add(&stat_frames, 1);
+  releaseFrame(f);
+}
+
+static void drainPending(void)
+{
+  uint64_t value;
+  if (read(wake_fd, &value, sizeof(value)) < 0 && errno != EAGAIN)
+    perror("Erreur réveil diffusion");
+
+  pthread_mutex_lock(&pending_lock);
+  Frame *f = pending_head;
+  pending_head = pending_tail = NULL;
+  pending_count = 0;
+  pthread_mutex_unlock(&pending_lock);
+
+  while (f)
+  {
+    Frame *next = f->next;
+    distribute(f);
+    f = next;
+  }
+
+  // Une écriture groupée par client pour toute la rafale ; socket pleine : attente d'EPOLLOUT
+  for (int i = 0; i < client_capacity; i++)
+  {
+    FanoutClient *c = &clients[i];
+    if (c->fd >= 0 && c->count > 0 && !c->writing && flushClient(c, i) != 0)
+      closeClient(c);
+  }
+}
+
+static void acceptClients(void)
+{
+  int fd;
+
+  while ((fd = accept(listen_fd, NULL, NULL)) >= 0)
+  {
+    // Lecture non bloquante ; les écritures passent MSG_DONTWAIT
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    int index = -1;
+    for (int i = 0; i < client_capacity && index < 0; i++)
+    {
+      if (clients[i].fd < 0)
+        index = i;
+    }
+
+    if (index < 0)
+    {
+      close(fd);
+      continue;
+    }
+
+    struct epoll_event ev = {.events = EPOLLIN, .data.u32 = EVENT_CLIENT + (uint32_t)index};
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0)
+    {
+      close(fd);
+      continue;
+    }
+
+    clients[index].fd = fd;
+    atomic_fetch_add(&stat_clients, 1);
+  }
+}
+
+static void subscribe(FanoutClient *c, int index, const char *filter)
+{
+  if (c->filter_count == FANOUT_MAX_FILTERS || !*filter)
+    return;
+
+  snprintf(c->filters[c->filter_count++], FANOUT_LINE_SIZE, "%s", filter);
+
+  // État courant des topics filtrés
+  for (int i = 0; i < retained_count; i++)
+  {
+    if (topicMatches(filter, retained[i]->data, retained[i]->topic_len))
+      enqueue(c, retained[i]);
+  }
+
+  if (!c->writing && flushClient(c, index) != 0)
+    closeClient(c);
+}
+
+// Lignes "SUB <filtre>" ; 0 si le client reste ouvert
+static int readClient(FanoutClient *c, int index)
+{
+  ssize_t n = recv(c->fd, c->line + c->len, sizeof(c->line) - 1 - c->len, 0);
+  if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR))
+    return -1;
+  if (n < 0)
+    return 0;
+
+  c->len += (size_t)n;
+
+  char *start = c->line;
+  char *newline;
+  while ((newline = memchr(start, '\n', c->len - (size_t)(start - c->line))) != NULL)
+  {
+    *newline = '\0';
+    if (newline > start && newline[-1] == '\r')
+      newline[-1] = '\0';
+
+    if (strncmp(start, "SUB ", 4) == 0)
+      subscribe(c, index, start + 4);
+    if (c->fd < 0)
+      return 0;
+
+    start = newline + 1;
+  }
+
+  c->len -= (size_t)(start - c->line);
+  memmove(c->line, start, c->len);
+
+  // Ligne trop longue sans fin de ligne : protocole non respecté
+  return (c->len >= sizeof(c->line) - 1) ? -1 : 0;
+}
+
+static void *fanoutServer(void *arg)
+{
+  (void)arg;
+
+  struct epoll_event events[MAX_EVENTS];
+
+  while (!atomic_load(&stopping))
+  {
+    int n = epoll_wait(epoll_fd, events, MAX_EVENTS, -1);
+    if (n < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+
+    for (int i = 0; i < n; i++)
+    {
+      uint32_t id = events[i].data.u32;
+
+      if (id == EVENT_WAKE)
+      {
+        drainPending();
+        continue;
+      }
+
+      if (id == EVENT_LISTEN)
+      {
+        acceptClients();
+        continue;
+      }
+
+      int index = (int)(id - EVENT_CLIENT);
+      FanoutClient *c = &clients[index];
+      if (c->fd < 0)
+        continue;
+
+      int lost = (events[i].events & (EPOLLERR | EPOLLHUP)) != 0;
+      if (!lost && (events[i].events & EPOLLIN))
+        lost = readClient(c, index) != 0;
+      if (!lost && c->fd >= 0 && (events[i].events & EPOLLOUT))
+        lost = flushClient(c, index) != 0;
+
+      if (lost && c->fd >= 0)
+        closeClient(c);
+    }
+  }
+
+  return NULL;
+}
+
+int fanout_server_start(const char *socket_path, int max_clients, int client_queue)
+{
+  struct sockaddr_un addr = {0};
+
+  if (max_clients < 1 || client_queue < 1)
+  {
+    fprintf(stderr, "Diffusion : max_clients et client_queue doivent être > 0\n");
+    return -1;
+  }
+
+  if (strlen(socket_path) >= sizeof(addr.sun_path))
+  {
+    fprintf(stderr, "Chemin de socket trop long : %s\n", socket_path);
+    return -1;
+  }
+
+  clients = calloc((size_t)max_clients, sizeof(FanoutClient));
+  if (!clients)
+    return -1;
+
+  client_capacity = max_clients;
+  queue_capacity = (size_t)client_queue;
+  for (int i = 0; i < max_clients; i++)
+  {
+    clients[i].fd = -1;
+    clients[i].queue = malloc(queue_capacity * sizeof(Frame *));
+    if (!clients[i].queue)
+    {
+      fanout_server_stop();
+      return -1;
+    }
+  }
+
+  addr.sun_family = AF_UNIX;
+  snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", socket_path);
+
+  listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (listen_fd < 0)
+  {
+    perror("Erreur socket diffusion");
+    fanout_server_stop();
+    return -1;
+  }
+
+  // Socket laissée par une instance précédente arrêtée brutalement
+  unlink(socket_path);
+  snprintf(bound_path, sizeof(bound_path), "%s", socket_path);
+
+  epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+  struct epoll_event wake_ev = {.events = EPOLLIN, .data.u32 = EVENT_WAKE};
+  struct epoll_event listen_ev = {.events = EPOLLIN, .data.u32 = EVENT_LISTEN};
+
+  if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(listen_fd, 16) != 0 ||
+      epoll_fd < 0 || wake_fd < 0 || epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &wake_ev) != 0 ||
+      epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &listen_ev) != 0)
+  {
+    fprintf(stderr, "Erreur socket diffusion %s : %s\n", socket_path, strerror(errno));
+    fanout_server_stop();
+    return -1;
+  }
+
+  atomic_store(&stopping, 0);
+  if (pthread_create(&server_thread, NULL, fanoutServer, NULL) != 0)
+  {
+    fprintf(stderr, "Erreur création thread de diffusion\n");
+    fanout_server_stop();
+    return -1;
+  }
+
+  running = 1;
+  atomic_store(&started, 1);
+  printf("Diffusion locale : %s (%d lecteurs, %d trames par lecteur)\n", socket_path, max_clients, client_queue);
+  return 0;
+}
+
+static void wake(void)
+{
+  uint64_t one = 1;
+  if (write(wake_fd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+    perror("Erreur réveil diffusion");
+}
+
+void fanout_publish(const char *topic, const char *payload, size_t len, int retained_frame)
+{
+  if (!atomic_load(&started) || (atomic_load(&stat_clients) == 0 && !retained_frame))
+    return;
+
+  size_t topic_len = strlen(topic);
+  Frame *f = malloc(sizeof(Frame) + topic_len + 1 + len + 1);
+  if (!f)
+    return;
+
+  f->next = NULL;
+  f->refs = 1;
+  f->topic_len = topic_len;
+  f->len = topic_len + 1 + len + 1;
+  f->retained = retained_frame;
+  memcpy(f->data, topic, topic_len);
+  f->data[topic_len] = ' ';
+  memcpy(f->data + topic_len + 1, payload, len);
+  f->data[f->len - 1] = '\n';
+
+  pthread_mutex_lock(&pending_lock);
+  if (pending_count >= MAX_PENDING)
+  {
+    pthread_mutex_unlock(&pending_lock);
+    free(f);
+    atomic_fetch_add(&stat_dropped, 1);
+    return;
+  }
+
+  int was_empty = (pending_head == NULL);
+  if (pending_tail)
+    pending_tail->next = f;
+  else
+    pending_head = f;
+  pending_tail = f;
+  pending_count++;
+  pthread_mutex_unlock(&pending_lock);
+
+  // Un seul réveil par rafale : le thread epoll vide toute la file
+  if (was_empty)
+    wake();
+}
+
+void fanout_stats(FanoutStats *out)
+{
+  out->clients = atomic_load(&stat_clients);
+  out->frames = atomic_load(&stat_frames);
+  out->dropped = atomic_load(&stat_dropped);
+}
+
+void fanout_server_stop(void)
+{
+  atomic_store(&started, 0);
+
+  if (running)
+  {
+    atomic_store(&stopping, 1);
+    wake();
+    pthread_join(server_thread, NULL);
+    running = 0;
+  }
+
+  for (int i = 0; i < client_capacity; i++)
+  {
+    if (clients[i].fd >= 0)
+      closeClient(&clients[i]);
+    free(clients[i].queue);
+  }
+  free(clients);
+  clients = NULL;
+  client_capacity = 0;
+
+  pthread_mutex_lock(&pending_lock);
+  while (pending_head)
+  {
+    Frame *next = pending_head->next;
+    free(pending_head);
+    pending_head = next;
+  }
+  pending_tail = NULL;
+  pending_count = 0;
+  pthread_mutex_unlock(&pending_lock);
+
+  for (int i = 0; i < retained_count; i++)
+    releaseFrame(retained[i]);
+  free(retained);
+  retained = NULL;
+  retained_count = 0;
+  retained_capacity = 0;
+
+  if (wake_fd >= 0)
+    close(wake_fd);
+  if (epoll_fd >= 0)
+    close(epoll_fd);
+  wake_fd = -1;
+  epoll_fd = -1;
+
+  if (listen_fd >= 0)
+  {
+    close(listen_fd);
+    listen_fd = -1;
+    unlink(bound_path);
+  }
+}
@@ -0,0 +1,72 @@
+#ifndef FANOUT_SERVER_H
+#define FANOUT_SERVER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define FANOUT_MAX_FILTERS 8
+#define FANOUT_LINE_SIZE 256
+
+// ===== DIFFUSION LOCALE =====
+
+/*
+ * Socket Unix (flux) qui pousse aux tableaux de bord locaux tout ce que le
+ * serveur publie sur le broker (republications, dernière mesure, fenêtres,
+ * alertes, statistiques), sans connexion MQTT par lecteur. Une trame par
+ * ligne :
+ *
+ *   <topic> <payload JSON>\n
+ *
+ * Un client reçoit toutes les trames, ou, après une ou plusieurs lignes
+ * "SUB <filtre>" (jokers MQTT + et #, FANOUT_MAX_FILTERS au plus), celles
+ * des topics filtrés, précédées des dernières trames retenues qui
+ * correspondent.
+ *
+ * Chaque trame est sérialisée une fois et partagée (compteur de références)
+ * par les files de tous les clients ; un thread epoll écrit sans bloquer.
+ * Un client dont la file est pleine perd ses trames les plus anciennes
+ * (comptées) : un lecteur lent ne retarde ni les autres ni l'ingestion.
+ */
+
+/**
+ * @brief Compteurs de diffusion
+ */
+typedef struct
+{
+  int clients;
+  uint64_t frames;  // trames diffusées
+  uint64_t dropped; // trames perdues : file d'un client ou file d'entrée pleine
+} FanoutStats;
+
+/**
+ * @brief Crée la socket et démarre le thread de diffusion
+ * @param socket_path Chemin de la socket (remplacée si elle existe)
+ * @param max_clients Nombre maximal de lecteurs
+ * @param client_queue Trames en attente par lecteur avant perte
+ * @return 0 si succès, -1 en cas d'erreur
+ */
+int fanout_server_start(const char *socket_path, int max_clients, int client_queue);
+
+/**
+ * @brief Diffuse une trame (tout thread, sans attente du thread epoll)
+ *
+ * Sans effet si le service n'est pas démarré.
+ *
+ * @param topic Topic MQTT correspondant
+ * @param payload Contenu, sur une ligne
+ * @param len Longueur du contenu
+ * @param retained Trame gardée par topic et rejouée aux nouveaux abonnés
+ */
+void fanout_publish(const char *topic, const char *payload, size_t len, int retained);
+
+/**
+ * @brief Compteurs depuis le démarrage
+ */
+void fanout_stats(FanoutStats *out);
+
+/**
+ * @brief Arrête le thread, ferme les clients et supprime la socket
+ */
+void fanout_server_stop(void);
+
+#endif // FANOUT_SERVER_H
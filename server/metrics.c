@@ -0,0 +1,276 @@
+#include "metrics.h"
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define MAX_SHARDS 8
+
+static const char *stage_names[METRIC_STAGES] = {
+    "receive", "parse", "insert", "commit", "republish", "puback", "alerts",
+};
+
+static const char *counter_names[METRIC_COUNTERS] = {
+    "parsed", "parse_errors", "inserted", "insert_errors", "commits", "republished", "backfilled", "backfill_expired",
+    "compressed", "alerts", "conflated", "devices_rejected", "oversized",
+};
+
+typedef struct
+{
+  atomic_uint_least64_t buckets[METRICS_BUCKETS];
+  atomic_uint_least64_t count;
+  atomic_uint_least64_t sum_ns;
+  atomic_uint_least64_t max_ns;
+} ShardHistogram;
+
+// Une zone par thread, alignée pour ne pas partager de ligne de cache
+typedef struct
+{
+  _Alignas(64) ShardHistogram stages[METRIC_STAGES];
+  atomic_uint_least64_t counters[METRIC_COUNTERS];
+} MetricsShard;
+
+static MetricsShard shards[MAX_SHARDS];
+static atomic_int shard_count = 0;
+static _Thread_local MetricsShard *local_shard = NULL;
+static int64_t start_ns = 0;
+
+void metrics_init(void)
+{
+  start_ns = metrics_now_ns();
+}
+
+int64_t metrics_now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Au-delà de MAX_SHARDS threads, les zones sont partagées : les additions restent atomiques
+static MetricsShard *shard(void)
+{
+  if (!local_shard)
+    local_shard = &shards[atomic_fetch_add(&shard_count, 1) % MAX_SHARDS];
+  return local_shard;
+}
+
+/*
+ * Seau : 0..3 pour 0..3 ns, puis 4 seaux par puissance de 2 selon les deux
+ * bits qui suivent le bit de poids fort.
+ */
+static int bucketOf(uint64_t ns)
+{
+  if (ns < 4)
+    return (int)ns;
+
+  int msb = 63 - __builtin_clzll(ns);
+  int index = (msb - 1) * 4 + (int)((ns >> (msb - 2)) & 3);
+  return index < METRICS_BUCKETS ? index : METRICS_BUCKETS - 1;
+}
+
+// Borne haute (exclue) du seau, en nanosecondes
+static double bucketUpper(int index)
+{
+  if (index < 4)
+    return index + 1;
+
+  int msb = index / 4 + 1;
+  int sub = index % 4;
+  return (double)(5 + sub) * (double)(1ULL << (msb - 2));
+}
+
+void metrics_record(MetricStage stage, int64_t elapsed_ns)
+{
+  ShardHistogram *h = &shard()->stages[stage];
+  uint64_t ns = elapsed_ns > 0 ? (uint64_t)elapsed_ns : 0;
+
+  atomic_fetch_add_explicit(&h->buckets[bucketOf(ns)], 1, memory_order_relaxed);
+  atomic_fetch_add_explicit(&h->count, 1, memory_order_relaxed);
+  atomic_fetch_add_explicit(&h->sum_ns, ns, memory_order_relaxed);
+
+  if (ns > atomic_load_explicit(&h->max_ns, memory_order_relaxed))
+    atomic_store_explicit(&h->max_ns, ns, memory_order_relaxed);
+}
+
+void metrics_count(MetricCounter counter, uint64_t n)
+{
+  atomic_fetch_add_explicit(&shard()->counters[counter], n, memory_order_relaxed);
+}
+
+void metrics_snapshot(MetricsSnapshot *out)
+{
+  memset(out, 0, sizeof(*out));
+  out->uptime_ms = (metrics_now_ns() - start_ns) / 1000000;
+
+  for (int s = 0; s < MAX_SHARDS; s++)
+  {
+    for (int st = 0; st < METRIC_STAGES; st++)
+    {
+      ShardHistogram *src = &shards[s].stages[st];
+      MetricHistogram *dst = &out->stages[st];
+
+      for (int b = 0; b < METRICS_BUCKETS; b++)
+        dst->buckets[b] += atomic_load_explicit(&src->buckets[b], memory_order_relaxed);
+      dst->count += atomic_load_explicit(&src->count, memory_order_relaxed);
+      dst->sum_ns += atomic_load_explicit(&src->sum_ns, memory_order_relaxed);
+
+      // Maximum remis à zéro : celui de l'intervalle écoulé
+      uint64_t max = atomic_exchange_explicit(&src->max_ns, 0, memory_order_relaxed);
+      if (max > dst->max_ns)
+        dst->max_ns = max;
+    }
+
+    for (int c = 0; c < METRIC_COUNTERS; c++)
+      out->counters[c] += atomic_load_explicit(&shards[s].counters[c], memory_order_relaxed);
+  }
+}
+
+void metrics_add_gauge(MetricsSnapshot *snap, const char *name, const char *help, double value)
+{
+  if (snap->gauge_count < METRICS_MAX_GAUGES)
+    snap->gauges[snap->gauge_count++] = (MetricGauge){name, help, value};
+}
+
+double metrics_quantile(const MetricHistogram *h, double q)
+{
+  uint64_t total = 0;
+  for (int b = 0; b < METRICS_BUCKETS; b++)
+    total += h->buckets[b];
+
+  if (total == 0)
+    return 0.0;
+
+  uint64_t rank = (uint64_t)(q * (double)total);
+  if (rank >= total)
+    rank = total - 1;
+
+  uint64_t seen = 0;
+  for (int b = 0; b < METRICS_BUCKETS; b++)
+  {
+    seen += h->buckets[b];
+    if (seen > rank)
+      return bucketUpper(b);
+  }
+  return bucketUpper(METRICS_BUCKETS - 1);
+}
+
+// Différence cur - prev ; le max de cur est déjà celui de l'intervalle
+static void histogramDelta(const MetricHistogram *cur, const MetricHistogram *prev, MetricHistogram *out)
+{
+  *out = *cur;
+  if (!prev)
+    return;
+
+  for (int b = 0; b < METRICS_BUCKETS; b++)
+    out->buckets[b] -= prev->buckets[b];
+  out->count -= prev->count;
+  out->sum_ns -= prev->sum_ns;
+}
+
+#define APPEND(...)                                                   \
+  do                                                                  \
+  {                                                                   \
+    int n_ = snprintf(buffer + len, size - len, __VA_ARGS__);         \
+    if (n_ < 0 || (size_t)n_ >= size - len)                           \
+      return -1;                                                      \
+    len += (size_t)n_;                                                \
+  } while (0)
+
+int metrics_format_json(const MetricsSnapshot *snap, const MetricsSnapshot *previous, char *buffer, size_t size)
+{
+  size_t len = 0;
+
+  APPEND("{\"uptime_s\":%lld,\"counters\":{", (long long)(snap->uptime_ms / 1000));
+  for (int c = 0; c < METRIC_COUNTERS; c++)
+    APPEND("%s\"%s\":%llu", c ? "," : "", counter_names[c], (unsigned long long)snap->counters[c]);
+
+  APPEND("},\"gauges\":{");
+  for (int g = 0; g < snap->gauge_count; g++)
+    APPEND("%s\"%s\":%.15g", g ? "," : "", snap->gauges[g].name, snap->gauges[g].value);
+
+  APPEND("},\"latency_us\":{");
+  for (int st = 0; st < METRIC_STAGES; st++)
+  {
+    MetricHistogram h;
+    histogramDelta(&snap->stages[st], previous ? &previous->stages[st] : NULL, &h);
+
+    // Borne haute du seau, ramenée au maximum observé
+    double max = (double)h.max_ns, q[3] = {0.50, 0.99, 0.999};
+    for (int i = 0; i < 3; i++)
+    {
+      q[i] = metrics_quantile(&h, q[i]);
+      if (q[i] > max)
+        q[i] = max;
+    }
+
+    APPEND("%s\"%s\":{\"n\":%llu,\"mean\":%.1f,\"p50\":%.1f,\"p99\":%.1f,\"p999\":%.1f,\"max\":%.1f}",
+           st ? "," : "", stage_names[st], (unsigned long long)h.count,
+           h.count ? (double)h.sum_ns / (double)h.count / 1e3 : 0.0,
+           q[0] / 1e3, q[1] / 1e3, q[2] / 1e3, max / 1e3);
+  }
+
+  APPEND("}}");
+  return (int)len;
+}
+
+int metrics_write_prometheus(const MetricsSnapshot *snap, const char *path)
+{
+  char tmp_path[1100];
+  snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+  FILE *fp = fopen(tmp_path, "w");
+  if (!fp)
+    return -1;
+
+  fprintf(fp, "# HELP mqtt_subscriber_stage_seconds Latence par étape du chemin chaud\n");
+  fprintf(fp, "# TYPE mqtt_subscriber_stage_seconds histogram\n");
+
+  for (int st = 0; st < METRIC_STAGES; st++)
+  {
+    const MetricHistogram *h = &snap->stages[st];
+    uint64_t cumulative = 0;
+    int b = 0;
+
+    // Une borne par puissance de 2, de 256 ns à ~34 s
+    for (int p = 8; p <= 35; p++)
+    {
+      double le_ns = (double)(1ULL << p);
+      while (b < METRICS_BUCKETS && bucketUpper(b) <= le_ns)
+        cumulative += h->buckets[b++];
+      fprintf(fp, "mqtt_subscriber_stage_seconds_bucket{stage=\"%s\",le=\"%.9g\"} %llu\n",
+              stage_names[st], le_ns / 1e9, (unsigned long long)cumulative);
+    }
+    // Total recalculé depuis les seaux : cohérent même si count a avancé entre-temps
+    while (b < METRICS_BUCKETS)
+      cumulative += h->buckets[b++];
+    fprintf(fp, "mqtt_subscriber_stage_seconds_bucket{stage=\"%s\",le=\"+Inf\"} %llu\n",
+            stage_names[st], (unsigned long long)cumulative);
+    fprintf(fp, "mqtt_subscriber_stage_seconds_sum{stage=\"%s\"} %.9f\n", stage_names[st], (double)h->sum_ns / 1e9);
+    fprintf(fp, "mqtt_subscriber_stage_seconds_count{stage=\"%s\"} %llu\n",
+            stage_names[st], (unsigned long long)cumulative);
+  }
+
+  for (int c = 0; c < METRIC_COUNTERS; c++)
+  {
+    fprintf(fp, "# TYPE mqtt_subscriber_%s_total counter\n", counter_names[c]);
+    fprintf(fp, "mqtt_subscriber_%s_total %llu\n", counter_names[c], (unsigned long long)snap->counters[c]);
+  }
+
+  for (int g = 0; g < snap->gauge_count; g++)
+  {
+    fprintf(fp, "# HELP mqtt_subscriber_%s %s\n", snap->gauges[g].name, snap->gauges[g].help);
+    fprintf(fp, "# TYPE mqtt_subscriber_%s gauge\n", snap->gauges[g].name);
+    fprintf(fp, "mqtt_subscriber_%s %.15g\n", snap->gauges[g].name, snap->gauges[g].value);
+  }
+
+  fprintf(fp, "# TYPE mqtt_subscriber_uptime_seconds gauge\n");
+  fprintf(fp, "mqtt_subscriber_uptime_seconds %lld\n", (long long)(snap->uptime_ms / 1000));
+
+  if (fclose(fp) != 0)
+    return -1;
+
+  // Renommage atomique : le collecteur ne lit jamais un fichier à moitié écrit
+  return rename(tmp_path, path) == 0 ? 0 : -1;
+}
@@ -0,0 +1,136 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define METRICS_BUCKETS 160
+#define METRICS_MAX_GAUGES 16
+
+// ===== INSTRUMENTATION DU CHEMIN CHAUD =====
+
+/*
+ * Histogrammes de latence à seaux logarithmiques (4 seaux par puissance de 2,
+ * de 1 ns à ~2000 s) et compteurs. Chaque thread écrit dans sa propre zone
+ * (additions atomiques relâchées, sans verrou ni partage de ligne de cache) ;
+ * l'export additionne les zones. Coût d'un relevé : deux lectures d'horloge
+ * monotone et trois additions.
+ */
+
+typedef enum
+{
+  METRIC_RECEIVE = 0, // attente dans la file, callback MQTT -> thread d'écriture
+  METRIC_PARSE,
+  METRIC_INSERT,
+  METRIC_COMMIT,
+  METRIC_REPUBLISH, // sérialisation + remise au client MQTT
+  METRIC_PUBACK,    // remise au client MQTT -> acquittement du broker
+  METRIC_ALERTS,    // évaluation des règles d'alerte d'une mesure
+  METRIC_STAGES
+} MetricStage;
+
+typedef enum
+{
+  COUNTER_PARSED = 0,
+  COUNTER_PARSE_ERRORS,
+  COUNTER_INSERTED,
+  COUNTER_INSERT_ERRORS,
+  COUNTER_COMMITS,
+  COUNTER_REPUBLISHED,
+  COUNTER_BACKFILLED,       // mesures de rattrapage insérées
+  COUNTER_BACKFILL_EXPIRED, // mesures de rattrapage déjà hors rétention
+  COUNTER_COMPRESSED,       // lectures non stockées (ou en attente), dans la tolérance
+  COUNTER_ALERTS,           // événements d'alerte (levées et retombées)
+  COUNTER_CONFLATED,        // mesures remplacées avant republication (mode conflate)
+  COUNTER_DEVICES_REJECTED, // messages d'un nouvel appareil au-delà de max_devices
+  COUNTER_OVERSIZED,        // messages de plus de SENSOR_MESSAGE_MAX octets, ignorés
+  METRIC_COUNTERS
+} MetricCounter;
+
+typedef struct
+{
+  uint64_t buckets[METRICS_BUCKETS];
+  uint64_t count;
+  uint64_t sum_ns;
+  uint64_t max_ns;
+} MetricHistogram;
+
+typedef struct
+{
+  const char *name;
+  const char *help;
+  double value;
+} MetricGauge;
+
+typedef struct
+{
+  int64_t uptime_ms;
+  MetricHistogram stages[METRIC_STAGES];
+  uint64_t counters[METRIC_COUNTERS];
+  MetricGauge gauges[METRICS_MAX_GAUGES];
+  int gauge_count;
+} MetricsSnapshot;
+
+/**
+ * @brief Démarre le compteur de temps de fonctionnement
+ */
+void metrics_init(void);
+
+/**
+ * @brief Instant monotone en nanosecondes
+ */
+int64_t metrics_now_ns(void);
+
+/**
+ * @brief Enregistre une durée dans l'histogramme d'une étape
+ * @param stage Étape
+ * @param elapsed_ns Durée en nanosecondes
+ */
+void metrics_record(MetricStage stage, int64_t elapsed_ns);
+
+/**
+ * @brief Incrémente un compteur
+ */
+void metrics_count(MetricCounter counter, uint64_t n);
+
+/**
+ * @brief Additionne les zones de tous les threads
+ *
+ * Seaux, sommes et compteurs sont cumulés depuis le démarrage ; le maximum
+ * est celui écoulé depuis l'instantané précédent (un seul exportateur).
+ *
+ * @param out Instantané (gauges vidées)
+ */
+void metrics_snapshot(MetricsSnapshot *out);
+
+/**
+ * @brief Ajoute une valeur instantanée fournie par l'appelant (profondeur de file...)
+ * @param name Nom Prometheus, sans préfixe
+ */
+void metrics_add_gauge(MetricsSnapshot *snap, const char *name, const char *help, double value);
+
+/**
+ * @brief Quantile estimé (borne haute du seau)
+ * @param h Histogramme
+ * @param q Quantile dans [0, 1]
+ * @return Durée en nanosecondes, 0 si vide
+ */
+double metrics_quantile(const MetricHistogram *h, double q);
+
+/**
+ * @brief Document JSON : compteurs cumulés, latences de l'intervalle écoulé
+ * @param snap Instantané courant
+ * @param previous Instantané précédent (NULL : depuis le démarrage)
+ * @param buffer Buffer de sortie
+ * @param size Taille du buffer
+ * @return Longueur écrite, -1 si le buffer est trop petit
+ */
+int metrics_format_json(const MetricsSnapshot *snap, const MetricsSnapshot *previous, char *buffer, size_t size);
+
+/**
+ * @brief Écrit le format texte Prometheus (fichier temporaire puis renommage)
+ * @return 0 si succès, -1 en cas d'erreur
+ */
+int metrics_write_prometheus(const MetricsSnapshot *snap, const char *path);
+
+#endif // METRICS_H
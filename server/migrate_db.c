@@ -0,0 +1,219 @@
+/*
+ * Migration de la table mesures vers le schéma à timestamps entiers.
+ *
+ * Ancien : mesures(timestamp TEXT, temperature, pression, humidite) + index
+ * Nouveau : mesures(device, ts, ...) WITHOUT ROWID, voir schema.h
+ *
+ * Usage :
+ *   migrate_db config.toml          copie en ligne, serveur en marche (reprenable)
+ *   migrate_db config.toml --swap   serveur arrêté : copie du reliquat et bascule
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sqlite3.h>
+#include "config.h"
+#include "schema.h"
+
+#define COPY_BATCH 5000
+
+static sqlite3 *db = NULL;
+
+static int execOrFail(const char *sql)
+{
+  char *errMsg = NULL;
+  int rc = sqlite3_exec(db, sql, NULL, NULL, &errMsg);
+  if (rc != SQLITE_OK)
+  {
+    fprintf(stderr, "Erreur SQL : %s\n  %s\n", errMsg ? errMsg : sqlite3_errmsg(db), sql);
+    sqlite3_free(errMsg);
+  }
+  return rc;
+}
+
+static sqlite3_int64 queryInt64(const char *sql, sqlite3_int64 fallback)
+{
+  sqlite3_stmt *stmt = NULL;
+  sqlite3_int64 value = fallback;
+
+  if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) == SQLITE_OK &&
+      sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_type(stmt, 0) != SQLITE_NULL)
+  {
+    value = sqlite3_column_int64(stmt, 0);
+  }
+
+  sqlite3_finalize(stmt);
+  return value;
+}
+
+static int isLegacySchema(void)
+{
+  return queryInt64("SELECT 1 FROM pragma_table_info('mesures') WHERE name = 'timestamp';", 0) == 1;
+}
+
+/*
+ * Copie les lignes d'ancien rowid dans ]last, max] par lots, chaque lot dans
+ * sa propre transaction courte pour ne pas bloquer le serveur. La progression
+ * est enregistrée dans mesures_migration : une copie interrompue reprend.
+ * Avec in_transaction, l'appelant tient déjà la transaction (bascule).
+ */
+static int copyRows(int in_transaction)
+{
+  sqlite3_stmt *copy_stmt = NULL;
+  sqlite3_stmt *progress_stmt = NULL;
+  long long copied = 0;
+
+  const char *copy_sql =
+      "INSERT OR REPLACE INTO mesures_v2 (device, ts, temperature, pression, humidite) "
+      "SELECT 0, CAST(strftime('%s', timestamp) AS INTEGER) * 1000, temperature, pression, humidite "
+      "FROM mesures WHERE rowid > ?1 AND rowid <= ?2;";
+
+  if (sqlite3_prepare_v2(db, copy_sql, -1, &copy_stmt, NULL) != SQLITE_OK ||
+      sqlite3_prepare_v2(db, "UPDATE mesures_migration SET last_rowid = ?1;", -1, &progress_stmt, NULL) != SQLITE_OK)
+  {
+    fprintf(stderr, "Erreur préparation copie : %s\n", sqlite3_errmsg(db));
+    sqlite3_finalize(copy_stmt);
+    return -1;
+  }
+
+  sqlite3_int64 last = queryInt64("SELECT last_rowid FROM mesures_migration;", 0);
+
+  while (1)
+  {
+    // Le serveur peut encore écrire : la borne haute est relue à chaque lot
+    sqlite3_int64 max_rowid = queryInt64("SELECT max(rowid) FROM mesures;", 0);
+    if (last >= max_rowid)
+      break;
+
+    sqlite3_int64 upper = last + COPY_BATCH;
+    if (upper > max_rowid)
+      upper = max_rowid;
+
+    if (!in_transaction && execOrFail("BEGIN IMMEDIATE;") != SQLITE_OK)
+      goto error;
+
+    sqlite3_bind_int64(copy_stmt, 1, last);
+    sqlite3_bind_int64(copy_stmt, 2, upper);
+    int rc = sqlite3_step(copy_stmt);
+    sqlite3_reset(copy_stmt);
+    copied += sqlite3_changes(db);
+
+    sqlite3_bind_int64(progress_stmt, 1, upper);
+    if (rc == SQLITE_DONE)
+      rc = sqlite3_step(progress_stmt);
+    sqlite3_reset(progress_stmt);
+
+    if (rc != SQLITE_DONE)
+    {
+      fprintf(stderr, "Erreur copie : %s\n", sqlite3_errmsg(db));
+      if (!in_transaction)
+        execOrFail("ROLLBACK;");
+      goto error;
+    }
+
+    if (!in_transaction && execOrFail("COMMIT;") != SQLITE_OK)
+      goto error;
+
+    last = upper;
+  }
+
+  printf("Lignes copiées : %lld (dernier rowid %lld)\n", copied, (long long)last);
+  sqlite3_finalize(copy_stmt);
+  sqlite3_finalize(progress_stmt);
+  return 0;
+
+error:
+  sqlite3_finalize(copy_stmt);
+  sqlite3_finalize(progress_stmt);
+  return -1;
+}
+
+static int swapTables(void)
+{
+  if (execOrFail("BEGIN IMMEDIATE;") != SQLITE_OK)
+    return -1;
+
+  if (copyRows(1) != 0)
+  {
+    execOrFail("ROLLBACK;");
+    return -1;
+  }
+
+  if (execOrFail("DROP TABLE mesures;") != SQLITE_OK ||
+      execOrFail("ALTER TABLE mesures_v2 RENAME TO mesures;") != SQLITE_OK ||
+      execOrFail("DROP TABLE mesures_migration;") != SQLITE_OK ||
+      execOrFail("COMMIT;") != SQLITE_OK)
+  {
+    execOrFail("ROLLBACK;");
+    return -1;
+  }
+
+  // Pages de l'ancienne table et de son index rendues au système
+  execOrFail("PRAGMA incremental_vacuum;");
+  return 0;
+}
+
+int main(int argc, char *argv[])
+{
+  Config cfg;
+  char db_path[1024];
+
+  if (argc < 2)
+  {
+    fprintf(stderr, "Usage : %s config.toml [--swap]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  int swap = (argc > 2 && strcmp(argv[2], "--swap") == 0);
+
+  if (config_load(&cfg, argv[1]) != 0)
+    return EXIT_FAILURE;
+
+  config_resolve_path(&cfg, cfg.database.path, db_path, sizeof(db_path));
+
+  if (sqlite3_open(db_path, &db) != SQLITE_OK)
+  {
+    fprintf(stderr, "Erreur ouverture DB : %s\n", sqlite3_errmsg(db));
+    return EXIT_FAILURE;
+  }
+
+  sqlite3_busy_timeout(db, 5000);
+  execOrFail("PRAGMA journal_mode=WAL;");
+
+  if (!isLegacySchema())
+  {
+    printf("Schéma déjà à jour : rien à migrer\n");
+    sqlite3_close(db);
+    return EXIT_SUCCESS;
+  }
+
+  if (execOrFail("CREATE TABLE IF NOT EXISTS mesures_v2 " MESURES_COLUMNS_SQL ";") != SQLITE_OK ||
+      execOrFail("CREATE TABLE IF NOT EXISTS mesures_migration (last_rowid INTEGER NOT NULL);") != SQLITE_OK ||
+      execOrFail("INSERT INTO mesures_migration SELECT 0 WHERE NOT EXISTS (SELECT 1 FROM mesures_migration);") != SQLITE_OK)
+  {
+    sqlite3_close(db);
+    return EXIT_FAILURE;
+  }
+
+  int rc;
+  if (swap)
+  {
+    printf("Bascule vers le nouveau schéma...\n");
+    rc = swapTables();
+  }
+  else
+  {
+    printf("Copie en ligne vers mesures_v2...\n");
+    rc = copyRows(0);
+    if (rc == 0)
+      printf("Arrêter le serveur puis relancer avec --swap pour terminer\n");
+  }
+
+  sqlite3_close(db);
+
+  if (rc != 0)
+    return EXIT_FAILURE;
+
+  printf("=== Terminé ===\n");
+  return EXIT_SUCCESS;
+}
@@ -2,17 +2,84 @@
 
 // ===== VARIABLES GLOBALES =====
 sqlite3 *db = NULL;
-sqlite3_stmt *insert_stmt = NULL;
 Config app_config = {0};
-MQTTClient mqtt_client = NULL;
+MQTTAsync mqtt_client = NULL;
+
+// ===== WORKERS D'INGESTION =====
+// Un worker : sa connexion MQTT et sa file d'entrée SPSC (callback -> parsing).
+// Avec plusieurs workers, chaque connexion a son abonnement partagé et son
+// thread de parsing, qui transmet les mesures au thread d'écriture par une
+// seconde file SPSC ; avec un seul, le thread d'écriture lit directement la
+// file d'entrée.
+typedef struct
+{
+  MQTTAsync client;
+  RingBuffer input; // RingSlot
+  RingBuffer rows;  // IngestRow, workers > 1 uniquement
+  pthread_t thread;
+  atomic_int connected;
+} IngestWorker;
+
+static IngestWorker ingest_workers[MAX_INGEST_WORKERS];
+static int ingest_worker_count = 1;
+static atomic_int workers_running = 0;
+
+// ===== RATTRAPAGE =====
+// Messages de mqtt.backfill_topic, reçus par la première connexion seulement
+// (un producteur) et lus par le thread d'écriture après les files en direct.
+static RingBuffer backfill_queue;
+static int backfill_enabled = 0;
+
+// ===== ÉCRITURE GROUPÉE =====
+// Uniquement manipulée par le thread d'écriture, propriétaire de db.
+static sqlite3_stmt *begin_stmt = NULL;
+static sqlite3_stmt *commit_stmt = NULL;
+static int pending_rows = 0;
+static long long batch_started_ms = 0;
+
+static volatile sig_atomic_t keep_running = 1;
+
+static pthread_t writer_thread;
+static atomic_int writer_running = 0;
+
+// ===== REPUBLICATION =====
+// Fenêtre de messages QoS 1 non acquittés ; au-delà, la republication est
+// abandonnée plutôt que de bloquer l'ingestion en attendant un PUBACK.
+static atomic_int republish_inflight = 0;
+static atomic_uint_least64_t republish_dropped = 0;
+// Mode conflate : dernière mesure par appareil, transmise à rythme borné
+static int conflate_republish = 0;
+static char republish_buffer[256];
+static char window_buffer[WINDOW_MAX_SIZES * 320 + 64];
+static char alert_buffer[512];
 
 // ===== DATE UTC =====
 
+void formatUTCTimestamp(int64_t epoch_ms, char *buffer, size_t size)
+{
+  time_t t = (time_t)(epoch_ms / 1000);
+  struct tm utc_time;
+  gmtime_r(&t, &utc_time);
+  strftime(buffer, size, "%Y-%m-%d %H:%M:%S", &utc_time);
+}
+
 void getUTCTimestamp(char *buffer, size_t size)
 {
-  time_t now = time(NULL);
-  struct tm *utc_time = gmtime(&now);
-  strftime(buffer, size, "%Y-%m-%d %H:%M:%S", utc_time);
+  formatUTCTimestamp(getEpochMillis(), buffer, size);
+}
+
+int64_t getEpochMillis(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+long long getMonotonicMillis(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000LL + ts.tv_nsec / 1000000L;
 }
 
 // ===== BASE DE DONNÉES =====
@@ -41,34 +108,76 @@ int initDatabase(const Config *cfg)
   sqlite3_exec(db, "PRAGMA temp_store=MEMORY;", NULL, NULL, NULL);
   sqlite3_exec(db, "PRAGMA auto_vacuum=INCREMENTAL;", NULL, NULL, NULL);
 
-  const char *table_sql =
-      "CREATE TABLE IF NOT EXISTS mesures ("
-      "timestamp TEXT NOT NULL,"
-      "temperature REAL,"
-      "pression REAL,"
-      "humidite REAL"
-      ");";
+  // Ancien schéma (timestamp TEXT + index) : migration hors ligne requise
+  sqlite3_stmt *legacy_stmt = NULL;
+  int legacy = 0;
+  if (sqlite3_prepare_v2(db, "SELECT 1 FROM pragma_table_info('mesures') WHERE name = 'timestamp';",
+                         -1, &legacy_stmt, NULL) == SQLITE_OK)
+  {
+    legacy = (sqlite3_step(legacy_stmt) == SQLITE_ROW);
+    sqlite3_finalize(legacy_stmt);
+  }
+
+  if (legacy)
+  {
+    fprintf(stderr, "Ancien schéma de la table mesures détecté (timestamp TEXT).\n");
+    fprintf(stderr, "Migration : make migrate && build/migrate_db config.toml (voir README)\n");
+    return SQLITE_ERROR;
+  }
 
-  rc = sqlite3_exec(db, table_sql, NULL, NULL, &errMsg);
+  rc = partitions_init(db, cfg->database.partition_hours, cfg->database.compact_values);
   if (rc != SQLITE_OK)
   {
-    fprintf(stderr, "Erreur création table : %s\n", errMsg);
-    sqlite3_free(errMsg);
+    fprintf(stderr, "Erreur initialisation partitions\n");
     return rc;
   }
 
-  const char *index_sql =
-      "CREATE INDEX IF NOT EXISTS idx_mesures_timestamp "
-      "ON mesures(timestamp);";
-
-  rc = sqlite3_exec(db, index_sql, NULL, NULL, &errMsg);
+  rc = devices_init(db, cfg->database.max_devices);
   if (rc != SQLITE_OK)
   {
-    fprintf(stderr, "Erreur création index : %s\n", errMsg);
-    sqlite3_free(errMsg);
+    fprintf(stderr, "Erreur initialisation appareils\n");
     return rc;
   }
 
+  int mode = compression_parse_mode(cfg->compression.mode);
+  if (mode < 0)
+  {
+    fprintf(stderr, "Mode de compression inconnu : %s (off, deadband, swinging_door)\n", cfg->compression.mode);
+    return SQLITE_ERROR;
+  }
+  const double tolerance[COMPRESSION_METRICS] = {cfg->compression.temperature, cfg->compression.pression,
+                                                 cfg->compression.humidite};
+  compression_init((CompressionMode)mode, tolerance, (int64_t)cfg->compression.max_gap_s * 1000);
+
+  if (cfg->window.enabled && window_stats_init(cfg->window.sizes_s, cfg->window.size_count) != 0)
+  {
+    fprintf(stderr, "Fenêtres glissantes invalides : largeurs > 0, croissantes, %d au plus\n", WINDOW_MAX_SIZES);
+    return SQLITE_ERROR;
+  }
+
+  if (cfg->alerts.enabled && alerts_init(cfg->alerts.rules, cfg->alerts.rule_count) != 0)
+    return SQLITE_ERROR;
+
+  if (strcmp(cfg->republish.mode, "all") != 0 && strcmp(cfg->republish.mode, "conflate") != 0)
+  {
+    fprintf(stderr, "Mode de republication inconnu : %s (all, conflate)\n", cfg->republish.mode);
+    return SQLITE_ERROR;
+  }
+  conflate_republish = (strcmp(cfg->republish.mode, "conflate") == 0);
+  const double delta[CONFLATION_METRICS] = {cfg->republish.temperature, cfg->republish.pression,
+                                            cfg->republish.humidite};
+  conflation_init(cfg->republish.min_interval_ms, delta);
+
+  if (cfg->rollup.enabled)
+  {
+    rc = rollup_init(db);
+    if (rc != SQLITE_OK)
+    {
+      fprintf(stderr, "Erreur initialisation agrégats\n");
+      return rc;
+    }
+  }
+
   if (new_db)
   {
     rc = sqlite3_exec(db, "VACUUM;", NULL, NULL, &errMsg);
@@ -80,11 +189,10 @@ int initDatabase(const Config *cfg)
     }
   }
 
-  const char *insert_sql =
-      "INSERT INTO mesures (timestamp, temperature, pression, humidite) "
-      "VALUES (?, ?, ?, ?);";
+  rc = sqlite3_prepare_v2(db, "BEGIN;", -1, &begin_stmt, NULL);
+  if (rc == SQLITE_OK)
+    rc = sqlite3_prepare_v2(db, "COMMIT;", -1, &commit_stmt, NULL);
 
-  rc = sqlite3_prepare_v2(db, insert_sql, -1, &insert_stmt, NULL);
   if (rc != SQLITE_OK)
   {
     fprintf(stderr, "Erreur préparation statement : %s\n", sqlite3_errmsg(db));
@@ -95,247 +203,1402 @@ int initDatabase(const Config *cfg)
   return SQLITE_OK;
 }
 
-int insertData(const char *timestamp, double temp, double press, double hum)
+static int stepOnce(sqlite3_stmt *stmt)
 {
-  if (!insert_stmt)
+  int rc = sqlite3_step(stmt);
+  sqlite3_reset(stmt);
+  return (rc == SQLITE_DONE) ? SQLITE_OK : rc;
+}
+
+static int commitBatch(void)
+{
+  if (pending_rows == 0)
+    return SQLITE_OK;
+
+  int rows = pending_rows;
+  pending_rows = 0;
+
+  // Une erreur d'E/S peut avoir annulé la transaction côté SQLite
+  if (sqlite3_get_autocommit(db))
   {
-    fprintf(stderr, "Statement non initialisé\n");
-    return SQLITE_ERROR;
+    fprintf(stderr, "Transaction annulée par SQLite : %d lignes perdues\n", rows);
+    return SQLITE_ABORT;
   }
 
-  sqlite3_bind_text(insert_stmt, 1, timestamp, -1, SQLITE_TRANSIENT);
-  sqlite3_bind_double(insert_stmt, 2, temp);
-  sqlite3_bind_double(insert_stmt, 3, press);
-  sqlite3_bind_int(insert_stmt, 4, hum);
-
-  int rc = sqlite3_step(insert_stmt);
+  int64_t start_ns = metrics_now_ns();
 
-  sqlite3_reset(insert_stmt);
-  sqlite3_clear_bindings(insert_stmt);
+  // Les agrégats et les nouveaux appareils du lot sont validés avec les mesures brutes
+  if (app_config.rollup.enabled)
+    rollup_flush();
+  devices_persist();
 
-  if (rc != SQLITE_DONE)
+  int rc = stepOnce(commit_stmt);
+  metrics_record(METRIC_COMMIT, metrics_now_ns() - start_ns);
+  if (rc != SQLITE_OK)
   {
-    fprintf(stderr, "Erreur insertion : %s\n", sqlite3_errmsg(db));
+    fprintf(stderr, "Erreur commit (%d lignes) : %s\n", rows, sqlite3_errmsg(db));
+    sqlite3_exec(db, "ROLLBACK;", NULL, NULL, NULL);
     return rc;
   }
 
+  devices_mark_persisted();
+  metrics_count(COUNTER_COMMITS, 1);
+
+  if (app_config.logging.display_messages)
+  {
+    printf("=== Commit de %d lignes ===\n", rows);
+  }
+
   return SQLITE_OK;
 }
 
-void closeDatabase(void)
+static int beginBatch(void)
 {
-  if (insert_stmt)
-  {
-    sqlite3_finalize(insert_stmt);
-    insert_stmt = NULL;
-  }
+  if (pending_rows > 0)
+    return SQLITE_OK;
 
-  if (db)
+  int rc = stepOnce(begin_stmt);
+  if (rc != SQLITE_OK)
   {
-    sqlite3_close(db);
-    db = NULL;
+    fprintf(stderr, "Erreur ouverture transaction : %s\n", sqlite3_errmsg(db));
+    return rc;
   }
+  batch_started_ms = getMonotonicMillis();
+  return SQLITE_OK;
 }
 
-// ===== JSON =====
-
-int parseAndStore(const char *jsonString)
+// Écrit une ligne dans sa partition, transaction ouverte
+static int writeRow(int device, const CompressedPoint *point)
 {
-  struct json_object *parsed_json;
-  struct json_object *temp_obj, *press_obj, *hum_obj;
+  sqlite3_stmt *insert_stmt = partitions_insert_stmt(point->ts_ms);
+  if (!insert_stmt)
+    return SQLITE_ERROR;
+
+  sqlite3_bind_int(insert_stmt, 1, device);
+  sqlite3_bind_int64(insert_stmt, 2, point->ts_ms);
+  sqlite3_bind_double(insert_stmt, 3, point->value[0]);
+  sqlite3_bind_double(insert_stmt, 4, point->value[1]);
+  sqlite3_bind_double(insert_stmt, 5, point->value[2]);
+
+  int64_t start_ns = metrics_now_ns();
+  int rc = sqlite3_step(insert_stmt);
 
-  parsed_json = json_tokener_parse(jsonString);
+  sqlite3_reset(insert_stmt);
+  sqlite3_clear_bindings(insert_stmt);
+  metrics_record(METRIC_INSERT, metrics_now_ns() - start_ns);
 
-  if (parsed_json == NULL)
+  if (rc != SQLITE_DONE)
   {
-    printf("Erreur parsing JSON\n");
-    return -1;
+    metrics_count(COUNTER_INSERT_ERRORS, 1);
+    fprintf(stderr, "Erreur insertion : %s\n", sqlite3_errmsg(db));
+    return rc;
   }
 
-  if (!json_object_object_get_ex(parsed_json, "temperature", &temp_obj) ||
-      !json_object_object_get_ex(parsed_json, "pression", &press_obj) ||
-      !json_object_object_get_ex(parsed_json, "humidite", &hum_obj))
+  metrics_count(COUNTER_INSERTED, 1);
+  return SQLITE_OK;
+}
+
+/*
+ * Chaque lecture compte dans le lot, stockée ou filtrée par la compression :
+ * elle a mis à jour agrégats et fenêtre récente dans la transaction.
+ * summary : résumé d'appareil dont les extrêmes alimentent les agrégats, NULL sinon.
+ */
+static int insertRow(int device, int64_t timestamp_ms, double temp, double press, double hum,
+                     const SensorSample *summary)
+{
+  if (!db)
   {
-    printf("JSON incomplet\n");
-    json_object_put(parsed_json);
-    return -1;
+    fprintf(stderr, "Base de données non initialisée\n");
+    return SQLITE_ERROR;
   }
 
-  double temperature = json_object_get_double(temp_obj);
-  double pression = json_object_get_double(press_obj);
-  double humidite = json_object_get_double(hum_obj);
+  int rc = beginBatch();
+  if (rc != SQLITE_OK)
+    return rc;
 
-  if (app_config.logging.display_messages)
+  const double values[COMPRESSION_METRICS] = {temp, press, hum};
+  CompressedPoint points[2];
+  int count = compression_offer(device, timestamp_ms, values, points);
+  if (count < 0)
   {
-    printf("Données parsées :\n");
-    printf(" - Température : %.1f °C\n", temperature);
-    printf(" - Pression : %.1f hPa\n", pression);
-    printf(" - Humidité : %.1f %%\n", humidite);
+    // État de compression indisponible : lecture stockée telle quelle
+    points[0] = (CompressedPoint){timestamp_ms, {temp, press, hum}};
+    count = 1;
+  }
+  else if (count == 0)
+  {
+    metrics_count(COUNTER_COMPRESSED, 1);
   }
 
-  char timestamp[64];
-  getUTCTimestamp(timestamp, sizeof(timestamp));
+  for (int i = 0; i < count; i++)
+  {
+    rc = writeRow(device, &points[i]);
+    if (rc != SQLITE_OK)
+    {
+      // La transaction reste ouverte pour les lignes déjà insérées
+      if (pending_rows == 0)
+        stepOnce(commit_stmt);
+      return rc;
+    }
+  }
 
-  int result = insertData(timestamp, temperature, pression, humidite);
+  pending_rows++;
 
-  if (result == SQLITE_OK)
+  if (app_config.rollup.enabled)
   {
-    if (app_config.logging.display_messages)
+    if (summary)
     {
-      printf("=== Message enregistré ===\n");
+      const double min[3] = {summary->temperature_spread.min, summary->pression_spread.min,
+                             summary->humidite_spread.min};
+      const double max[3] = {summary->temperature_spread.max, summary->pression_spread.max,
+                             summary->humidite_spread.max};
+      rollup_add_range(device, timestamp_ms, values, min, max);
     }
+    else
+    {
+      rollup_add(device, timestamp_ms, temp, press, hum);
+    }
+  }
+
+  if (app_config.query.enabled)
+    recent_cache_add(device, timestamp_ms, temp, press, hum);
 
-    republishWithTimestamp(timestamp, temperature, pression, humidite);
+  if (pending_rows >= app_config.database.batch_size)
+  {
+    return commitBatch();
   }
 
-  json_object_put(parsed_json);
-  return result;
+  return SQLITE_OK;
 }
 
-int republishWithTimestamp(const char *timestamp, double temp, double press, double hum)
+// Lecture retenue par compression_flush (appareil muet ou arrêt)
+static int storeHeldRow(void *ctx, int device, const CompressedPoint *point)
 {
-  const char *republish_topic = app_config.mqtt.topic_republish;
+  (void)ctx;
 
-  struct json_object *json_obj = json_object_new_object();
+  int rc = beginBatch();
+  if (rc == SQLITE_OK)
+    rc = writeRow(device, point);
 
-  json_object_object_add(json_obj, "timestamp", json_object_new_string(timestamp));
+  if (rc != SQLITE_OK)
+  {
+    if (pending_rows == 0)
+      stepOnce(commit_stmt);
+    return rc;
+  }
 
-  char temp_str[16];
-  snprintf(temp_str, sizeof(temp_str), "%.1f", temp);
-  json_object_object_add(json_obj, "temperature", json_object_new_string(temp_str));
+  pending_rows++;
+  return SQLITE_OK;
+}
 
-  char press_str[16];
-  snprintf(press_str, sizeof(press_str), "%.1f", press);
-  json_object_object_add(json_obj, "pression", json_object_new_string(press_str));
+int insertData(int64_t timestamp_ms, double temp, double press, double hum)
+{
+  return insertRow(0, timestamp_ms, temp, press, hum, NULL);
+}
 
-  char hum_str[8];
-  snprintf(hum_str, sizeof(hum_str), "%.1f", hum);
-  json_object_object_add(json_obj, "humidite", json_object_new_string(hum_str));
+int insertSample(int64_t timestamp_ms, const SensorSample *sample)
+{
+  return insertRow(sample->device_id, timestamp_ms, sample->temperature, sample->pression, sample->humidite,
+                   sample->readings > 0 ? sample : NULL);
+}
 
-  const char *json_string = json_object_to_json_string(json_obj);
+int commitPendingData(void)
+{
+  return commitBatch();
+}
 
-  if (app_config.logging.display_messages)
+int flushExpiredBatch(void)
+{
+  if (pending_rows > 0 &&
+      getMonotonicMillis() - batch_started_ms >= app_config.database.batch_timeout_ms)
   {
-    printf("Republication sur %s : %s\n", republish_topic, json_string);
+    return commitBatch();
   }
 
-  MQTTClient_message pubmsg = MQTTClient_message_initializer;
-  pubmsg.payload = (void *)json_string;
-  pubmsg.payloadlen = strlen(json_string);
-  pubmsg.qos = 1;
-  pubmsg.retained = 0;
+  return SQLITE_OK;
+}
+
+int batchRemainingMillis(void)
+{
+  if (pending_rows == 0)
+    return -1;
 
-  MQTTClient_deliveryToken token;
-  int rc = MQTTClient_publishMessage(mqtt_client, republish_topic, &pubmsg, &token);
+  long long remaining = batch_started_ms + app_config.database.batch_timeout_ms - getMonotonicMillis();
+  return (remaining > 0) ? (int)remaining : 0;
+}
+
+static void logRetention(const char *message)
+{
+  char log_path[1024];
+  char now[64];
+
+  config_resolve_path(&app_config, app_config.logging.cleanup_log, log_path, sizeof(log_path));
+  getUTCTimestamp(now, sizeof(now));
 
-  if (rc != MQTTCLIENT_SUCCESS)
+  FILE *log = fopen(log_path, "a");
+  if (log)
   {
-    fprintf(stderr, "Erreur republication MQTT: %d\n", rc);
-    json_object_put(json_obj);
-    return -1;
+    fprintf(log, "[%s] %s\n", now, message);
+    fclose(log);
   }
-  else
+
+  if (app_config.logging.display_messages)
   {
-    if (app_config.logging.display_messages)
+    printf("%s\n", message);
+  }
+}
+
+// Archive la partition avant sa suppression ; en cas d'échec elle est conservée
+static int onPartitionDrop(void *ctx, const char *name)
+{
+  (void)ctx;
+
+  char message[1200];
+
+  if (app_config.archive.enabled)
+  {
+    char archive_dir[1024];
+    config_resolve_path(&app_config, app_config.archive.dir, archive_dir, sizeof(archive_dir));
+
+    long archived = archive_partition(db, name, archive_dir);
+    if (archived < 0)
     {
-      printf("=== Message republié ===\n");
+      snprintf(message, sizeof(message), "Archivage impossible, partition conservée : %s", name);
+      logRetention(message);
+      return -1;
     }
-  }
 
-  json_object_put(json_obj);
+    snprintf(message, sizeof(message), "Partition archivée : %s (%ld mesures)", name, archived);
+    logRetention(message);
+  }
 
-  return (rc == MQTTCLIENT_SUCCESS) ? 0 : -1;
+  snprintf(message, sizeof(message), "Partition supprimée : %s", name);
+  logRetention(message);
+  return 0;
 }
 
-// ===== MQTT =====
-
-int messageArrived(void *context, char *topicName, int topicLen, MQTTClient_message *message)
+// Limite de rétention en epoch ms, 0 si la rétention est désactivée
+static int64_t retentionCutoff(int64_t now_ms, int hours)
 {
-  (void)context;
-  (void)topicLen;
+  return (hours > 0) ? now_ms - (int64_t)hours * 3600 * 1000 : 0;
+}
 
-  char *payload = (char *)message->payload;
+int applyRetention(void)
+{
+  int64_t now_ms = getEpochMillis();
 
-  if (app_config.logging.display_messages)
-  {
-    printf("\n=== Message reçu ===\n");
+  // Appareils muets depuis max_gap_s : leur dernière lecture en attente est stockée
+  compression_flush(now_ms - (int64_t)app_config.compression.max_gap_s * 1000, storeHeldRow, NULL);
 
-    char readable_ts[64];
-    getUTCTimestamp(readable_ts, sizeof(readable_ts));
+  // Les lignes en attente peuvent appartenir à une partition expirée
+  commitPendingData();
 
-    printf("Date, Heure : %s\n", readable_ts);
-    printf("Topic : %s\n", topicName);
+  if (app_config.rollup.enabled)
+  {
+    int64_t rollup_cutoff_ms[ROLLUP_LEVELS] = {
+        retentionCutoff(now_ms, app_config.rollup.retention_1m_hours),
+        retentionCutoff(now_ms, app_config.rollup.retention_1h_hours),
+    };
+    rollup_purge(rollup_cutoff_ms);
   }
 
-  parseAndStore(payload);
+  int64_t cutoff_ms = retentionCutoff(now_ms, app_config.database.retention_hours);
+  if (cutoff_ms <= 0)
+    return 0;
 
-  MQTTClient_freeMessage(&message);
-  MQTTClient_free(topicName);
+  if (app_config.query.enabled)
+    recent_cache_evict(cutoff_ms);
 
-  return 1;
+  return partitions_drop_expired(cutoff_ms, onPartitionDrop, NULL);
 }
 
-void connectionLost(void *context, char *cause)
+void closeDatabase(void)
 {
-  (void)context;
+  if (db)
+  {
+    compression_flush(INT64_MAX, storeHeldRow, NULL);
+    commitPendingData();
+  }
 
-  printf("\nConnexion MQTT perdue : %s\n", cause);
-  printf("Tentative de reconnexion automatique...\n");
+  compression_close();
+  window_stats_close();
+  alerts_close();
+  conflation_close();
+  partitions_close();
+  rollup_close();
+  devices_close();
+
+  sqlite3_finalize(begin_stmt);
+  sqlite3_finalize(commit_stmt);
+  begin_stmt = NULL;
+  commit_stmt = NULL;
+
+  if (db)
+  {
+    sqlite3_close(db);
+    db = NULL;
+  }
 }
 
-// ===== MAIN =====
+// ===== JSON =====
 
-int main(int argc, char *argv[])
+int parseSamples(const char *payload, size_t len, int device, SensorSample *samples, int max)
 {
-  MQTTClient_connectOptions conn_opts = MQTTClient_connectOptions_initializer;
+  int64_t start_ns = metrics_now_ns();
+  int count = payload_parse_samples(payload, len, samples, max);
+  metrics_record(METRIC_PARSE, metrics_now_ns() - start_ns);
 
-  printf("\n=== Subscriber MQTT ===\n");
+  if (count < 0)
+  {
+    metrics_count(COUNTER_PARSE_ERRORS, 1);
+    printf("Erreur parsing payload\n");
+    return -1;
+  }
 
-  const char *config_file = (argc > 1) ? argv[1] : "config.toml";
+  metrics_count(COUNTER_PARSED, 1);
 
-  if (config_load(&app_config, config_file) != 0)
+  // Appareil nommé par le topic : prime sur l'identifiant du paquet binaire.
+  // Topic sans '+' : identifiant du paquet (0 en JSON) interné sous le nom id<N>
+  if (device < 0)
   {
-    fprintf(stderr, "Erreur : impossible de charger %s\n", config_file);
-    exit(EXIT_FAILURE);
+    char name[DEVICE_NAME_SIZE];
+    int len = snprintf(name, sizeof(name), "id%d", samples[0].device_id);
+    device = devices_intern(name, (size_t)len);
+    if (device < 0)
+    {
+      metrics_count(COUNTER_DEVICES_REJECTED, 1);
+      return -1;
+    }
   }
 
-  config_display(&app_config);
+  for (int i = 0; i < count; i++)
+    samples[i].device_id = device;
 
-  char current_time[64];
-  getUTCTimestamp(current_time, sizeof(current_time));
-  printf("Heure système UTC : %s\n\n", current_time);
+  if (app_config.logging.display_messages)
+  {
+    if (count > 1)
+      printf("Lot de %d mesures\n", count);
+    for (int i = 0; i < count; i++)
+    {
+      const SensorSample *sample = &samples[i];
+      if (sample->sequence >= 0)
+        printf("Paquet binaire : appareil %d, séquence %lld%s\n", sample->device_id,
+               (long long)sample->sequence, (sample->flags & SENSOR_FLAG_BOOT) ? ", démarrage" : "");
+      printf("Données parsées%s :\n", sample->age_ms ? " (différées)" : "");
+      printf(" - Température : %.1f °C\n", sample->temperature);
+      printf(" - Pression : %.1f hPa\n", sample->pression);
+      printf(" - Humidité : %.1f %%\n", sample->humidite);
+      if (sample->readings > 0)
+        printf(" - Résumé de %d lectures : %.1f..%.1f °C (σ %.2f), %.1f..%.1f hPa (σ %.2f), %.1f..%.1f %% (σ %.2f)\n",
+               sample->readings, sample->temperature_spread.min, sample->temperature_spread.max,
+               sample->temperature_spread.stddev, sample->pression_spread.min, sample->pression_spread.max,
+               sample->pression_spread.stddev, sample->humidite_spread.min, sample->humidite_spread.max,
+               sample->humidite_spread.stddev);
+    }
+  }
 
-  if (initDatabase(&app_config) != SQLITE_OK)
+  return count;
+}
+
+int storeBackfillSample(int64_t timestamp_ms, const SensorSample *sample)
+{
+  // Partition déjà supprimée ou sur le point de l'être : inutile de la recréer
+  int64_t cutoff_ms = retentionCutoff(getEpochMillis(), app_config.database.retention_hours);
+  if (timestamp_ms < cutoff_ms)
   {
-    exit(EXIT_FAILURE);
+    metrics_count(COUNTER_BACKFILL_EXPIRED, 1);
+    return SQLITE_OK;
   }
 
-  MQTTClient_create(&mqtt_client, app_config.mqtt.broker_address,
-                    app_config.mqtt.client_id,
-                    MQTTCLIENT_PERSISTENCE_NONE, NULL);
-  MQTTClient_setCallbacks(mqtt_client, NULL, connectionLost, messageArrived, NULL);
+  int result = insertSample(timestamp_ms, sample);
+  if (result == SQLITE_OK)
+    metrics_count(COUNTER_BACKFILLED, 1);
+
+  return result;
+}
+
+int parseAndStore(const char *payload, size_t len, int device, int64_t received_ms)
+{
+  SensorSample samples[PAYLOAD_MAX_SAMPLES];
+  int result = SQLITE_OK;
 
-  conn_opts.keepAliveInterval = app_config.mqtt.keepalive_interval;
-  conn_opts.cleansession = 1;
+  int count = parseSamples(payload, len, device, samples, PAYLOAD_MAX_SAMPLES);
+  if (count < 0)
+    return -1;
 
-  if (MQTTClient_connect(mqtt_client, &conn_opts) != MQTTCLIENT_SUCCESS)
+  // Mesures d'un lot insérées à la suite, dans la transaction groupée courante
+  for (int i = 0; i < count; i++)
   {
-    printf("Échec connexion broker\n");
-    closeDatabase();
-    exit(EXIT_FAILURE);
+    int rc = storeSample(received_ms - samples[i].age_ms, &samples[i]);
+    if (rc != SQLITE_OK)
+      result = rc;
   }
-  MQTTClient_subscribe(mqtt_client, app_config.mqtt.topic, app_config.mqtt.qos);
 
-  printf("En attente des données ESP32...\n");
+  return result;
+}
 
-  while (1)
+int storeSample(int64_t timestamp_ms, const SensorSample *sample)
+{
+  double temperature = sample->temperature;
+  double pression = sample->pression;
+  double humidite = sample->humidite;
+
+  int result = insertSample(timestamp_ms, sample);
+
+  if (result == SQLITE_OK)
   {
-    sleep(10);
+    if (app_config.logging.display_messages)
+    {
+      printf("=== Message enregistré ===\n");
+    }
+
+    if (app_config.window.enabled)
+    {
+      const double values[WINDOW_METRICS] = {temperature, pression, humidite};
+      window_stats_add(sample->device_id, timestamp_ms, values);
+    }
+
+    if (app_config.alerts.enabled)
+    {
+      int64_t start_ns = metrics_now_ns();
+      const double values[ALERT_METRICS] = {temperature, pression, humidite};
+      alerts_evaluate(sample->device_id, timestamp_ms, values, publishAlert, NULL);
+      metrics_record(METRIC_ALERTS, metrics_now_ns() - start_ns);
+    }
+
+    if (!conflate_republish)
+    {
+      char timestamp[64];
+      formatUTCTimestamp(timestamp_ms, timestamp, sizeof(timestamp));
+      republishWithTimestamp(sample->device_id, timestamp, temperature, pression, humidite);
+    }
+
+    if (conflate_republish || app_config.republish.snapshot_topic[0])
+    {
+      const double values[CONFLATION_METRICS] = {temperature, pression, humidite};
+      int sent = conflation_offer(sample->device_id, getMonotonicMillis(), timestamp_ms, values, publishLatest, NULL);
+      if (sent == 0 && conflate_republish)
+        metrics_count(COUNTER_CONFLATED, 1);
+    }
   }
 
-  MQTTClient_disconnect(mqtt_client, 10000);
-  MQTTClient_destroy(&mqtt_client);
-  closeDatabase();
+  return result;
+}
 
-  return 0;
+// context : instant de remise au client MQTT (metrics_now_ns)
+static void onPublishSuccess(void *context, MQTTAsync_successData *response)
+{
+  (void)response;
+  metrics_record(METRIC_PUBACK, metrics_now_ns() - (int64_t)(intptr_t)context);
+  atomic_fetch_sub(&republish_inflight, 1);
+}
+
+static void onPublishFailure(void *context, MQTTAsync_failureData *response)
+{
+  (void)context;
+  atomic_fetch_sub(&republish_inflight, 1);
+  fprintf(stderr, "Erreur republication MQTT : %d\n", response ? response->code : -1);
+}
+
+// Topic d'un appareil selon pattern ; NULL si le nom ne tient pas
+static const char *deviceTopic(const char *pattern, int device, char *topic, size_t size)
+{
+  char name[DEVICE_NAME_SIZE];
+
+  if (!strchr(pattern, '+'))
+    return pattern;
+
+  if (devices_name(device, name, sizeof(name)) != 0)
+    snprintf(name, sizeof(name), "%d", device);
+
+  return (devices_format_topic(pattern, name, topic, size) == 0) ? topic : NULL;
 }
+
+// Mesure sérialisée sur le topic pattern de l'appareil, QoS 1 dans la fenêtre max_inflight
+static int publishSample(const char *pattern, int retained, int device, const char *timestamp, double temp,
+                         double press, double hum)
+{
+  char topic_buffer[256];
+  const char *republish_topic = deviceTopic(pattern, device, topic_buffer, sizeof(topic_buffer));
+
+  if (!republish_topic)
+  {
+    fprintf(stderr, "Topic de republication trop long (appareil %d)\n", device);
+    return -1;
+  }
+
+  int64_t start_ns = metrics_now_ns();
+  SensorSample sample = {.temperature = temp, .pression = press, .humidite = hum};
+  int len = payload_format_republish(republish_buffer, sizeof(republish_buffer), timestamp, &sample);
+  if (len < 0)
+  {
+    fprintf(stderr, "Erreur sérialisation republication\n");
+    return -1;
+  }
+
+  // Lecteurs locaux servis même si la fenêtre QoS 1 du broker est pleine
+  fanout_publish(republish_topic, republish_buffer, (size_t)len, retained);
+
+  if (atomic_load(&republish_inflight) >= app_config.mqtt.max_inflight)
+  {
+    atomic_fetch_add(&republish_dropped, 1);
+    return -1;
+  }
+
+  if (app_config.logging.display_messages)
+  {
+    printf("Republication sur %s : %s\n", republish_topic, republish_buffer);
+  }
+
+  // MQTTAsync copie le payload : republish_buffer est réutilisable au retour
+  MQTTAsync_message pubmsg = MQTTAsync_message_initializer;
+  pubmsg.payload = republish_buffer;
+  pubmsg.payloadlen = len;
+  pubmsg.qos = 1;
+  pubmsg.retained = retained;
+
+  MQTTAsync_responseOptions opts = MQTTAsync_responseOptions_initializer;
+  opts.onSuccess = onPublishSuccess;
+  opts.onFailure = onPublishFailure;
+
+  atomic_fetch_add(&republish_inflight, 1);
+  opts.context = (void *)(intptr_t)metrics_now_ns();
+  int rc = MQTTAsync_sendMessage(mqtt_client, republish_topic, &pubmsg, &opts);
+  metrics_record(METRIC_REPUBLISH, metrics_now_ns() - start_ns);
+
+  if (rc != MQTTASYNC_SUCCESS)
+  {
+    atomic_fetch_sub(&republish_inflight, 1);
+    fprintf(stderr, "Erreur republication MQTT: %d\n", rc);
+    return -1;
+  }
+
+  metrics_count(COUNTER_REPUBLISHED, 1);
+
+  if (app_config.logging.display_messages)
+  {
+    printf("=== Message republié ===\n");
+  }
+
+  return 0;
+}
+
+int republishWithTimestamp(int device, const char *timestamp, double temp, double press, double hum)
+{
+  return publishSample(app_config.mqtt.topic_republish, 0, device, timestamp, temp, press, hum);
+}
+
+int publishLatest(void *ctx, int device, int64_t ts_ms, const double value[CONFLATION_METRICS])
+{
+  (void)ctx;
+
+  char timestamp[64];
+  int rc = 0;
+
+  formatUTCTimestamp(ts_ms, timestamp, sizeof(timestamp));
+
+  if (conflate_republish)
+    rc |= publishSample(app_config.mqtt.topic_republish, 0, device, timestamp, value[0], value[1], value[2]);
+
+  if (app_config.republish.snapshot_topic[0])
+    rc |= publishSample(app_config.republish.snapshot_topic, 1, device, timestamp, value[0], value[1], value[2]);
+
+  return rc ? -1 : 0;
+}
+
+int publishWindowStats(void)
+{
+  if (!app_config.window.enabled)
+    return 0;
+
+  WindowSnapshot windows[WINDOW_MAX_SIZES];
+  int published = 0;
+
+  for (int device = 0; window_stats_next_dirty(&device); device++)
+  {
+    char topic_buffer[256];
+    char timestamp[64];
+    int64_t last_ts;
+
+    int count = window_stats_get(device, windows, &last_ts);
+    const char *topic = deviceTopic(app_config.window.topic, device, topic_buffer, sizeof(topic_buffer));
+    if (count == 0 || !topic)
+      continue;
+
+    formatUTCTimestamp(last_ts, timestamp, sizeof(timestamp));
+    int len = window_stats_format(window_buffer, sizeof(window_buffer), timestamp, windows, count);
+    if (len < 0)
+    {
+      fprintf(stderr, "Erreur sérialisation fenêtres glissantes\n");
+      continue;
+    }
+
+    fanout_publish(topic, window_buffer, (size_t)len, 0);
+
+    // QoS 0 : la publication suivante remplace celle-ci, rien à acquitter
+    MQTTAsync_message pubmsg = MQTTAsync_message_initializer;
+    pubmsg.payload = window_buffer;
+    pubmsg.payloadlen = len;
+    pubmsg.qos = 0;
+    pubmsg.retained = 0;
+
+    MQTTAsync_responseOptions opts = MQTTAsync_responseOptions_initializer;
+    if (MQTTAsync_sendMessage(mqtt_client, topic, &pubmsg, &opts) == MQTTASYNC_SUCCESS)
+      published++;
+  }
+
+  return published;
+}
+
+void publishAlert(void *ctx, const AlertEvent *event)
+{
+  (void)ctx;
+
+  char topic_buffer[256];
+  char timestamp[64];
+
+  metrics_count(COUNTER_ALERTS, 1);
+
+  const char *topic = deviceTopic(app_config.alerts.topic, event->device, topic_buffer, sizeof(topic_buffer));
+  formatUTCTimestamp(event->ts_ms, timestamp, sizeof(timestamp));
+  int len = alerts_format(alert_buffer, sizeof(alert_buffer), timestamp, event);
+  if (!topic || len < 0)
+  {
+    fprintf(stderr, "Erreur sérialisation alerte %s (appareil %d)\n", event->rule, event->device);
+    return;
+  }
+
+  if (app_config.logging.display_messages)
+  {
+    printf("Alerte sur %s : %s\n", topic, alert_buffer);
+  }
+
+  fanout_publish(topic, alert_buffer, (size_t)len, 0);
+
+  MQTTAsync_message pubmsg = MQTTAsync_message_initializer;
+  pubmsg.payload = alert_buffer;
+  pubmsg.payloadlen = len;
+  pubmsg.qos = 1;
+  pubmsg.retained = 0;
+
+  MQTTAsync_responseOptions opts = MQTTAsync_responseOptions_initializer;
+  int rc = MQTTAsync_sendMessage(mqtt_client, topic, &pubmsg, &opts);
+  if (rc != MQTTASYNC_SUCCESS)
+    fprintf(stderr, "Erreur publication alerte MQTT : %d\n", rc);
+}
+
+// ===== MQTT =====
+
+static void enqueuePayload(RingBuffer *queue, const void *payload, int len, int device)
+{
+  // Plus long que tout message du firmware : ignoré, sans compter comme file pleine
+  if (len < 0 || len > RING_PAYLOAD_SIZE)
+  {
+    metrics_count(COUNTER_OVERSIZED, 1);
+    return;
+  }
+
+  RingSlot *slot = ring_reserve(queue);
+  if (!slot)
+    return;
+
+  slot->received_ms = getEpochMillis();
+  slot->enqueued_ns = metrics_now_ns();
+  slot->device = device;
+  slot->len = (size_t)len;
+  memcpy(slot->payload, payload, slot->len);
+  ring_commit(queue);
+}
+
+int messageArrived(void *context, char *topicName, int topicLen, MQTTAsync_message *message)
+{
+  IngestWorker *worker = context;
+  (void)topicLen;
+
+  if (app_config.logging.display_messages)
+  {
+    printf("\n=== Message reçu ===\n");
+
+    char readable_ts[64];
+    getUTCTimestamp(readable_ts, sizeof(readable_ts));
+
+    printf("Date, Heure : %s\n", readable_ts);
+    printf("Topic : %s\n", topicName);
+  }
+
+  // Copie seulement : le traitement se fait sur le worker ou le thread d'écriture.
+  // Pendant l'arrêt, ils ne consomment plus : message ignoré.
+  if (keep_running)
+  {
+    char name[DEVICE_NAME_SIZE];
+    int name_len = -1;
+    int backfill = backfill_enabled && worker == &ingest_workers[0] &&
+                   (name_len = devices_match_topic(app_config.mqtt.backfill_topic, topicName, name, sizeof(name))) >= 0;
+
+    if (!backfill)
+      name_len = devices_match_topic(app_config.mqtt.topic, topicName, name, sizeof(name));
+
+    // Niveau '+' du topic : nom de l'appareil, interné en clé entière
+    int device = (name_len > 0) ? devices_intern(name, (size_t)name_len) : -1;
+    if (name_len > 0 && device < 0)
+      metrics_count(COUNTER_DEVICES_REJECTED, 1);
+    else
+      enqueuePayload(backfill ? &backfill_queue : &worker->input, message->payload, message->payloadlen, device);
+  }
+
+  MQTTAsync_freeMessage(&message);
+  MQTTAsync_free(topicName);
+
+  return 1;
+}
+
+void connectionLost(void *context, char *cause)
+{
+  (void)context;
+
+  printf("\nConnexion MQTT perdue : %s\n", cause);
+  printf("Tentative de reconnexion automatique...\n");
+}
+
+// ===== WORKERS DE PARSING =====
+
+static void *ingestWorker(void *arg)
+{
+  IngestWorker *worker = arg;
+  SensorSample samples[PAYLOAD_MAX_SAMPLES];
+
+  while (1)
+  {
+    ring_wait(&worker->input, 1000);
+
+    RingSlot *slot;
+    while ((slot = ring_peek(&worker->input)) != NULL)
+    {
+      metrics_record(METRIC_RECEIVE, metrics_now_ns() - slot->enqueued_ns);
+
+      int count = parseSamples(slot->payload, slot->len, slot->device, samples, PAYLOAD_MAX_SAMPLES);
+
+      for (int i = 0; i < count; i++)
+      {
+        // Thread d'écriture en retard : on attend, la contre-pression remonte
+        // jusqu'à la file d'entrée (pertes comptées par le callback MQTT)
+        IngestRow *row;
+        while ((row = ring_try_reserve(&worker->rows)) == NULL)
+          usleep(100);
+
+        row->timestamp_ms = slot->received_ms - samples[i].age_ms;
+        row->sample = samples[i];
+        ring_commit(&worker->rows);
+      }
+      ring_release(&worker->input);
+    }
+
+    if (!atomic_load(&workers_running) && ring_peek(&worker->input) == NULL)
+      break;
+  }
+
+  return NULL;
+}
+
+int startIngestWorkers(int count)
+{
+  size_t capacity = (size_t)app_config.queue.capacity;
+
+  if (count < 1)
+    count = 1;
+  if (count > MAX_INGEST_WORKERS)
+  {
+    fprintf(stderr, "workers limité à %d\n", MAX_INGEST_WORKERS);
+    count = MAX_INGEST_WORKERS;
+  }
+
+  for (int i = 0; i < count; i++)
+  {
+    IngestWorker *worker = &ingest_workers[i];
+    if (ring_init(&worker->input, capacity, sizeof(RingSlot)) != 0)
+      return -1;
+
+    // Un seul thread d'écriture pour toutes les files de mesures parsées
+    if (count > 1)
+    {
+      if (ring_init(&worker->rows, capacity, sizeof(IngestRow)) != 0)
+        return -1;
+      ring_share_wakeup(&worker->rows, &ingest_workers[0].rows);
+    }
+  }
+
+  ingest_worker_count = count;
+
+  // Réveil partagé avec la file que le thread d'écriture attend
+  backfill_enabled = (app_config.mqtt.backfill_topic[0] != '\0');
+  if (backfill_enabled)
+  {
+    if (ring_init(&backfill_queue, (size_t)app_config.queue.backfill_capacity, sizeof(RingSlot)) != 0)
+      return -1;
+    ring_share_wakeup(&backfill_queue, (count > 1) ? &ingest_workers[0].rows : &ingest_workers[0].input);
+  }
+
+  if (count == 1)
+    return 0;
+
+  atomic_store(&workers_running, 1);
+
+  for (int i = 0; i < count; i++)
+  {
+    if (pthread_create(&ingest_workers[i].thread, NULL, ingestWorker, &ingest_workers[i]) != 0)
+    {
+      fprintf(stderr, "Erreur création worker %d\n", i);
+      atomic_store(&workers_running, 0);
+      for (int j = 0; j < i; j++)
+      {
+        ring_wake(&ingest_workers[j].input);
+        pthread_join(ingest_workers[j].thread, NULL);
+      }
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+void stopIngestWorkers(void)
+{
+  if (!atomic_exchange(&workers_running, 0))
+    return;
+
+  for (int i = 0; i < ingest_worker_count; i++)
+  {
+    ring_wake(&ingest_workers[i].input);
+    pthread_join(ingest_workers[i].thread, NULL);
+  }
+}
+
+void closeIngestWorkers(void)
+{
+  for (int i = 0; i < MAX_INGEST_WORKERS; i++)
+  {
+    ring_destroy(&ingest_workers[i].input);
+    ring_destroy(&ingest_workers[i].rows);
+  }
+  ring_destroy(&backfill_queue);
+  backfill_enabled = 0;
+}
+
+// ===== THREAD D'ÉCRITURE =====
+
+// Lit les files jusqu'à les vider ; 1 si au moins une n'était pas vide
+static int drainQueues(void)
+{
+  int drained = 0;
+
+  if (ingest_worker_count == 1)
+  {
+    RingBuffer *queue = &ingest_workers[0].input;
+    RingSlot *slot;
+    while ((slot = ring_peek(queue)) != NULL)
+    {
+      metrics_record(METRIC_RECEIVE, metrics_now_ns() - slot->enqueued_ns);
+      parseAndStore(slot->payload, slot->len, slot->device, slot->received_ms);
+      ring_release(queue);
+      drained = 1;
+    }
+    return drained;
+  }
+
+  for (int i = 0; i < ingest_worker_count; i++)
+  {
+    RingBuffer *rows = &ingest_workers[i].rows;
+    IngestRow *row;
+    while ((row = ring_peek(rows)) != NULL)
+    {
+      storeSample(row->timestamp_ms, &row->sample);
+      ring_release(rows);
+      drained = 1;
+    }
+  }
+  return drained;
+}
+
+/*
+ * Au plus max messages de rattrapage (max < 0 : tous), parsés et insérés
+ * dans la transaction groupée courante. 1 s'il en reste.
+ */
+static int drainBackfill(int max)
+{
+  if (!backfill_enabled)
+    return 0;
+
+  SensorSample samples[PAYLOAD_MAX_SAMPLES];
+  RingSlot *slot;
+
+  for (int n = 0; max < 0 || n < max; n++)
+  {
+    if ((slot = ring_peek(&backfill_queue)) == NULL)
+      return 0;
+
+    int count = parseSamples(slot->payload, slot->len, slot->device, samples, PAYLOAD_MAX_SAMPLES);
+    for (int i = 0; i < count; i++)
+      storeBackfillSample(slot->received_ms - samples[i].age_ms, &samples[i]);
+
+    ring_release(&backfill_queue);
+  }
+
+  return ring_peek(&backfill_queue) != NULL;
+}
+
+static void *storageWriter(void *arg)
+{
+  (void)arg;
+
+  long long next_retention_ms = getMonotonicMillis();
+  RingBuffer *wakeup = (ingest_worker_count > 1) ? &ingest_workers[0].rows : &ingest_workers[0].input;
+  int backfill_pending = 0;
+
+  while (1)
+  {
+    // Attente bornée par l'échéance du lot en cours ; aucune s'il reste du rattrapage
+    int timeout_ms = batchRemainingMillis();
+    if (timeout_ms < 0)
+      timeout_ms = 1000;
+
+    // Réveil au plus tard à l'échéance de la prochaine mesure retenue
+    int conflation_ms = conflation_remaining_ms(getMonotonicMillis());
+    if (conflation_ms >= 0 && conflation_ms < timeout_ms)
+      timeout_ms = conflation_ms;
+
+    ring_wait(wakeup, backfill_pending ? 0 : timeout_ms);
+
+    drainQueues();
+    publishWindowStats();
+    conflation_flush(getMonotonicMillis(), publishLatest, NULL);
+
+    if (app_config.alerts.enabled)
+      alerts_check_stale(getEpochMillis(), publishAlert, NULL);
+
+    backfill_pending = drainBackfill(app_config.queue.backfill_burst);
+
+    flushExpiredBatch();
+
+    if (getMonotonicMillis() >= next_retention_ms)
+    {
+      applyRetention();
+      next_retention_ms = getMonotonicMillis() + RETENTION_CHECK_MS;
+    }
+
+    if (!atomic_load(&writer_running) && !drainQueues() && !drainBackfill(-1))
+      break;
+  }
+
+  commitPendingData();
+  return NULL;
+}
+
+int startStorageWriter(void)
+{
+  atomic_store(&writer_running, 1);
+
+  if (pthread_create(&writer_thread, NULL, storageWriter, NULL) != 0)
+  {
+    atomic_store(&writer_running, 0);
+    fprintf(stderr, "Erreur création thread d'écriture\n");
+    return -1;
+  }
+
+  return 0;
+}
+
+void stopStorageWriter(void)
+{
+  if (!atomic_exchange(&writer_running, 0))
+    return;
+
+  ring_wake(ingest_worker_count > 1 ? &ingest_workers[0].rows : &ingest_workers[0].input);
+  pthread_join(writer_thread, NULL);
+}
+
+void ingestQueueStats(RingStats *total)
+{
+  memset(total, 0, sizeof(*total));
+
+  for (int i = 0; i < ingest_worker_count; i++)
+  {
+    RingStats stats;
+    ring_stats(&ingest_workers[i].input, &stats);
+
+    total->capacity += stats.capacity;
+    total->depth += stats.depth;
+    total->high_water += stats.high_water;
+    total->pushed += stats.pushed;
+    total->dropped += stats.dropped;
+  }
+}
+
+void backfillQueueStats(RingStats *stats)
+{
+  if (backfill_enabled)
+    ring_stats(&backfill_queue, stats);
+  else
+    memset(stats, 0, sizeof(*stats));
+}
+
+void displayQueueStats(void)
+{
+  RingStats stats;
+  ingestQueueStats(&stats);
+
+  printf("File : %zu/%zu (max %zu), reçus %llu, perdus %llu\n",
+         stats.depth, stats.capacity, stats.high_water,
+         (unsigned long long)stats.pushed, (unsigned long long)stats.dropped);
+
+  if (backfill_enabled)
+  {
+    backfillQueueStats(&stats);
+    printf("Rattrapage : %zu/%zu (max %zu), reçus %llu, perdus %llu\n",
+           stats.depth, stats.capacity, stats.high_water,
+           (unsigned long long)stats.pushed, (unsigned long long)stats.dropped);
+  }
+  printf("Republication : %d en vol, %llu abandonnées\n",
+         atomic_load(&republish_inflight),
+         (unsigned long long)atomic_load(&republish_dropped));
+}
+
+// context : topic de l'abonnement (chaîne de app_config)
+static void onSubscribeFailure(void *context, MQTTAsync_failureData *response)
+{
+  fprintf(stderr, "Échec abonnement %s : %d\n", (const char *)context, response ? response->code : -1);
+}
+
+static void subscribeTopic(MQTTAsync client, const char *topic)
+{
+  // Plusieurs connexions : le broker répartit les messages entre les membres du groupe
+  char filter[256];
+  if (ingest_worker_count > 1)
+    snprintf(filter, sizeof(filter), "$share/%s/%s", app_config.mqtt.share_group, topic);
+  else
+    snprintf(filter, sizeof(filter), "%s", topic);
+
+  // cleansession : l'abonnement est refait à chaque (re)connexion
+  MQTTAsync_responseOptions opts = MQTTAsync_responseOptions_initializer;
+  opts.onFailure = onSubscribeFailure;
+  opts.context = (void *)topic;
+  MQTTAsync_subscribe(client, filter, app_config.mqtt.qos, &opts);
+}
+
+void connected(void *context, char *cause)
+{
+  IngestWorker *worker = context;
+  (void)cause;
+
+  subscribeTopic(worker->client, app_config.mqtt.topic);
+
+  // Rattrapage sur une seule connexion : la file n'a qu'un producteur
+  if (backfill_enabled && worker == &ingest_workers[0])
+    subscribeTopic(worker->client, app_config.mqtt.backfill_topic);
+
+  atomic_store(&worker->connected, 1);
+}
+
+// ===== DÉMARRAGE =====
+// Exclu avec -DSUBSCRIBER_NO_MAIN : le reste du fichier est alors lié dans les
+// benchmarks (make bench-stages) avec un client MQTT factice.
+#ifndef SUBSCRIBER_NO_MAIN
+
+// Première connexion : -1 si l'une des connexions a échoué
+static atomic_int connect_state = 0;
+
+static void onConnectFailure(void *context, MQTTAsync_failureData *response)
+{
+  (void)context;
+  (void)response;
+  atomic_store(&connect_state, -1);
+}
+
+static int warmRecentCache(void *ctx, int device, int64_t ts_ms, double temp, double press, double hum)
+{
+  (void)ctx;
+  return recent_cache_add(device, ts_ms, temp, press, hum);
+}
+
+// Fenêtre récente rechargée depuis les partitions puis servie sur la socket locale
+static int startQueryService(void)
+{
+  int64_t window_ms = (int64_t)app_config.database.retention_hours * 3600 * 1000;
+  char socket_path[1024];
+  char archive_dir[1024];
+
+  if (recent_cache_init(window_ms, (size_t)app_config.query.max_samples) != 0)
+    return -1;
+
+  int64_t from_ms = (window_ms > 0) ? getEpochMillis() - window_ms : INT64_MIN;
+  if (partitions_query_range(db, -1, from_ms, INT64_MAX, warmRecentCache, NULL) != SQLITE_OK)
+    fprintf(stderr, "Erreur chargement fenêtre récente : %s\n", sqlite3_errmsg(db));
+
+  config_resolve_path(&app_config, app_config.query.socket_path, socket_path, sizeof(socket_path));
+  config_resolve_path(&app_config, app_config.archive.dir, archive_dir, sizeof(archive_dir));
+  return query_server_start(socket_path, app_config.archive.enabled ? archive_dir : NULL);
+}
+
+// Trames publiées poussées aux tableaux de bord locaux
+static int startFanoutService(void)
+{
+  char socket_path[1024];
+
+  config_resolve_path(&app_config, app_config.fanout.socket_path, socket_path, sizeof(socket_path));
+  return fanout_server_start(socket_path, app_config.fanout.max_clients, app_config.fanout.client_queue);
+}
+
+/*
+ * Une connexion par worker. Avec plusieurs workers : MQTT v5 (abonnements
+ * partagés), identifiants <client_id>-<n> ; la première connexion sert aussi
+ * aux republications (mqtt_client).
+ */
+static int connectBroker(void)
+{
+  int shared = (ingest_worker_count > 1);
+
+  for (int i = 0; i < ingest_worker_count; i++)
+  {
+    IngestWorker *worker = &ingest_workers[i];
+    MQTTAsync_createOptions create_opts = MQTTAsync_createOptions_initializer;
+    MQTTAsync_connectOptions conn_opts = MQTTAsync_connectOptions_initializer;
+    char client_id[96];
+
+    if (shared)
+    {
+      snprintf(client_id, sizeof(client_id), "%s-%d", app_config.mqtt.client_id, i);
+      create_opts.MQTTVersion = MQTTVERSION_5;
+      conn_opts = (MQTTAsync_connectOptions)MQTTAsync_connectOptions_initializer5;
+      conn_opts.cleanstart = 1;
+    }
+    else
+    {
+      snprintf(client_id, sizeof(client_id), "%s", app_config.mqtt.client_id);
+      conn_opts.cleansession = 1;
+    }
+
+    if (MQTTAsync_createWithOptions(&worker->client, app_config.mqtt.broker_address, client_id,
+                                    MQTTCLIENT_PERSISTENCE_NONE, NULL, &create_opts) != MQTTASYNC_SUCCESS)
+      return -1;
+    if (i == 0)
+      mqtt_client = worker->client;
+
+    MQTTAsync_setCallbacks(worker->client, worker, connectionLost, messageArrived, NULL);
+    MQTTAsync_setConnected(worker->client, worker, connected);
+
+    conn_opts.keepAliveInterval = app_config.mqtt.keepalive_interval;
+    conn_opts.maxInflight = app_config.mqtt.max_inflight;
+    conn_opts.automaticReconnect = 1;
+    conn_opts.onFailure = onConnectFailure;
+
+    if (MQTTAsync_connect(worker->client, &conn_opts) != MQTTASYNC_SUCCESS)
+      return -1;
+  }
+
+  for (int i = 0; i < ingest_worker_count; i++)
+  {
+    while (!atomic_load(&ingest_workers[i].connected))
+    {
+      if (atomic_load(&connect_state) < 0)
+        return -1;
+      usleep(10 * 1000);
+    }
+  }
+
+  return 0;
+}
+
+static void disconnectBroker(void)
+{
+  MQTTAsync_disconnectOptions disc_opts = MQTTAsync_disconnectOptions_initializer;
+  disc_opts.timeout = 10000;
+
+  for (int i = 0; i < ingest_worker_count; i++)
+  {
+    if (!ingest_workers[i].client)
+      continue;
+    MQTTAsync_disconnect(ingest_workers[i].client, &disc_opts);
+    MQTTAsync_destroy(&ingest_workers[i].client);
+  }
+  mqtt_client = NULL;
+}
+
+// Instantané des métriques : JSON retenu sur le topic de stats, fichier Prometheus
+static void exportStats(MetricsSnapshot *previous)
+{
+  static MetricsSnapshot snap;
+  static char json[4096];
+  RingStats queue, backfill;
+  FanoutStats fanout;
+
+  metrics_snapshot(&snap);
+  ingestQueueStats(&queue);
+  backfillQueueStats(&backfill);
+  fanout_stats(&fanout);
+
+  metrics_add_gauge(&snap, "queue_depth", "Messages en attente dans la file d'ingestion", (double)queue.depth);
+  metrics_add_gauge(&snap, "queue_high_water", "Pic de la file d'ingestion", (double)queue.high_water);
+  metrics_add_gauge(&snap, "queue_received", "Messages MQTT reçus", (double)queue.pushed);
+  metrics_add_gauge(&snap, "queue_dropped", "Messages perdus, file pleine", (double)queue.dropped);
+  metrics_add_gauge(&snap, "backfill_depth", "Messages en attente dans la file de rattrapage", (double)backfill.depth);
+  metrics_add_gauge(&snap, "backfill_dropped", "Messages de rattrapage perdus, file pleine", (double)backfill.dropped);
+  metrics_add_gauge(&snap, "republish_inflight", "Republications QoS 1 non acquittées",
+                    (double)atomic_load(&republish_inflight));
+  metrics_add_gauge(&snap, "republish_dropped", "Republications abandonnées, fenêtre pleine",
+                    (double)atomic_load(&republish_dropped));
+  metrics_add_gauge(&snap, "devices", "Appareils connus", (double)devices_count());
+  if (app_config.fanout.enabled)
+  {
+    metrics_add_gauge(&snap, "fanout_clients", "Lecteurs de la diffusion locale", (double)fanout.clients);
+    metrics_add_gauge(&snap, "fanout_frames", "Trames diffusées localement", (double)fanout.frames);
+    metrics_add_gauge(&snap, "fanout_dropped", "Trames perdues par les lecteurs lents", (double)fanout.dropped);
+  }
+
+  int len = metrics_format_json(&snap, previous, json, sizeof(json));
+  if (len > 0 && app_config.stats.topic[0])
+  {
+    fanout_publish(app_config.stats.topic, json, (size_t)len, 1);
+
+    // QoS 0 retenu, hors fenêtre de republication : un abonné récupère le dernier état
+    MQTTAsync_message msg = MQTTAsync_message_initializer;
+    msg.payload = json;
+    msg.payloadlen = len;
+    msg.qos = 0;
+    msg.retained = 1;
+    MQTTAsync_sendMessage(mqtt_client, app_config.stats.topic, &msg, NULL);
+  }
+
+  if (app_config.stats.prometheus_file[0])
+  {
+    char prom_path[1024];
+    config_resolve_path(&app_config, app_config.stats.prometheus_file, prom_path, sizeof(prom_path));
+    if (metrics_write_prometheus(&snap, prom_path) != 0)
+      fprintf(stderr, "Erreur écriture %s\n", prom_path);
+  }
+
+  *previous = snap;
+}
+
+static void handleSignal(int sig)
+{
+  (void)sig;
+  keep_running = 0;
+}
+
+// ===== MAIN =====
+
+int main(int argc, char *argv[])
+{
+  printf("\n=== Subscriber MQTT ===\n");
+
+  const char *config_file = (argc > 1) ? argv[1] : "config.toml";
+
+  if (config_load(&app_config, config_file) != 0)
+  {
+    fprintf(stderr, "Erreur : impossible de charger %s\n", config_file);
+    exit(EXIT_FAILURE);
+  }
+
+  config_display(&app_config);
+
+  char current_time[64];
+  getUTCTimestamp(current_time, sizeof(current_time));
+  printf("Heure système UTC : %s\n\n", current_time);
+
+  metrics_init();
+
+  if (initDatabase(&app_config) != SQLITE_OK)
+  {
+    exit(EXIT_FAILURE);
+  }
+
+  // Service facultatif : le serveur tourne sans lui
+  if (app_config.query.enabled && startQueryService() != 0)
+  {
+    fprintf(stderr, "Service de requêtes indisponible\n");
+  }
+
+  if (app_config.fanout.enabled && startFanoutService() != 0)
+  {
+    fprintf(stderr, "Diffusion locale indisponible\n");
+  }
+
+  if (startIngestWorkers(app_config.queue.workers) != 0 ||
+      startStorageWriter() != 0)
+  {
+    fprintf(stderr, "Erreur initialisation file d'écriture\n");
+    stopIngestWorkers();
+    query_server_stop();
+    fanout_server_stop();
+    closeDatabase();
+    closeIngestWorkers();
+    exit(EXIT_FAILURE);
+  }
+
+  if (connectBroker() != 0)
+  {
+    printf("Échec connexion broker\n");
+    disconnectBroker();
+    stopIngestWorkers();
+    stopStorageWriter();
+    query_server_stop();
+    fanout_server_stop();
+    closeDatabase();
+    closeIngestWorkers();
+    exit(EXIT_FAILURE);
+  }
+
+  printf("En attente des données ESP32...\n");
+
+  struct sigaction sa = {0};
+  sa.sa_handler = handleSignal;
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+
+  uint64_t last_dropped = 0;
+  int elapsed_s = 0;
+  int stats_elapsed_s = 0;
+  static MetricsSnapshot previous_stats;
+
+  while (keep_running)
+  {
+    sleep(1);
+
+    if (app_config.stats.enabled && app_config.stats.interval > 0 &&
+        ++stats_elapsed_s >= app_config.stats.interval)
+    {
+      exportStats(&previous_stats);
+      stats_elapsed_s = 0;
+    }
+
+    if (app_config.queue.stats_interval <= 0 || ++elapsed_s < app_config.queue.stats_interval)
+      continue;
+    elapsed_s = 0;
+
+    // Compteurs affichés si le thread d'écriture décroche
+    RingStats stats;
+    ingestQueueStats(&stats);
+    if (stats.dropped != last_dropped || app_config.logging.display_messages)
+    {
+      displayQueueStats();
+      last_dropped = stats.dropped;
+    }
+  }
+
+  printf("\nArrêt demandé, écriture des données en attente...\n");
+
+  // Le thread d'écriture republie encore en vidant les files : déconnexion après
+  stopIngestWorkers();
+  stopStorageWriter();
+
+  disconnectBroker();
+  query_server_stop();
+  fanout_server_stop();
+  recent_cache_close();
+  closeDatabase();
+  displayQueueStats();
+  closeIngestWorkers();
+
+  return 0;
+}
+
+#endif // SUBSCRIBER_NO_MAIN
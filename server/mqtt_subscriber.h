@@ -7,20 +7,59 @@
 #include <time.h>
 #include <math.h>
 #include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
 #include <sys/stat.h>
-#include <MQTTClient.h>
+#include <MQTTAsync.h>
 #include <json-c/json.h>
 #include <sqlite3.h>
+#include <stdint.h>
+#include <stdatomic.h>
 #include "config.h"
+#include "schema.h"
+#include "partitions.h"
+#include "devices.h"
+#include "compression.h"
+#include "window_stats.h"
+#include "alerts.h"
+#include "conflation.h"
+#include "rollup.h"
+#include "archive.h"
+#include "recent_cache.h"
+#include "query_server.h"
+#include "fanout_server.h"
+#include "metrics.h"
+#include "ring_buffer.h"
+#include "payload.h"
+#include "sensor_packet.h"
+
+#define RETENTION_CHECK_MS 60000
+#define MAX_INGEST_WORKERS 16
+
+/**
+ * @brief Mesure parsée, transmise d'un worker au thread d'écriture
+ */
+typedef struct
+{
+  int64_t timestamp_ms; // réception - ancienneté de la mesure
+  SensorSample sample;
+} IngestRow;
 
 // ===== VARIABLES GLOBALES =====
 extern sqlite3 *db;
-extern sqlite3_stmt *insert_stmt;
 extern Config app_config;
-extern MQTTClient mqtt_client;
+extern MQTTAsync mqtt_client;
 
 // ===== DATE UTC =====
 
+/**
+ * @brief Formate un instant en timestamp UTC lisible
+ * @param epoch_ms Instant à formater (epoch UTC en millisecondes)
+ * @param buffer Buffer pour stocker le timestamp
+ * @param size Taille du buffer
+ */
+void formatUTCTimestamp(int64_t epoch_ms, char *buffer, size_t size);
+
 /**
  * @brief Récupère le timestamp UTC formaté
  * @param buffer Buffer pour stocker le timestamp
@@ -28,6 +67,18 @@ extern MQTTClient mqtt_client;
  */
 void getUTCTimestamp(char *buffer, size_t size);
 
+/**
+ * @brief Récupère l'instant courant (format de stockage des mesures)
+ * @return Epoch UTC en millisecondes
+ */
+int64_t getEpochMillis(void);
+
+/**
+ * @brief Récupère un temps monotone en millisecondes (mesure de durées)
+ * @return Millisecondes écoulées depuis une origine arbitraire
+ */
+long long getMonotonicMillis(void);
+
 // ===== BASE DE DONNÉES =====
 
 /**
@@ -38,51 +89,177 @@ void getUTCTimestamp(char *buffer, size_t size);
 int initDatabase(const Config *cfg);
 
 /**
- * @brief Insère des données dans la base de données
- * @param timestamp Timestamp de l'envoi des données
+ * @brief Insère des données de l'appareil 0 dans la transaction groupée courante
+ *
+ * La ligne est écrite dans la partition temporelle de timestamp_ms.
+ * Les lignes sont accumulées dans une transaction ouverte au premier insert,
+ * validée dès que database.batch_size lignes sont en attente. La validation
+ * sur délai (database.batch_timeout_ms) est assurée par flushExpiredBatch().
+ *
+ * @param timestamp_ms Instant de réception (epoch UTC en millisecondes)
  * @param temp Température
  * @param press Pression
  * @param hum Humidité
  * @return SQLITE_OK si succès, code d'erreur sinon
  */
-int insertData(const char *timestamp, double temp, double press, double hum);
+int insertData(int64_t timestamp_ms, double temp, double press, double hum);
 
 /**
- * @brief Ferme proprement la base de données et libère les statements
+ * @brief Comme insertData, pour une mesure parsée (appareil sample->device_id)
+ *
+ * Résumé d'appareil (sample->readings > 0) : la moyenne est stockée, les
+ * extrêmes de l'intervalle alimentent min et max des agrégats.
+ *
+ * @param timestamp_ms Instant de la mesure (epoch UTC en millisecondes)
+ * @param sample Mesure
+ * @return SQLITE_OK si succès, code d'erreur sinon
+ */
+int insertSample(int64_t timestamp_ms, const SensorSample *sample);
+
+/**
+ * @brief Valide la transaction groupée en cours, s'il y en a une
+ * @return SQLITE_OK si succès, code d'erreur sinon
+ */
+int commitPendingData(void);
+
+/**
+ * @brief Valide la transaction groupée si elle est ouverte depuis plus de batch_timeout_ms
+ * @return SQLITE_OK si succès, code d'erreur sinon
+ */
+int flushExpiredBatch(void);
+
+/**
+ * @brief Délai restant avant la validation sur délai du lot en cours
+ * @return Millisecondes restantes, -1 si aucune transaction n'est ouverte
+ */
+int batchRemainingMillis(void);
+
+/**
+ * @brief Supprime les partitions sorties de database.retention_hours et purge les agrégats
+ *
+ * Appelée par le thread d'écriture toutes les RETENTION_CHECK_MS ; chaque
+ * suppression est journalisée dans logging.cleanup_log.
+ *
+ * @return Nombre de partitions supprimées, -1 en cas d'erreur
+ */
+int applyRetention(void);
+
+/**
+ * @brief Valide les lignes en attente, ferme la base de données et libère les statements
  */
 void closeDatabase(void);
 
 // ===== JSON =====
 
 /**
- * @brief Parse le JSON et stocke les données
- * @param cfg Configuration
- * @param jsonString Chaîne JSON à parser
+ * @brief Parse le payload, une mesure ou un lot (compteurs et latence de parsing mis à jour)
+ * @param payload Payload MQTT (non terminé par '\0')
+ * @param len Longueur du payload
+ * @param device Appareil déduit du topic, -1 pour garder celui du payload
+ * @param samples Mesures lues
+ * @param max Capacité de samples
+ * @return Nombre de mesures, -1 en cas d'erreur
+ */
+int parseSamples(const char *payload, size_t len, int device, SensorSample *samples, int max);
+
+/**
+ * @brief Stocke une mesure parsée puis la republie (thread d'écriture uniquement)
+ * @param timestamp_ms Instant de la mesure : réception - sample->age_ms (epoch UTC en millisecondes)
+ * @param sample Mesure
+ * @return SQLITE_OK si succès, code d'erreur sinon
+ */
+int storeSample(int64_t timestamp_ms, const SensorSample *sample);
+
+/**
+ * @brief Stocke une mesure de rattrapage, sans la republier (thread d'écriture uniquement)
+ *
+ * Les mesures déjà hors de la rétention sont écartées (comptées).
+ *
+ * @param timestamp_ms Instant de la mesure, daté par l'appareil
+ * @param sample Mesure
+ * @return SQLITE_OK si succès ou mesure écartée, code d'erreur sinon
+ */
+int storeBackfillSample(int64_t timestamp_ms, const SensorSample *sample);
+
+/**
+ * @brief Parse le payload (une mesure ou un lot) et stocke les données
+ * @param payload Payload MQTT (non terminé par '\0')
+ * @param len Longueur du payload
+ * @param device Appareil déduit du topic, -1 pour garder celui du payload
+ * @param received_ms Instant de réception du message (epoch UTC en millisecondes)
  * @return 0 si succès, -1 en cas d'erreur
  */
-int parseAndStore(const char *jsonString);
+int parseAndStore(const char *payload, size_t len, int device, int64_t received_ms);
 
 /**
  * @brief Republie les données enrichies avec timestamp sur un nouveau topic
+ *
+ * Publication asynchrone QoS 1 : au-delà de mqtt.max_inflight messages non
+ * acquittés, la republication est abandonnée (comptée) sans bloquer. Un '+'
+ * dans mqtt.topic_republish est remplacé par le nom de l'appareil (sa clé
+ * s'il n'a pas de nom).
+ *
+ * @param device Appareil
  * @param temp Température
  * @param press Pression
  * @param hum Humidité
  * @param timestamp Timestamp généré par le serveur
  * @return 0 si succès, -1 en cas d'erreur
  */
-int republishWithTimestamp(const char *timestamp, double temp, double press, double hum);
+int republishWithTimestamp(int device, const char *timestamp, double temp, double press, double hum);
+
+/**
+ * @brief Transmet la dernière mesure d'un appareil (ConflationPublishCallback)
+ *
+ * En mode conflate, republication sur mqtt.topic_republish ; si
+ * republish.snapshot_topic est défini, publication retenue QoS 1 : un client
+ * qui s'abonne reçoit aussitôt l'état courant de chaque appareil.
+ *
+ * @return 0 si succès, -1 si une publication doit être retentée
+ */
+int publishLatest(void *ctx, int device, int64_t ts_ms, const double value[CONFLATION_METRICS]);
+
+/**
+ * @brief Publie les fenêtres glissantes des appareils mis à jour
+ *
+ * Appelé par le thread d'écriture après chaque lecture des files : une rafale
+ * de mesures d'un appareil donne une seule publication. QoS 0, non retenue ;
+ * un '+' dans window.topic est remplacé par le nom de l'appareil.
+ *
+ * @return Nombre de publications
+ */
+int publishWindowStats(void);
+
+/**
+ * @brief Publie un événement d'alerte (AlertCallback)
+ *
+ * QoS 1, non retenu, sur alerts.topic ('+' remplacé par le nom de
+ * l'appareil). Hors de la fenêtre de republication : une alerte n'est
+ * jamais abandonnée faute d'acquittements.
+ *
+ * @param ctx Inutilisé
+ * @param event Levée ou retombée d'une règle
+ */
+void publishAlert(void *ctx, const AlertEvent *event);
 
 // ===== MQTT =====
 
 /**
  * @brief Callback appelé lors de la réception d'un message MQTT
- * @param context Contexte utilisateur
+ *
+ * Copie le payload dans la file d'entrée du worker de la connexion (file de
+ * rattrapage pour mqtt.backfill_topic) et rend la main immédiatement ; si la
+ * file est pleine, le message est compté comme perdu. Si le topic abonné
+ * contient un '+', le niveau correspondant est le nom de l'appareil, interné
+ * en clé entière (devices.h).
+ *
+ * @param context Worker de la connexion
  * @param topicName Nom du topic
  * @param topicLen Longueur du nom du topic
  * @param message Message MQTT reçu
  * @return 1 si traité avec succès
  */
-int messageArrived(void *context, char *topicName, int topicLen, MQTTClient_message *message);
+int messageArrived(void *context, char *topicName, int topicLen, MQTTAsync_message *message);
 
 /**
  * @brief Callback appelé lors de la perte de connexion MQTT
@@ -91,4 +268,74 @@ int messageArrived(void *context, char *topicName, int topicLen, MQTTClient_mess
  */
 void connectionLost(void *context, char *cause);
 
+/**
+ * @brief Callback appelé à chaque connexion au broker (y compris reconnexion automatique)
+ *
+ * Abonne la connexion à mqtt.topic, ou à $share/<share_group>/<topic> avec plusieurs workers.
+ * La première connexion s'abonne aussi à mqtt.backfill_topic.
+ *
+ * @param context Worker de la connexion
+ * @param cause Cause de la connexion
+ */
+void connected(void *context, char *cause);
+
+// ===== WORKERS D'INGESTION =====
+
+/**
+ * @brief Alloue les files d'entrée et démarre les threads de parsing
+ *
+ * Un worker par connexion MQTT. Avec un seul worker, pas de thread : le
+ * thread d'écriture parse lui-même les messages de la file d'entrée.
+ *
+ * @param count Nombre de workers (borné à MAX_INGEST_WORKERS)
+ * @return 0 si succès, -1 en cas d'erreur
+ */
+int startIngestWorkers(int count);
+
+/**
+ * @brief Vide les files d'entrée et arrête les threads de parsing
+ */
+void stopIngestWorkers(void);
+
+/**
+ * @brief Libère les files des workers
+ */
+void closeIngestWorkers(void);
+
+/**
+ * @brief Additionne les compteurs des files d'entrée de tous les workers
+ * @param total Structure à remplir
+ */
+void ingestQueueStats(RingStats *total);
+
+/**
+ * @brief Compteurs de la file de rattrapage
+ * @param stats Structure à remplir (à zéro si le rattrapage est désactivé)
+ */
+void backfillQueueStats(RingStats *stats);
+
+// ===== THREAD D'ÉCRITURE =====
+
+/**
+ * @brief Démarre le thread d'écriture, seul propriétaire de db
+ *
+ * À appeler après startIngestWorkers : il lit leurs files. Les files en
+ * direct sont vidées d'abord, puis au plus queue.backfill_burst messages de
+ * rattrapage par tour : une rafale de rattrapage ne retarde le direct que
+ * d'un tour.
+ *
+ * @return 0 si succès, -1 en cas d'erreur
+ */
+int startStorageWriter(void);
+
+/**
+ * @brief Vide la file, valide le dernier lot et arrête le thread d'écriture
+ */
+void stopStorageWriter(void);
+
+/**
+ * @brief Affiche les compteurs de contre-pression de la file (profondeur, pic, pertes)
+ */
+void displayQueueStats(void);
+
 #endif // MQTT_SUBSCRIBER_H
@@ -0,0 +1,424 @@
+#include "partitions.h"
+#include "schema.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct
+{
+  int64_t start_ms;
+  char name[PARTITION_NAME_SIZE];
+  sqlite3_stmt *stmt;
+} PartitionEntry;
+
+static sqlite3 *pdb = NULL;
+static int64_t period_ms = 3600 * 1000LL;
+static int compact_values = 0;
+static PartitionEntry cache[PARTITION_CACHE_SIZE];
+static int cache_next = 0;
+
+static int execSql(const char *sql)
+{
+  char *errMsg = NULL;
+  int rc = sqlite3_exec(pdb, sql, NULL, NULL, &errMsg);
+  if (rc != SQLITE_OK)
+  {
+    fprintf(stderr, "Erreur partitions : %s\n", errMsg ? errMsg : sqlite3_errmsg(pdb));
+    sqlite3_free(errMsg);
+  }
+  return rc;
+}
+
+// mesures_AAAAMMJJHH pour une heure, mesures_AAAAMMJJHH_<n>h sinon : un changement de
+// partition_hours ne réutilise jamais le nom (ni la période recensée) d'une partition existante
+static void partitionName(int64_t start_ms, char *name, size_t size)
+{
+  time_t t = (time_t)(start_ms / 1000);
+  struct tm utc_time;
+  gmtime_r(&t, &utc_time);
+  size_t len = strftime(name, size, "mesures_%Y%m%d%H", &utc_time);
+
+  int hours = (int)(period_ms / (3600 * 1000));
+  if (hours != 1 && len > 0)
+    snprintf(name + len, size - len, "_%dh", hours);
+}
+
+// Colonnes lues d'une partition, valeurs ramenées en unités
+static const char *selectColumns(int scale)
+{
+  if (scale == MESURES_COMPACT_SCALE)
+    return "device, ts, temperature / 10.0 AS temperature, pression / 10.0 AS pression, "
+           "humidite / 10.0 AS humidite";
+
+  return "device, ts, temperature, pression, humidite";
+}
+
+int partitions_scale(sqlite3 *db, const char *name)
+{
+  sqlite3_stmt *stmt = NULL;
+  int scale = 1;
+
+  if (sqlite3_prepare_v2(db, "SELECT scale FROM mesures_partitions WHERE name = ?;", -1, &stmt, NULL) == SQLITE_OK)
+  {
+    sqlite3_bind_text(stmt, 1, name, -1, SQLITE_STATIC);
+    if (sqlite3_step(stmt) == SQLITE_ROW)
+      scale = sqlite3_column_int(stmt, 0);
+  }
+  sqlite3_finalize(stmt);
+
+  return (scale == MESURES_COMPACT_SCALE) ? scale : 1;
+}
+
+// Recrée la vue mesures : UNION ALL des PARTITIONS_VIEW_MAX partitions les plus récentes
+static int rebuildView(void)
+{
+  sqlite3_stmt *stmt = NULL;
+  size_t cap = 256, len = 0;
+  char *sql = sqlite3_malloc64(cap);
+  int rc;
+
+  if (!sql)
+    return SQLITE_NOMEM;
+
+  len = (size_t)snprintf(sql, cap, "CREATE VIEW mesures AS ");
+
+  // SQLite refuse un SELECT composé de plus de 500 termes
+  rc = sqlite3_prepare_v2(pdb,
+                          "SELECT name, scale FROM (SELECT name, scale, start_ms FROM mesures_partitions "
+                          "ORDER BY start_ms DESC LIMIT ?) ORDER BY start_ms;",
+                          -1, &stmt, NULL);
+  if (rc == SQLITE_OK)
+    sqlite3_bind_int(stmt, 1, PARTITIONS_VIEW_MAX);
+  int count = 0;
+  while (rc == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    const char *name = (const char *)sqlite3_column_text(stmt, 0);
+    const char *columns = selectColumns(sqlite3_column_int(stmt, 1));
+    size_t need = len + strlen(name) + strlen(columns) + 32;
+    if (need > cap)
+    {
+      cap = need * 2;
+      char *grown = sqlite3_realloc64(sql, cap);
+      if (!grown)
+      {
+        rc = SQLITE_NOMEM;
+        break;
+      }
+      sql = grown;
+    }
+    len += (size_t)snprintf(sql + len, cap - len, "%sSELECT %s FROM %s",
+                            count++ ? " UNION ALL " : "", columns, name);
+  }
+  sqlite3_finalize(stmt);
+
+  if (rc == SQLITE_OK && count == 0)
+  {
+    snprintf(sql + len, cap - len,
+             "SELECT 0 AS device, 0 AS ts, NULL AS temperature, NULL AS pression, NULL AS humidite WHERE 0");
+  }
+
+  if (rc == SQLITE_OK)
+    rc = execSql("DROP VIEW IF EXISTS mesures;");
+  if (rc == SQLITE_OK)
+    rc = execSql(sql);
+
+  sqlite3_free(sql);
+  return rc;
+}
+
+// Une ancienne table mesures (avant partitionnement) devient une partition comme les autres
+static int adoptLegacyTable(void)
+{
+  sqlite3_stmt *stmt = NULL;
+  int is_table = 0;
+
+  if (sqlite3_prepare_v2(pdb, "SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = 'mesures';",
+                         -1, &stmt, NULL) == SQLITE_OK)
+  {
+    is_table = (sqlite3_step(stmt) == SQLITE_ROW);
+  }
+  sqlite3_finalize(stmt);
+
+  if (!is_table)
+    return SQLITE_OK;
+
+  printf("Table mesures non partitionnée : renommée en mesures_legacy\n");
+
+  int rc = execSql("ALTER TABLE mesures RENAME TO mesures_legacy;");
+  if (rc == SQLITE_OK)
+  {
+    rc = execSql("INSERT OR REPLACE INTO mesures_partitions (name, start_ms, end_ms) "
+                 "SELECT 'mesures_legacy', coalesce(min(ts), 0), coalesce(max(ts) + 1, 0) FROM mesures_legacy;");
+  }
+  return rc;
+}
+
+// Catalogue antérieur aux partitions compactes : toutes ses partitions sont en REAL
+static int addScaleColumn(void)
+{
+  sqlite3_stmt *stmt = NULL;
+  int has_scale = 0;
+
+  if (sqlite3_prepare_v2(pdb, "SELECT 1 FROM pragma_table_info('mesures_partitions') WHERE name = 'scale';",
+                         -1, &stmt, NULL) == SQLITE_OK)
+  {
+    has_scale = (sqlite3_step(stmt) == SQLITE_ROW);
+  }
+  sqlite3_finalize(stmt);
+
+  if (has_scale)
+    return SQLITE_OK;
+
+  return execSql("ALTER TABLE mesures_partitions ADD COLUMN scale INTEGER NOT NULL DEFAULT 1;");
+}
+
+int partitions_init(sqlite3 *db, int period_hours, int compact)
+{
+  pdb = db;
+  compact_values = compact;
+  period_ms = (int64_t)(period_hours > 0 ? period_hours : 1) * 3600 * 1000;
+  memset(cache, 0, sizeof(cache));
+  cache_next = 0;
+
+  int rc = execSql("BEGIN;");
+  if (rc == SQLITE_OK)
+    rc = execSql("CREATE TABLE IF NOT EXISTS mesures_partitions ("
+                 "name TEXT PRIMARY KEY,"
+                 "start_ms INTEGER NOT NULL,"
+                 "end_ms INTEGER NOT NULL,"
+                 "scale INTEGER NOT NULL DEFAULT 1"
+                 ");");
+  if (rc == SQLITE_OK)
+    rc = addScaleColumn();
+  if (rc == SQLITE_OK)
+    rc = adoptLegacyTable();
+  if (rc == SQLITE_OK)
+    rc = rebuildView();
+
+  sqlite3_stmt *stmt = NULL;
+  if (rc == SQLITE_OK &&
+      sqlite3_prepare_v2(pdb, "SELECT count(*) FROM mesures_partitions;", -1, &stmt, NULL) == SQLITE_OK &&
+      sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_int(stmt, 0) > PARTITIONS_VIEW_MAX)
+  {
+    printf("Vue mesures limitée aux %d partitions les plus récentes (%d recensées) : "
+           "partitions_query_range() lit toutes les partitions\n",
+           PARTITIONS_VIEW_MAX, sqlite3_column_int(stmt, 0));
+  }
+  sqlite3_finalize(stmt);
+
+  if (rc == SQLITE_OK)
+    return execSql("COMMIT;");
+
+  execSql("ROLLBACK;");
+  return rc;
+}
+
+static int createPartition(int64_t start_ms, const char *name)
+{
+  char sql[512];
+  snprintf(sql, sizeof(sql), "CREATE TABLE IF NOT EXISTS %s %s;", name,
+           compact_values ? MESURES_COMPACT_COLUMNS_SQL : MESURES_COLUMNS_SQL);
+
+  int rc = execSql(sql);
+  if (rc != SQLITE_OK)
+    return rc;
+
+  // Partition déjà recensée : son échelle d'origine est conservée
+  sqlite3_stmt *stmt = NULL;
+  rc = sqlite3_prepare_v2(pdb,
+                          "INSERT OR IGNORE INTO mesures_partitions (name, start_ms, end_ms, scale) "
+                          "VALUES (?, ?, ?, ?);",
+                          -1, &stmt, NULL);
+  if (rc != SQLITE_OK)
+    return rc;
+
+  sqlite3_bind_text(stmt, 1, name, -1, SQLITE_STATIC);
+  sqlite3_bind_int64(stmt, 2, start_ms);
+  sqlite3_bind_int64(stmt, 3, start_ms + period_ms);
+  sqlite3_bind_int(stmt, 4, compact_values ? MESURES_COMPACT_SCALE : 1);
+  rc = sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+
+  if (rc != SQLITE_DONE)
+    return SQLITE_ERROR;
+
+  // Nouvelle partition : la vue doit l'inclure
+  if (sqlite3_changes(pdb) > 0)
+    return rebuildView();
+
+  return SQLITE_OK;
+}
+
+sqlite3_stmt *partitions_insert_stmt(int64_t ts_ms)
+{
+  int64_t start_ms = ts_ms - (ts_ms % period_ms);
+
+  for (int i = 0; i < PARTITION_CACHE_SIZE; i++)
+  {
+    if (cache[i].stmt && cache[i].start_ms == start_ms)
+      return cache[i].stmt;
+  }
+
+  PartitionEntry *entry = &cache[cache_next];
+  cache_next = (cache_next + 1) % PARTITION_CACHE_SIZE;
+
+  sqlite3_finalize(entry->stmt);
+  entry->stmt = NULL;
+  entry->start_ms = start_ms;
+  partitionName(start_ms, entry->name, sizeof(entry->name));
+
+  if (createPartition(start_ms, entry->name) != SQLITE_OK)
+    return NULL;
+
+  // Partition compacte : arrondi au dixième, stocké en entier (affinité INTEGER)
+  char sql[256];
+  if (partitions_scale(pdb, entry->name) == MESURES_COMPACT_SCALE)
+  {
+    snprintf(sql, sizeof(sql),
+             "INSERT OR REPLACE INTO %s (device, ts, temperature, pression, humidite) "
+             "VALUES (?1, ?2, round(?3 * 10), round(?4 * 10), round(?5 * 10));",
+             entry->name);
+  }
+  else
+  {
+    snprintf(sql, sizeof(sql),
+             "INSERT OR REPLACE INTO %s (device, ts, temperature, pression, humidite) VALUES (?, ?, ?, ?, ?);",
+             entry->name);
+  }
+
+  if (sqlite3_prepare_v2(pdb, sql, -1, &entry->stmt, NULL) != SQLITE_OK)
+  {
+    fprintf(stderr, "Erreur préparation insert %s : %s\n", entry->name, sqlite3_errmsg(pdb));
+    entry->stmt = NULL;
+    return NULL;
+  }
+
+  return entry->stmt;
+}
+
+static void evictFromCache(const char *name)
+{
+  for (int i = 0; i < PARTITION_CACHE_SIZE; i++)
+  {
+    if (cache[i].stmt && strcmp(cache[i].name, name) == 0)
+    {
+      sqlite3_finalize(cache[i].stmt);
+      cache[i].stmt = NULL;
+    }
+  }
+}
+
+int partitions_drop_expired(int64_t cutoff_ms, int (*on_drop)(void *ctx, const char *name), void *ctx)
+{
+  char names[64][PARTITION_NAME_SIZE];
+  int count = 0;
+  sqlite3_stmt *stmt = NULL;
+
+  if (sqlite3_prepare_v2(pdb, "SELECT name FROM mesures_partitions WHERE end_ms <= ? ORDER BY start_ms LIMIT 64;",
+                         -1, &stmt, NULL) != SQLITE_OK)
+    return -1;
+
+  sqlite3_bind_int64(stmt, 1, cutoff_ms);
+  while (sqlite3_step(stmt) == SQLITE_ROW && count < 64)
+  {
+    snprintf(names[count++], PARTITION_NAME_SIZE, "%s", (const char *)sqlite3_column_text(stmt, 0));
+  }
+  sqlite3_finalize(stmt);
+
+  if (count == 0)
+    return 0;
+
+  if (execSql("BEGIN IMMEDIATE;") != SQLITE_OK)
+    return -1;
+
+  int rc = SQLITE_OK;
+  int dropped = 0;
+  for (int i = 0; i < count && rc == SQLITE_OK; i++)
+  {
+    if (on_drop && on_drop(ctx, names[i]) != 0)
+      continue;
+
+    evictFromCache(names[i]);
+
+    char *sql = sqlite3_mprintf("DROP TABLE IF EXISTS \"%w\";"
+                                "DELETE FROM mesures_partitions WHERE name = %Q;",
+                                names[i], names[i]);
+    rc = sql ? execSql(sql) : SQLITE_NOMEM;
+    sqlite3_free(sql);
+    dropped++;
+  }
+
+  if (rc == SQLITE_OK && dropped > 0)
+    rc = rebuildView();
+
+  if (rc != SQLITE_OK || execSql("COMMIT;") != SQLITE_OK)
+  {
+    execSql("ROLLBACK;");
+    return -1;
+  }
+
+  return dropped;
+}
+
+int partitions_query_range(sqlite3 *db, int device, int64_t from_ms, int64_t to_ms,
+                           PartitionRowCallback cb, void *ctx)
+{
+  sqlite3_stmt *list = NULL;
+  int rc = sqlite3_prepare_v2(db,
+                              "SELECT name, scale FROM mesures_partitions "
+                              "WHERE end_ms > ?1 AND start_ms < ?2 ORDER BY start_ms;",
+                              -1, &list, NULL);
+  if (rc != SQLITE_OK)
+    return rc;
+
+  sqlite3_bind_int64(list, 1, from_ms);
+  sqlite3_bind_int64(list, 2, to_ms);
+
+  int stop = 0;
+  while (!stop && sqlite3_step(list) == SQLITE_ROW)
+  {
+    char sql[384];
+    sqlite3_stmt *rows = NULL;
+
+    // Appareil fixé : recherche sur la clé primaire (device, ts)
+    snprintf(sql, sizeof(sql),
+             "SELECT %s FROM %s "
+             "WHERE %s ts >= ?2 AND ts < ?3 ORDER BY device, ts;",
+             selectColumns(sqlite3_column_int(list, 1)), (const char *)sqlite3_column_text(list, 0),
+             (device >= 0) ? "device = ?1 AND" : "");
+
+    rc = sqlite3_prepare_v2(db, sql, -1, &rows, NULL);
+    if (rc != SQLITE_OK)
+      break;
+
+    sqlite3_bind_int(rows, 1, device);
+    sqlite3_bind_int64(rows, 2, from_ms);
+    sqlite3_bind_int64(rows, 3, to_ms);
+
+    while (sqlite3_step(rows) == SQLITE_ROW)
+    {
+      if (cb(ctx, sqlite3_column_int(rows, 0), sqlite3_column_int64(rows, 1),
+             sqlite3_column_double(rows, 2), sqlite3_column_double(rows, 3),
+             sqlite3_column_double(rows, 4)) != 0)
+      {
+        stop = 1;
+        break;
+      }
+    }
+    sqlite3_finalize(rows);
+  }
+
+  sqlite3_finalize(list);
+  return rc;
+}
+
+void partitions_close(void)
+{
+  for (int i = 0; i < PARTITION_CACHE_SIZE; i++)
+  {
+    sqlite3_finalize(cache[i].stmt);
+    cache[i].stmt = NULL;
+  }
+  pdb = NULL;
+}
@@ -0,0 +1,93 @@
+#ifndef PARTITIONS_H
+#define PARTITIONS_H
+
+#include <stdint.h>
+#include <sqlite3.h>
+
+#define PARTITION_NAME_SIZE 64
+#define PARTITION_CACHE_SIZE 4
+#define PARTITIONS_VIEW_MAX 480 // SQLite : 500 termes au plus par SELECT composé
+
+// ===== PARTITIONS TEMPORELLES =====
+
+/*
+ * Les mesures sont écrites dans une table par période (mesures_AAAAMMJJHH,
+ * début de période en UTC, suffixe _<n>h si la période n'est pas d'une
+ * heure), recensées dans mesures_partitions. La vue mesures
+ * réunit les PARTITIONS_VIEW_MAX partitions les plus récentes (UNION ALL) pour
+ * les requêtes SQL existantes ; partitions_query_range() les lit toutes.
+ * La rétention supprime des partitions entières : DROP TABLE libère les pages
+ * d'un bloc, réutilisées ensuite par les nouvelles partitions.
+ *
+ * Chaque partition a son échelle dans le catalogue : 1 pour des REAL,
+ * MESURES_COMPACT_SCALE pour des dixièmes entiers (mode compact). Les
+ * partitions des deux sortes coexistent ; la vue et les lectures convertissent.
+ */
+
+/**
+ * @brief Callback de parcours d'une plage de mesures
+ * @param ctx Contexte utilisateur
+ * @return 0 pour continuer, autre valeur pour arrêter le parcours
+ */
+typedef int (*PartitionRowCallback)(void *ctx, int device, int64_t ts_ms,
+                                    double temp, double press, double hum);
+
+/**
+ * @brief Crée le catalogue et la vue mesures, adopte une ancienne table mesures
+ * @param db Base de données ouverte
+ * @param period_hours Largeur d'une partition en heures
+ * @param compact Nouvelles partitions en dixièmes entiers plutôt qu'en REAL
+ * @return SQLITE_OK si succès, code d'erreur sinon
+ */
+int partitions_init(sqlite3 *db, int period_hours, int compact);
+
+/**
+ * @brief Statement d'insertion (device, ts, temperature, pression, humidite) de la partition contenant ts
+ *
+ * Crée la partition si nécessaire. Les valeurs se lient en double quelle que
+ * soit l'échelle de la partition : la conversion est faite par le statement.
+ * Les statements des dernières partitions utilisées sont gardés en cache ;
+ * ils appartiennent au module.
+ *
+ * @param ts_ms Instant de la mesure (epoch UTC en millisecondes)
+ * @return Statement prêt à être lié, NULL en cas d'erreur
+ */
+sqlite3_stmt *partitions_insert_stmt(int64_t ts_ms);
+
+/**
+ * @brief Supprime les partitions entièrement antérieures à cutoff_ms
+ * @param cutoff_ms Limite de rétention (epoch UTC en millisecondes)
+ * @param on_drop Appelé avec le nom de chaque partition avant sa suppression (peut être NULL) ;
+ *                une valeur non nulle conserve la partition pour un prochain passage
+ * @param ctx Contexte passé à on_drop
+ * @return Nombre de partitions supprimées, -1 en cas d'erreur
+ */
+int partitions_drop_expired(int64_t cutoff_ms, int (*on_drop)(void *ctx, const char *name), void *ctx);
+
+/**
+ * @brief Échelle des valeurs d'une partition (diviseur pour revenir aux unités)
+ * @param db Base de données (peut être une autre connexion que celle d'écriture)
+ * @param name Nom de la partition
+ * @return 1 (REAL) ou MESURES_COMPACT_SCALE, 1 si la partition est inconnue
+ */
+int partitions_scale(sqlite3 *db, const char *name);
+
+/**
+ * @brief Parcourt les mesures de [from_ms, to_ms[ en ne lisant que les partitions concernées
+ * @param db Base de données (peut être une autre connexion que celle d'écriture)
+ * @param device Appareil, -1 pour tous
+ * @param from_ms Début de plage inclus
+ * @param to_ms Fin de plage exclue
+ * @param cb Callback appelé pour chaque ligne, par partition puis (device, ts)
+ * @param ctx Contexte passé au callback
+ * @return SQLITE_OK si succès, code d'erreur sinon
+ */
+int partitions_query_range(sqlite3 *db, int device, int64_t from_ms, int64_t to_ms,
+                           PartitionRowCallback cb, void *ctx);
+
+/**
+ * @brief Libère les statements en cache
+ */
+void partitions_close(void);
+
+#endif // PARTITIONS_H
@@ -0,0 +1,624 @@
+#include "payload.h"
+#include "sensor_packet.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+// ===== CHEMIN RAPIDE =====
+
+#define FIELD_TEMPERATURE 0x1
+#define FIELD_PRESSION 0x2
+#define FIELD_HUMIDITE 0x4
+#define FIELDS_ALL (FIELD_TEMPERATURE | FIELD_PRESSION | FIELD_HUMIDITE)
+
+// Puissances de 10 représentables exactement en double
+static const double pow10_exact[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+static const char *skipSpaces(const char *p, const char *end)
+{
+  while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))
+    p++;
+  return p;
+}
+
+static int isDigit(char c)
+{
+  return c >= '0' && c <= '9';
+}
+
+/*
+ * Nombre JSON -> double. Mantisse entière et exposant décimal exacts
+ * (mantisse <= 2^53, |exposant| <= 22) : une seule multiplication ou division
+ * IEEE, donc un arrondi correct identique à strtod. Hors de ce domaine, rejet.
+ */
+static const char *parseNumber(const char *p, const char *end, double *out)
+{
+  int negative = 0;
+  uint64_t mantissa = 0;
+  int digits = 0;
+  int exponent = 0;
+
+  if (p < end && *p == '-')
+  {
+    negative = 1;
+    p++;
+  }
+
+  if (p >= end || !isDigit(*p))
+    return NULL;
+
+  if (*p == '0')
+  {
+    p++;
+  }
+  else
+  {
+    while (p < end && isDigit(*p))
+    {
+      if (++digits > 19)
+        return NULL;
+      mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+      p++;
+    }
+  }
+
+  if (p < end && *p == '.')
+  {
+    p++;
+    if (p >= end || !isDigit(*p))
+      return NULL;
+
+    while (p < end && isDigit(*p))
+    {
+      // Zéros de tête après la virgule : pas de chiffre significatif
+      if (mantissa != 0 || *p != '0')
+      {
+        if (++digits > 19)
+          return NULL;
+      }
+      mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+      exponent--;
+      p++;
+    }
+  }
+
+  if (p < end && (*p == 'e' || *p == 'E'))
+  {
+    int exp_negative = 0;
+    int exp_value = 0;
+
+    p++;
+    if (p < end && (*p == '+' || *p == '-'))
+    {
+      exp_negative = (*p == '-');
+      p++;
+    }
+    if (p >= end || !isDigit(*p))
+      return NULL;
+
+    while (p < end && isDigit(*p))
+    {
+      if (exp_value > 1000)
+        return NULL;
+      exp_value = exp_value * 10 + (*p - '0');
+      p++;
+    }
+    exponent += exp_negative ? -exp_value : exp_value;
+  }
+
+  if (mantissa > (1ULL << 53) || exponent < -22 || exponent > 22)
+    return NULL;
+
+  double value = (double)mantissa;
+  if (exponent < 0)
+    value /= pow10_exact[-exponent];
+  else
+    value *= pow10_exact[exponent];
+
+  *out = negative ? -value : value;
+  return p;
+}
+
+// Chaîne JSON sans la valider (échappements sautés) ; p pointe sur le '"' ouvrant
+static const char *skipString(const char *p, const char *end)
+{
+  p++;
+  while (p < end && *p != '"')
+  {
+    if (*p == '\\')
+      p++;
+    p++;
+  }
+  return (p < end) ? p + 1 : NULL;
+}
+
+static const char *skipLiteral(const char *p, const char *end, const char *literal, size_t n)
+{
+  if ((size_t)(end - p) < n || memcmp(p, literal, n) != 0)
+    return NULL;
+  return p + n;
+}
+
+static const char *skipScalar(const char *p, const char *end)
+{
+  double ignored;
+
+  switch (*p)
+  {
+  case '"':
+    return skipString(p, end);
+  case 't':
+    return skipLiteral(p, end, "true", 4);
+  case 'f':
+    return skipLiteral(p, end, "false", 5);
+  case 'n':
+    return skipLiteral(p, end, "null", 4);
+  default:
+    return parseNumber(p, end, &ignored);
+  }
+}
+
+int payload_parse_fast(const char *payload, size_t len, SensorSample *sample)
+{
+  const char *p = payload;
+  const char *end = payload + len;
+  unsigned seen = 0;
+
+  p = skipSpaces(p, end);
+  if (p >= end || *p != '{')
+    return -1;
+  p++;
+
+  while (1)
+  {
+    p = skipSpaces(p, end);
+    if (p >= end || *p != '"')
+      return -1;
+
+    const char *key = ++p;
+    while (p < end && *p != '"')
+    {
+      if (*p == '\\')
+        return -1;
+      p++;
+    }
+    if (p >= end)
+      return -1;
+    size_t key_len = (size_t)(p - key);
+    p++;
+
+    p = skipSpaces(p, end);
+    if (p >= end || *p != ':')
+      return -1;
+    p = skipSpaces(p + 1, end);
+    if (p >= end)
+      return -1;
+
+    double *target = NULL;
+    unsigned field = 0;
+
+    if (key_len == 11 && memcmp(key, "temperature", 11) == 0)
+    {
+      target = &sample->temperature;
+      field = FIELD_TEMPERATURE;
+    }
+    else if (key_len == 8 && memcmp(key, "pression", 8) == 0)
+    {
+      target = &sample->pression;
+      field = FIELD_PRESSION;
+    }
+    else if (key_len == 8 && memcmp(key, "humidite", 8) == 0)
+    {
+      target = &sample->humidite;
+      field = FIELD_HUMIDITE;
+    }
+    else if (key_len == 1 && key[0] == 'n')
+    {
+      // Résumé : dispersions lues par json-c
+      return -1;
+    }
+
+    if (target)
+    {
+      p = parseNumber(p, end, target);
+      seen |= field;
+    }
+    else
+    {
+      p = skipScalar(p, end);
+    }
+    if (!p)
+      return -1;
+
+    p = skipSpaces(p, end);
+    if (p >= end)
+      return -1;
+    if (*p == '}')
+      break;
+    if (*p != ',')
+      return -1;
+    p++;
+  }
+
+  // Rien d'autre que des espaces (ou un '\0' final) après l'objet
+  p = skipSpaces(p + 1, end);
+  while (p < end && *p == '\0')
+    p++;
+
+  return (p == end && seen == FIELDS_ALL) ? 0 : -1;
+}
+
+// ===== REPLI JSON-C =====
+
+static void readSpread(struct json_object *obj, const char *metric, SampleSpread *spread, double mean)
+{
+  static const char *suffixes[3] = {"min", "max", "std"};
+  double *targets[3] = {&spread->min, &spread->max, &spread->stddev};
+  char key[32];
+
+  for (int i = 0; i < 3; i++)
+  {
+    struct json_object *value;
+    snprintf(key, sizeof(key), "%s_%s", metric, suffixes[i]);
+    *targets[i] = json_object_object_get_ex(obj, key, &value) ? json_object_get_double(value) : (i < 2 ? mean : 0.0);
+  }
+}
+
+// Clé "n" : objet résumé par l'appareil ; sinon lecture simple
+static void readSummary(struct json_object *obj, SensorSample *sample)
+{
+  struct json_object *n_obj;
+
+  sample->readings = json_object_object_get_ex(obj, "n", &n_obj) ? json_object_get_int(n_obj) : 0;
+  if (sample->readings < 0)
+    sample->readings = 0;
+  if (sample->readings == 0)
+    return;
+
+  readSpread(obj, "temperature", &sample->temperature_spread, sample->temperature);
+  readSpread(obj, "pression", &sample->pression_spread, sample->pression);
+  readSpread(obj, "humidite", &sample->humidite_spread, sample->humidite);
+}
+
+// Bornes larges : écarte NaN, infinis et valeurs aberrantes, jamais stockés ni republiés
+#define VALUE_LIMIT 1e6
+
+static int valuesPlausible(const SensorSample *sample)
+{
+  const double values[] = {sample->temperature, sample->pression, sample->humidite};
+
+  for (int i = 0; i < 3; i++)
+  {
+    if (!isfinite(values[i]) || fabs(values[i]) >= VALUE_LIMIT)
+      return 0;
+  }
+  return 1;
+}
+
+int payload_parse_json(const char *payload, size_t len, SensorSample *sample)
+{
+  struct json_tokener *tok = json_tokener_new();
+  if (!tok)
+    return -1;
+
+  struct json_object *parsed_json = json_tokener_parse_ex(tok, payload, (int)len);
+  json_tokener_free(tok);
+
+  if (parsed_json == NULL)
+    return -1;
+
+  struct json_object *temp_obj, *press_obj, *hum_obj;
+
+  if (!json_object_object_get_ex(parsed_json, "temperature", &temp_obj) ||
+      !json_object_object_get_ex(parsed_json, "pression", &press_obj) ||
+      !json_object_object_get_ex(parsed_json, "humidite", &hum_obj))
+  {
+    json_object_put(parsed_json);
+    return -1;
+  }
+
+  sample->temperature = json_object_get_double(temp_obj);
+  sample->pression = json_object_get_double(press_obj);
+  sample->humidite = json_object_get_double(hum_obj);
+  readSummary(parsed_json, sample);
+
+  json_object_put(parsed_json);
+  return valuesPlausible(sample) ? 0 : -1;
+}
+
+// ===== FORMAT BINAIRE =====
+
+int payload_parse_binary(const void *payload, size_t len, SensorSample *sample)
+{
+  SensorPacket packet;
+
+  if (sensor_packet_decode(payload, len, &packet) != 0)
+    return -1;
+
+  // Dixièmes entiers : même double que le JSON "21.5" (division correctement arrondie)
+  sample->temperature = packet.temperature / 10.0;
+  sample->pression = packet.pression / 10.0;
+  sample->humidite = packet.humidite / 10.0;
+  sample->device_id = packet.device_id;
+  sample->sequence = packet.sequence;
+  sample->flags = packet.flags;
+  sample->age_ms = 0;
+  sample->readings = 0;
+  return 0;
+}
+
+static int parseBinaryBatch(const void *payload, size_t len, SensorSample *samples, int max)
+{
+  SensorPacket header;
+  int count = sensor_batch_decode_header(payload, len, &header);
+
+  if (count < 0 || count > max)
+    return -1;
+
+  for (int i = 0; i < count; i++)
+  {
+    SensorReading reading;
+    sensor_batch_reading(payload, i, &reading);
+
+    samples[i].temperature = reading.temperature / 10.0;
+    samples[i].pression = reading.pression / 10.0;
+    samples[i].humidite = reading.humidite / 10.0;
+    samples[i].device_id = header.device_id;
+    samples[i].sequence = (int64_t)header.sequence + i;
+    samples[i].flags = (i == 0) ? header.flags : 0;
+    samples[i].age_ms = (int64_t)reading.age * 100;
+    samples[i].readings = 0;
+  }
+
+  return count;
+}
+
+static void statToSpread(const SensorStat *stat, double *mean, SampleSpread *spread)
+{
+  *mean = stat->mean / 10.0;
+  spread->min = stat->min / 10.0;
+  spread->max = stat->max / 10.0;
+  spread->stddev = stat->stddev / 100.0;
+}
+
+static int parseBinarySummary(const void *payload, size_t len, SensorSample *samples, int max)
+{
+  SensorPacket header;
+  int count = sensor_summary_decode_header(payload, len, &header);
+
+  if (count < 0 || count > max)
+    return -1;
+
+  for (int i = 0; i < count; i++)
+  {
+    SensorSummary summary;
+    sensor_summary_reading(payload, i, &summary);
+
+    statToSpread(&summary.temperature, &samples[i].temperature, &samples[i].temperature_spread);
+    statToSpread(&summary.pression, &samples[i].pression, &samples[i].pression_spread);
+    statToSpread(&summary.humidite, &samples[i].humidite, &samples[i].humidite_spread);
+    samples[i].device_id = header.device_id;
+    samples[i].sequence = (int64_t)header.sequence + i;
+    samples[i].flags = (i == 0) ? header.flags : 0;
+    samples[i].age_ms = (int64_t)summary.age * 100;
+    samples[i].readings = summary.readings;
+  }
+
+  return count;
+}
+
+static int parseBinaryBackfill(const void *payload, size_t len, SensorSample *samples, int max)
+{
+  SensorPacket header;
+  uint32_t clock;
+  int count = sensor_backfill_decode_header(payload, len, &header, &clock);
+
+  if (count < 0 || count > max)
+    return -1;
+
+  for (int i = 0; i < count; i++)
+  {
+    SensorRecord record;
+    sensor_backfill_record(payload, i, &record);
+
+    samples[i].temperature = record.temperature / 10.0;
+    samples[i].pression = record.pression / 10.0;
+    samples[i].humidite = record.humidite / 10.0;
+    samples[i].device_id = header.device_id;
+    samples[i].sequence = (int64_t)header.sequence + i;
+    samples[i].flags = (i == 0) ? header.flags : 0;
+    // Horloge de l'appareil : seule la différence avec l'envoi a un sens
+    samples[i].age_ms = (record.time <= clock) ? (int64_t)(clock - record.time) * 1000 : 0;
+    samples[i].readings = 0;
+  }
+
+  return count;
+}
+
+// Tableau JSON : json-c directement, le coût est amorti sur le lot
+static int parseJsonArray(const char *payload, size_t len, SensorSample *samples, int max)
+{
+  struct json_tokener *tok = json_tokener_new();
+  if (!tok)
+    return -1;
+
+  struct json_object *parsed_json = json_tokener_parse_ex(tok, payload, (int)len);
+  json_tokener_free(tok);
+
+  if (parsed_json == NULL)
+    return -1;
+
+  int count = -1;
+  if (json_object_is_type(parsed_json, json_type_array))
+  {
+    size_t n = json_object_array_length(parsed_json);
+    count = (n >= 1 && n <= (size_t)max) ? (int)n : -1;
+
+    for (int i = 0; i < count; i++)
+    {
+      struct json_object *item = json_object_array_get_idx(parsed_json, (size_t)i);
+      struct json_object *temp_obj, *press_obj, *hum_obj, *age_obj;
+
+      if (!json_object_object_get_ex(item, "temperature", &temp_obj) ||
+          !json_object_object_get_ex(item, "pression", &press_obj) ||
+          !json_object_object_get_ex(item, "humidite", &hum_obj))
+      {
+        count = -1;
+        break;
+      }
+
+      samples[i].temperature = json_object_get_double(temp_obj);
+      samples[i].pression = json_object_get_double(press_obj);
+      samples[i].humidite = json_object_get_double(hum_obj);
+      samples[i].device_id = 0;
+      samples[i].sequence = -1;
+      samples[i].flags = 0;
+      samples[i].age_ms = json_object_object_get_ex(item, "age_ms", &age_obj) ? json_object_get_int64(age_obj) : 0;
+      if (samples[i].age_ms < 0)
+        samples[i].age_ms = 0;
+      readSummary(item, &samples[i]);
+
+      if (!valuesPlausible(&samples[i]))
+      {
+        count = -1;
+        break;
+      }
+    }
+  }
+
+  json_object_put(parsed_json);
+  return count;
+}
+
+int payload_parse(const char *payload, size_t len, SensorSample *sample)
+{
+  // Un JSON ne commence jamais par le magic : pas de repli pour un paquet invalide
+  if (len > 0 && (unsigned char)payload[0] == SENSOR_PACKET_MAGIC)
+    return payload_parse_binary(payload, len, sample);
+
+  sample->device_id = 0;
+  sample->sequence = -1;
+  sample->flags = 0;
+  sample->age_ms = 0;
+  sample->readings = 0;
+
+  if (payload_parse_fast(payload, len, sample) == 0)
+    return valuesPlausible(sample) ? 0 : -1;
+
+  return payload_parse_json(payload, len, sample);
+}
+
+int payload_parse_samples(const char *payload, size_t len, SensorSample *samples, int max)
+{
+  if (max < 1)
+    return -1;
+
+  if (len > 1 && (unsigned char)payload[0] == SENSOR_PACKET_MAGIC)
+  {
+    if (payload[1] == SENSOR_BATCH_VERSION)
+      return parseBinaryBatch(payload, len, samples, max);
+    if (payload[1] == SENSOR_BACKFILL_VERSION)
+      return parseBinaryBackfill(payload, len, samples, max);
+    if (payload[1] == SENSOR_SUMMARY_VERSION)
+      return parseBinarySummary(payload, len, samples, max);
+  }
+
+  const char *p = skipSpaces(payload, payload + len);
+  if (p < payload + len && *p == '[')
+    return parseJsonArray(payload, len, samples, max);
+
+  return payload_parse(payload, len, samples) == 0 ? 1 : -1;
+}
+
+// ===== SÉRIALISATION =====
+
+// Gabarit : { "timestamp": "%s", "temperature": "%.1f", "pression": "%.1f", "humidite": "%.1f" }
+#define TPL_TIMESTAMP "{ \"timestamp\": \""
+#define TPL_TEMPERATURE "\", \"temperature\": \""
+#define TPL_PRESSION "\", \"pression\": \""
+#define TPL_HUMIDITE "\", \"humidite\": \""
+#define TPL_END "\" }"
+
+// Longueur maximale d'une valeur formatée par formatTenths
+#define VALUE_MAX_LEN 24
+
+static char *appendLiteral(char *out, const char *literal, size_t n)
+{
+  memcpy(out, literal, n);
+  return out + n;
+}
+
+#define APPEND_LITERAL(out, literal) appendLiteral(out, literal, sizeof(literal) - 1)
+
+// Équivalent de "%.1f" pour les valeurs capteur, en entiers
+static char *formatTenths(char *out, double value)
+{
+  if (!isfinite(value) || fabs(value) >= 1e15)
+  {
+    // snprintf renvoie la longueur non tronquée : avancer de ce qui est écrit
+    int n = snprintf(out, VALUE_MAX_LEN, "%.1f", value);
+    return out + ((n < 0) ? 0 : (n < VALUE_MAX_LEN) ? n : VALUE_MAX_LEN - 1);
+  }
+
+  if (signbit(value))
+  {
+    *out++ = '-';
+    value = -value;
+  }
+
+  // Arrondi au plus proche comme printf : value * 10 = scaled + err exactement,
+  // seul un scaled en x.5 pile dépend du reste err (ou de la parité si err = 0)
+  double scaled = value * 10.0;
+  double err = fma(value, 10.0, -scaled);
+  double lower = floor(scaled);
+  long long tenths = (long long)lower;
+
+  if (scaled - lower > 0.5)
+    tenths++;
+  else if (scaled - lower == 0.5 && (err > 0 || (err == 0 && (tenths & 1))))
+    tenths++;
+
+  char digits[20];
+  int n = 0;
+  long long integer = tenths / 10;
+  do
+  {
+    digits[n++] = (char)('0' + integer % 10);
+    integer /= 10;
+  } while (integer > 0);
+
+  while (n > 0)
+    *out++ = digits[--n];
+
+  *out++ = '.';
+  *out++ = (char)('0' + tenths % 10);
+  return out;
+}
+
+int payload_format_republish(char *buffer, size_t size, const char *timestamp, const SensorSample *sample)
+{
+  size_t ts_len = strlen(timestamp);
+  size_t worst = sizeof(TPL_TIMESTAMP TPL_TEMPERATURE TPL_PRESSION TPL_HUMIDITE TPL_END) +
+                 ts_len + 3 * VALUE_MAX_LEN;
+
+  if (size < worst)
+    return -1;
+
+  char *out = buffer;
+  out = APPEND_LITERAL(out, TPL_TIMESTAMP);
+  out = appendLiteral(out, timestamp, ts_len);
+  out = APPEND_LITERAL(out, TPL_TEMPERATURE);
+  out = formatTenths(out, sample->temperature);
+  out = APPEND_LITERAL(out, TPL_PRESSION);
+  out = formatTenths(out, sample->pression);
+  out = APPEND_LITERAL(out, TPL_HUMIDITE);
+  out = formatTenths(out, sample->humidite);
+  out = APPEND_LITERAL(out, TPL_END);
+  *out = '\0';
+
+  return (int)(out - buffer);
+}
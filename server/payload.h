@@ -0,0 +1,121 @@
+#ifndef PAYLOAD_H
+#define PAYLOAD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <json-c/json.h>
+
+// ===== STRUCTURES =====
+
+/**
+ * @brief Dispersion d'une métrique sur l'intervalle résumé par l'appareil
+ */
+typedef struct
+{
+  double min;
+  double max;
+  double stddev;
+} SampleSpread;
+
+/**
+ * @brief Mesure décodée d'un payload capteur
+ */
+typedef struct
+{
+  double temperature;
+  double pression;
+  double humidite;
+  int device_id;    // 0 pour un payload JSON
+  int64_t sequence; // -1 pour un payload JSON
+  unsigned flags;   // SENSOR_FLAG_* (format binaire)
+  int64_t age_ms;   // ancienneté de la mesure à l'envoi (lots), 0 sinon
+  int readings;     // lectures résumées par l'appareil (valeurs = moyennes), 0 pour une lecture simple
+  SampleSpread temperature_spread; // renseignés si readings > 0
+  SampleSpread pression_spread;
+  SampleSpread humidite_spread;
+} SensorSample;
+
+// Mesures maximales par message (lot binaire ou tableau JSON) ; le message
+// lui-même est borné par SENSOR_MESSAGE_MAX octets (sensor_packet.h)
+#define PAYLOAD_MAX_SAMPLES 64
+
+// ===== FONCTIONS =====
+
+/**
+ * @brief Parse un payload capteur
+ *
+ * Paquet binaire si le premier octet est SENSOR_PACKET_MAGIC (sensor_packet.h),
+ * sinon JSON : chemin rapide, puis json-c en repli. Une valeur JSON non finie
+ * ou aberrante (|v| >= 1e6) rejette la mesure.
+ *
+ * @param payload Payload MQTT (non terminé par '\0')
+ * @param len Longueur du payload
+ * @param sample Mesure à remplir
+ * @return 0 si succès, -1 en cas d'erreur
+ */
+int payload_parse(const char *payload, size_t len, SensorSample *sample);
+
+/**
+ * @brief Parse un payload d'une ou plusieurs mesures
+ *
+ * En plus des formats de payload_parse : lot binaire (sensor_packet.h,
+ * version 2), lot de rattrapage (version 3, ancienneté déduite de l'horloge
+ * de l'appareil), lot de résumés (version 4) et tableau JSON d'objets
+ * capteur, chacun avec une clé facultative "age_ms" (ancienneté à l'envoi).
+ * Un objet JSON résumé porte en plus "n" et <métrique>_min, _max, _std.
+ *
+ * @param payload Payload MQTT (non terminé par '\0')
+ * @param len Longueur du payload
+ * @param samples Mesures à remplir, de la plus ancienne à la plus récente
+ * @param max Capacité de samples
+ * @return Nombre de mesures, -1 en cas d'erreur ou si le lot dépasse max
+ */
+int payload_parse_samples(const char *payload, size_t len, SensorSample *samples, int max);
+
+/**
+ * @brief Parse en une passe, sans allocation, un objet JSON plat au schéma capteur
+ *
+ * Accepte les clés dans n'importe quel ordre, les espaces et les clés inconnues
+ * à valeur scalaire. Rejette tout le reste (objets imbriqués, nombres hors du
+ * domaine exact du double, résumés avec "n"...) pour laisser json-c trancher.
+ *
+ * @param payload Payload MQTT (non terminé par '\0')
+ * @param len Longueur du payload
+ * @param sample Mesure à remplir
+ * @return 0 si succès, -1 si le payload est rejeté
+ */
+int payload_parse_fast(const char *payload, size_t len, SensorSample *sample);
+
+/**
+ * @brief Décode un paquet binaire (sensor_packet.h), sans copie ni allocation
+ * @param payload Payload MQTT
+ * @param len Longueur du payload
+ * @param sample Mesure à remplir
+ * @return 0 si succès, -1 si taille, magic ou version invalide
+ */
+int payload_parse_binary(const void *payload, size_t len, SensorSample *sample);
+
+/**
+ * @brief Parse un payload capteur avec json-c (chemin de repli)
+ * @param payload Payload MQTT (non terminé par '\0')
+ * @param len Longueur du payload
+ * @param sample Mesure à remplir
+ * @return 0 si succès, -1 en cas d'erreur
+ */
+int payload_parse_json(const char *payload, size_t len, SensorSample *sample);
+
+/**
+ * @brief Sérialise la mesure enrichie du timestamp serveur, sans allocation
+ *
+ * Produit exactement le JSON historique de json-c (valeurs en chaînes à une
+ * décimale, même ordre de clés) à partir d'un gabarit précalculé.
+ *
+ * @param buffer Buffer de sortie (réutilisable)
+ * @param size Taille du buffer
+ * @param timestamp Timestamp serveur
+ * @param sample Mesure à sérialiser
+ * @return Longueur écrite (sans '\0'), -1 si le buffer est trop petit
+ */
+int payload_format_republish(char *buffer, size_t size, const char *timestamp, const SensorSample *sample);
+
+#endif // PAYLOAD_H
@@ -0,0 +1,417 @@
+#include "query_server.h"
+#include "archive.h"
+#include "devices.h"
+#include "recent_cache.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define MAX_DEVICES_LISTED 1024
+
+typedef struct
+{
+  int fd;
+  size_t len;
+  char line[QUERY_LINE_SIZE];
+} QueryClient;
+
+// Réponse construite en mémoire puis envoyée d'un bloc
+typedef struct
+{
+  char *data;
+  size_t len;
+  size_t cap;
+} Reply;
+
+static pthread_t server_thread;
+static int listen_fd = -1;
+static int wake_pipe[2] = {-1, -1};
+static int running = 0;
+static char bound_path[108];
+static char archive_dir[1024];
+static QueryClient clients[QUERY_MAX_CLIENTS];
+
+static void replyAppend(Reply *r, const char *fmt, ...)
+{
+  va_list args;
+
+  for (int attempt = 0; attempt < 2; attempt++)
+  {
+    size_t room = r->cap - r->len;
+    va_start(args, fmt);
+    int n = vsnprintf(r->data ? r->data + r->len : NULL, r->data ? room : 0, fmt, args);
+    va_end(args);
+
+    if (n < 0)
+      return;
+    if (r->data && (size_t)n < room)
+    {
+      r->len += (size_t)n;
+      return;
+    }
+
+    size_t cap = (r->cap ? r->cap : 256);
+    while (cap < r->len + (size_t)n + 1)
+      cap *= 2;
+
+    char *grown = realloc(r->data, cap);
+    if (!grown)
+      return;
+    r->data = grown;
+    r->cap = cap;
+  }
+}
+
+static int sendAll(int fd, const char *data, size_t len)
+{
+  while (len > 0)
+  {
+    ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+    if (n < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      return -1;
+    }
+    data += n;
+    len -= (size_t)n;
+  }
+  return 0;
+}
+
+static void appendSample(Reply *r, const RecentSample *s)
+{
+  replyAppend(r, "%" PRId64 " %.7g %.7g %.7g\n", s->ts_ms, s->value[0], s->value[1], s->value[2]);
+}
+
+typedef struct
+{
+  Reply *rows;
+  size_t count;
+} ArchiveRows;
+
+static int appendArchived(void *ctx, int device, int64_t ts_ms, double temp, double press, double hum)
+{
+  (void)device;
+  ArchiveRows *a = ctx;
+
+  replyAppend(a->rows, "%" PRId64 " %.7g %.7g %.7g\n", ts_ms, temp, press, hum);
+  return (++a->count >= QUERY_ARCHIVE_MAX_ROWS) ? 1 : 0;
+}
+
+// Lit "<device> [from [to]]" ; bornes absentes : toute la fenêtre
+static int parseRangeArgs(const char *args, int *device, int64_t *from_ms, int64_t *to_ms)
+{
+  long long from = INT64_MIN, to = INT64_MAX;
+  int n = sscanf(args, "%d %lld %lld", device, &from, &to);
+
+  if (n < 1 || *device < 0)
+    return -1;
+
+  *from_ms = from;
+  *to_ms = to;
+  return 0;
+}
+
+static void handleCommand(const char *line, Reply *r)
+{
+  char command[16];
+  int consumed = 0;
+  int device;
+  int64_t from_ms, to_ms;
+
+  if (sscanf(line, "%15s%n", command, &consumed) != 1)
+  {
+    replyAppend(r, "ERR requête vide\n");
+    return;
+  }
+
+  const char *args = line + consumed;
+
+  if (strcasecmp(command, "LAST") == 0)
+  {
+    RecentSample s;
+    if (sscanf(args, "%d", &device) != 1)
+      replyAppend(r, "ERR usage : LAST <device>\n");
+    else if (recent_cache_last(device, &s) != 0)
+      replyAppend(r, "OK 0\n");
+    else
+    {
+      replyAppend(r, "OK 1\n");
+      appendSample(r, &s);
+    }
+  }
+  else if (strcasecmp(command, "RANGE") == 0)
+  {
+    if (parseRangeArgs(args, &device, &from_ms, &to_ms) != 0)
+    {
+      replyAppend(r, "ERR usage : RANGE <device> [from_ms [to_ms]]\n");
+      return;
+    }
+
+    size_t count;
+    RecentSample *samples = recent_cache_range(device, from_ms, to_ms, &count);
+
+    // Avant la fenêtre récente : mesures archivées (partitions sorties de la rétention)
+    Reply archived = {0};
+    ArchiveRows rows = {&archived, 0};
+    int64_t archive_to = (count > 0) ? samples[0].ts_ms : to_ms;
+    if (archive_dir[0] && from_ms < archive_to &&
+        archive_query_range(archive_dir, device, from_ms, archive_to, appendArchived, &rows) != 0)
+    {
+      free(archived.data);
+      free(samples);
+      replyAppend(r, "ERR archive illisible\n");
+      return;
+    }
+
+    replyAppend(r, "OK %zu\n", rows.count + count);
+    if (rows.count > 0)
+      replyAppend(r, "%.*s", (int)archived.len, archived.data);
+    for (size_t i = 0; i < count; i++)
+      appendSample(r, &samples[i]);
+    free(archived.data);
+    free(samples);
+  }
+  else if (strcasecmp(command, "AGG") == 0)
+  {
+    RecentAggregate agg;
+    if (parseRangeArgs(args, &device, &from_ms, &to_ms) != 0)
+      replyAppend(r, "ERR usage : AGG <device> [from_ms [to_ms]]\n");
+    else if (recent_cache_aggregate(device, from_ms, to_ms, &agg) != 0)
+      replyAppend(r, "OK 0\n");
+    else
+    {
+      replyAppend(r, "OK 1\n%zu %" PRId64 " %" PRId64, agg.count, agg.first_ts, agg.last_ts);
+      for (int m = 0; m < RECENT_METRICS; m++)
+        replyAppend(r, " %.7g %.7g %.7g", agg.min[m], agg.mean[m], agg.max[m]);
+      replyAppend(r, "\n");
+    }
+  }
+  else if (strcasecmp(command, "DEVICES") == 0)
+  {
+    static int devices[MAX_DEVICES_LISTED];
+    static size_t counts[MAX_DEVICES_LISTED];
+    static int64_t last_ts[MAX_DEVICES_LISTED];
+
+    size_t n = recent_cache_devices(devices, counts, last_ts, MAX_DEVICES_LISTED);
+    replyAppend(r, "OK %zu\n", n);
+    for (size_t i = 0; i < n; i++)
+    {
+      char name[DEVICE_NAME_SIZE];
+      replyAppend(r, "%d %zu %" PRId64, devices[i], counts[i], last_ts[i]);
+      if (devices_name(devices[i], name, sizeof(name)) == 0)
+        replyAppend(r, " %s", name);
+      replyAppend(r, "\n");
+    }
+  }
+  else
+  {
+    replyAppend(r, "ERR commande inconnue : %s\n", command);
+  }
+}
+
+static void closeClient(QueryClient *c)
+{
+  close(c->fd);
+  c->fd = -1;
+  c->len = 0;
+}
+
+static void acceptClient(void)
+{
+  int fd = accept(listen_fd, NULL, NULL);
+  if (fd < 0)
+    return;
+
+  for (int i = 0; i < QUERY_MAX_CLIENTS; i++)
+  {
+    if (clients[i].fd < 0)
+    {
+      // Un client qui ne lit plus ne bloque pas le service plus d'une seconde
+      struct timeval timeout = {1, 0};
+      setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+      clients[i].fd = fd;
+      clients[i].len = 0;
+      return;
+    }
+  }
+
+  sendAll(fd, "ERR trop de clients\n", 20);
+  close(fd);
+}
+
+// Traite toutes les lignes complètes reçues ; 0 si le client reste ouvert
+static int readClient(QueryClient *c)
+{
+  ssize_t n = recv(c->fd, c->line + c->len, sizeof(c->line) - 1 - c->len, 0);
+  if (n <= 0)
+    return -1;
+
+  c->len += (size_t)n;
+
+  char *start = c->line;
+  char *newline;
+  while ((newline = memchr(start, '\n', c->len - (size_t)(start - c->line))) != NULL)
+  {
+    Reply reply = {NULL, 0, 0};
+
+    *newline = '\0';
+    if (newline > start && newline[-1] == '\r')
+      newline[-1] = '\0';
+
+    handleCommand(start, &reply);
+    int rc = reply.data ? sendAll(c->fd, reply.data, reply.len) : -1;
+    free(reply.data);
+    if (rc != 0)
+      return -1;
+
+    start = newline + 1;
+  }
+
+  c->len -= (size_t)(start - c->line);
+  memmove(c->line, start, c->len);
+
+  // Ligne trop longue sans fin de ligne : protocole non respecté
+  return (c->len >= sizeof(c->line) - 1) ? -1 : 0;
+}
+
+static void *queryServer(void *arg)
+{
+  (void)arg;
+
+  struct pollfd fds[QUERY_MAX_CLIENTS + 2];
+
+  while (1)
+  {
+    int nfds = 0;
+    fds[nfds++] = (struct pollfd){wake_pipe[0], POLLIN, 0};
+    fds[nfds++] = (struct pollfd){listen_fd, POLLIN, 0};
+
+    int slot_of[QUERY_MAX_CLIENTS + 2];
+    for (int i = 0; i < QUERY_MAX_CLIENTS; i++)
+    {
+      if (clients[i].fd >= 0)
+      {
+        slot_of[nfds] = i;
+        fds[nfds++] = (struct pollfd){clients[i].fd, POLLIN, 0};
+      }
+    }
+
+    if (poll(fds, (nfds_t)nfds, -1) < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+
+    if (fds[0].revents)
+      break;
+
+    if (fds[1].revents & POLLIN)
+      acceptClient();
+
+    for (int i = 2; i < nfds; i++)
+    {
+      if (fds[i].revents && readClient(&clients[slot_of[i]]) != 0)
+        closeClient(&clients[slot_of[i]]);
+    }
+  }
+
+  return NULL;
+}
+
+int query_server_start(const char *socket_path, const char *archive_path)
+{
+  struct sockaddr_un addr = {0};
+
+  snprintf(archive_dir, sizeof(archive_dir), "%s", archive_path ? archive_path : "");
+
+  for (int i = 0; i < QUERY_MAX_CLIENTS; i++)
+    clients[i].fd = -1;
+
+  if (strlen(socket_path) >= sizeof(addr.sun_path))
+  {
+    fprintf(stderr, "Chemin de socket trop long : %s\n", socket_path);
+    return -1;
+  }
+
+  addr.sun_family = AF_UNIX;
+  snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", socket_path);
+
+  listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (listen_fd < 0)
+  {
+    perror("Erreur socket requêtes");
+    return -1;
+  }
+
+  // Socket laissée par une instance précédente arrêtée brutalement
+  unlink(socket_path);
+  snprintf(bound_path, sizeof(bound_path), "%s", socket_path);
+
+  if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(listen_fd, 8) != 0 ||
+      pipe(wake_pipe) != 0)
+  {
+    fprintf(stderr, "Erreur socket requêtes %s : %s\n", socket_path, strerror(errno));
+    query_server_stop();
+    return -1;
+  }
+
+  if (pthread_create(&server_thread, NULL, queryServer, NULL) != 0)
+  {
+    fprintf(stderr, "Erreur création thread de requêtes\n");
+    query_server_stop();
+    return -1;
+  }
+
+  running = 1;
+  printf("Service de requêtes : %s\n", socket_path);
+  return 0;
+}
+
+void query_server_stop(void)
+{
+  if (listen_fd < 0)
+    return;
+
+  if (running)
+  {
+    if (write(wake_pipe[1], "x", 1) < 0)
+      perror("Erreur arrêt service de requêtes");
+    pthread_join(server_thread, NULL);
+    running = 0;
+  }
+
+  for (int i = 0; i < QUERY_MAX_CLIENTS; i++)
+  {
+    if (clients[i].fd >= 0)
+      closeClient(&clients[i]);
+  }
+
+  for (int i = 0; i < 2; i++)
+  {
+    if (wake_pipe[i] >= 0)
+      close(wake_pipe[i]);
+    wake_pipe[i] = -1;
+  }
+
+  if (listen_fd >= 0)
+  {
+    close(listen_fd);
+    listen_fd = -1;
+    unlink(bound_path);
+  }
+}
@@ -0,0 +1,36 @@
+#ifndef QUERY_SERVER_H
+#define QUERY_SERVER_H
+
+#define QUERY_MAX_CLIENTS 16
+#define QUERY_LINE_SIZE 256
+#define QUERY_ARCHIVE_MAX_ROWS 65536 // mesures archivées au plus par RANGE
+
+// ===== SERVICE DE REQUÊTES LOCAL =====
+
+/*
+ * Socket Unix (flux) servie par un thread dédié, protocole texte ligne par
+ * ligne. Chaque requête reçoit "OK <n>" suivi de n lignes, ou "ERR <motif>".
+ * Les réponses viennent de la fenêtre récente (recent_cache.h), jamais de
+ * SQLite : aucune concurrence avec le verrou d'écriture de la base. RANGE
+ * complète par l'archive (archive.h) les instants antérieurs à la fenêtre.
+ *
+ *   LAST <device>                 -> ts temperature pression humidite
+ *   RANGE <device> [from [to]]    -> une ligne par mesure, bornes en epoch ms
+ *   AGG <device> [from [to]]      -> n first_ts last_ts puis min moy max par métrique
+ *   DEVICES                       -> device nombre_de_mesures dernier_ts [nom]
+ */
+
+/**
+ * @brief Crée la socket et démarre le thread de service
+ * @param socket_path Chemin de la socket (remplacée si elle existe)
+ * @param archive_path Dossier de l'archive lu par RANGE, NULL sans archive
+ * @return 0 si succès, -1 en cas d'erreur
+ */
+int query_server_start(const char *socket_path, const char *archive_path);
+
+/**
+ * @brief Arrête le thread, ferme les clients et supprime la socket
+ */
+void query_server_stop(void);
+
+#endif // QUERY_SERVER_H
@@ -0,0 +1,290 @@
+#include "recent_cache.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INITIAL_CAPACITY 256
+
+typedef struct
+{
+  RecentSample *samples;
+  size_t capacity;
+  size_t head;
+  size_t count;
+} DeviceWindow;
+
+static pthread_rwlock_t lock = PTHREAD_RWLOCK_INITIALIZER;
+static DeviceWindow *windows = NULL;
+static int device_capacity = 0;
+static int64_t window_ms = 0;
+static size_t max_samples = 0;
+
+static RecentSample *sampleAt(DeviceWindow *w, size_t i)
+{
+  return &w->samples[(w->head + i) % w->capacity];
+}
+
+// Premier indice (0..count) dont l'instant est >= ts
+static size_t lowerBound(DeviceWindow *w, int64_t ts)
+{
+  size_t lo = 0, hi = w->count;
+  while (lo < hi)
+  {
+    size_t mid = lo + (hi - lo) / 2;
+    if (sampleAt(w, mid)->ts_ms < ts)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+static DeviceWindow *findWindow(int device)
+{
+  if (device < 0 || device >= device_capacity || windows[device].count == 0)
+    return NULL;
+  return &windows[device];
+}
+
+static void dropOlderThan(DeviceWindow *w, int64_t cutoff_ms)
+{
+  size_t n = lowerBound(w, cutoff_ms);
+  w->head = (w->head + n) % (w->capacity ? w->capacity : 1);
+  w->count -= n;
+}
+
+// Double la capacité en remettant l'anneau à plat
+static int grow(DeviceWindow *w)
+{
+  size_t capacity = w->capacity ? w->capacity * 2 : INITIAL_CAPACITY;
+  if (capacity > max_samples)
+    capacity = max_samples;
+
+  RecentSample *samples = malloc(capacity * sizeof(RecentSample));
+  if (!samples)
+    return -1;
+
+  for (size_t i = 0; i < w->count; i++)
+    samples[i] = *sampleAt(w, i);
+
+  free(w->samples);
+  w->samples = samples;
+  w->capacity = capacity;
+  w->head = 0;
+  return 0;
+}
+
+int recent_cache_init(int64_t window, size_t max)
+{
+  window_ms = window;
+  max_samples = max > 0 ? max : INITIAL_CAPACITY;
+  return 0;
+}
+
+int recent_cache_add(int device, int64_t ts_ms, double temp, double press, double hum)
+{
+  RecentSample sample = {ts_ms, {(float)temp, (float)press, (float)hum}};
+  int rc = 0;
+
+  if (device < 0)
+    return -1;
+
+  pthread_rwlock_wrlock(&lock);
+
+  if (device >= device_capacity)
+  {
+    int capacity = device_capacity ? device_capacity : 4;
+    while (capacity <= device)
+      capacity *= 2;
+
+    DeviceWindow *grown = realloc(windows, (size_t)capacity * sizeof(DeviceWindow));
+    if (!grown)
+    {
+      rc = -1;
+      goto done;
+    }
+    memset(grown + device_capacity, 0, (size_t)(capacity - device_capacity) * sizeof(DeviceWindow));
+    windows = grown;
+    device_capacity = capacity;
+  }
+
+  DeviceWindow *w = &windows[device];
+
+  if (w->count > 0)
+  {
+    int64_t newest = sampleAt(w, w->count - 1)->ts_ms;
+    if (newest < ts_ms)
+      newest = ts_ms;
+    if (window_ms > 0)
+      dropOlderThan(w, newest - window_ms);
+    if (window_ms > 0 && ts_ms < newest - window_ms)
+      goto done;
+  }
+
+  if (w->count == w->capacity)
+  {
+    if (w->capacity < max_samples)
+    {
+      if (grow(w) != 0)
+      {
+        rc = -1;
+        goto done;
+      }
+    }
+    else
+    {
+      // Anneau plein : la plus ancienne mesure laisse sa place
+      w->head = (w->head + 1) % w->capacity;
+      w->count--;
+    }
+  }
+
+  // Arrivées dans l'ordre : insertion en fin, sinon décalage des quelques plus récentes
+  size_t pos = w->count;
+  while (pos > 0 && sampleAt(w, pos - 1)->ts_ms > ts_ms)
+    pos--;
+
+  if (pos > 0 && sampleAt(w, pos - 1)->ts_ms == ts_ms)
+  {
+    *sampleAt(w, pos - 1) = sample;
+    goto done;
+  }
+
+  for (size_t i = w->count; i > pos; i--)
+    *sampleAt(w, i) = *sampleAt(w, i - 1);
+
+  *sampleAt(w, pos) = sample;
+  w->count++;
+
+done:
+  pthread_rwlock_unlock(&lock);
+  return rc;
+}
+
+int recent_cache_last(int device, RecentSample *out)
+{
+  int rc = -1;
+
+  pthread_rwlock_rdlock(&lock);
+  DeviceWindow *w = findWindow(device);
+  if (w)
+  {
+    *out = *sampleAt(w, w->count - 1);
+    rc = 0;
+  }
+  pthread_rwlock_unlock(&lock);
+
+  return rc;
+}
+
+RecentSample *recent_cache_range(int device, int64_t from_ms, int64_t to_ms, size_t *count)
+{
+  RecentSample *out = NULL;
+
+  *count = 0;
+  pthread_rwlock_rdlock(&lock);
+
+  DeviceWindow *w = findWindow(device);
+  if (w)
+  {
+    size_t first = lowerBound(w, from_ms);
+    size_t last = lowerBound(w, to_ms);
+
+    if (last > first && (out = malloc((last - first) * sizeof(RecentSample))) != NULL)
+    {
+      for (size_t i = first; i < last; i++)
+        out[i - first] = *sampleAt(w, i);
+      *count = last - first;
+    }
+  }
+
+  pthread_rwlock_unlock(&lock);
+  return out;
+}
+
+int recent_cache_aggregate(int device, int64_t from_ms, int64_t to_ms, RecentAggregate *out)
+{
+  double sum[RECENT_METRICS] = {0};
+
+  memset(out, 0, sizeof(*out));
+  pthread_rwlock_rdlock(&lock);
+
+  DeviceWindow *w = findWindow(device);
+  if (w)
+  {
+    size_t first = lowerBound(w, from_ms);
+    size_t last = lowerBound(w, to_ms);
+
+    for (size_t i = first; i < last; i++)
+    {
+      const RecentSample *s = sampleAt(w, i);
+      for (int m = 0; m < RECENT_METRICS; m++)
+      {
+        double v = s->value[m];
+        if (i == first || v < out->min[m])
+          out->min[m] = v;
+        if (i == first || v > out->max[m])
+          out->max[m] = v;
+        sum[m] += v;
+      }
+    }
+
+    if (last > first)
+    {
+      out->count = last - first;
+      out->first_ts = sampleAt(w, first)->ts_ms;
+      out->last_ts = sampleAt(w, last - 1)->ts_ms;
+    }
+  }
+
+  pthread_rwlock_unlock(&lock);
+
+  for (int m = 0; m < RECENT_METRICS && out->count > 0; m++)
+    out->mean[m] = sum[m] / (double)out->count;
+
+  return out->count > 0 ? 0 : -1;
+}
+
+size_t recent_cache_devices(int *devices, size_t *counts, int64_t *last_ts, size_t max)
+{
+  size_t n = 0;
+
+  pthread_rwlock_rdlock(&lock);
+  for (int d = 0; d < device_capacity && n < max; d++)
+  {
+    DeviceWindow *w = &windows[d];
+    if (w->count == 0)
+      continue;
+
+    devices[n] = d;
+    counts[n] = w->count;
+    last_ts[n] = sampleAt(w, w->count - 1)->ts_ms;
+    n++;
+  }
+  pthread_rwlock_unlock(&lock);
+
+  return n;
+}
+
+void recent_cache_evict(int64_t cutoff_ms)
+{
+  pthread_rwlock_wrlock(&lock);
+  for (int d = 0; d < device_capacity; d++)
+  {
+    if (windows[d].count > 0)
+      dropOlderThan(&windows[d], cutoff_ms);
+  }
+  pthread_rwlock_unlock(&lock);
+}
+
+void recent_cache_close(void)
+{
+  pthread_rwlock_wrlock(&lock);
+  for (int d = 0; d < device_capacity; d++)
+    free(windows[d].samples);
+  free(windows);
+  windows = NULL;
+  device_capacity = 0;
+  pthread_rwlock_unlock(&lock);
+}
@@ -0,0 +1,93 @@
+#ifndef RECENT_CACHE_H
+#define RECENT_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define RECENT_METRICS 3
+
+// ===== FENÊTRE RÉCENTE EN MÉMOIRE =====
+
+/*
+ * Dernières mesures de chaque appareil, triées par instant, dans un anneau
+ * par appareil qui grandit jusqu'à max_samples. Alimentée par le thread
+ * d'écriture, lue par le service de requêtes : un verrou lecteurs/écrivain
+ * protège l'ensemble, les lectures copient avant de rendre la main.
+ */
+
+/**
+ * @brief Mesure en cache (valeurs en float : 24 octets par mesure)
+ */
+typedef struct
+{
+  int64_t ts_ms;
+  float value[RECENT_METRICS]; // temperature, pression, humidite
+} RecentSample;
+
+/**
+ * @brief Agrégat d'une plage de la fenêtre
+ */
+typedef struct
+{
+  size_t count;
+  int64_t first_ts;
+  int64_t last_ts;
+  double min[RECENT_METRICS];
+  double mean[RECENT_METRICS];
+  double max[RECENT_METRICS];
+} RecentAggregate;
+
+/**
+ * @brief Initialise la fenêtre
+ * @param window_ms Durée conservée par appareil, <= 0 pour ne borner que par max_samples
+ * @param max_samples Nombre maximal de mesures par appareil
+ * @return 0 si succès, -1 en cas d'erreur
+ */
+int recent_cache_init(int64_t window_ms, size_t max_samples);
+
+/**
+ * @brief Ajoute une mesure (remplace celle de même instant)
+ * @return 0 si succès, -1 en cas d'erreur d'allocation
+ */
+int recent_cache_add(int device, int64_t ts_ms, double temp, double press, double hum);
+
+/**
+ * @brief Dernière mesure d'un appareil
+ * @return 0 si trouvée, -1 sinon
+ */
+int recent_cache_last(int device, RecentSample *out);
+
+/**
+ * @brief Copie les mesures de [from_ms, to_ms[
+ * @param count Nombre de mesures copiées
+ * @return Tableau à libérer avec free(), NULL si aucune mesure
+ */
+RecentSample *recent_cache_range(int device, int64_t from_ms, int64_t to_ms, size_t *count);
+
+/**
+ * @brief Min / moyenne / max des mesures de [from_ms, to_ms[
+ * @return 0 si au moins une mesure, -1 sinon
+ */
+int recent_cache_aggregate(int device, int64_t from_ms, int64_t to_ms, RecentAggregate *out);
+
+/**
+ * @brief Liste les appareils présents
+ * @param devices Identifiants (max éléments)
+ * @param counts Nombre de mesures de chaque appareil
+ * @param last_ts Instant de la dernière mesure de chaque appareil
+ * @param max Taille des tableaux
+ * @return Nombre d'appareils écrits
+ */
+size_t recent_cache_devices(int *devices, size_t *counts, int64_t *last_ts, size_t max);
+
+/**
+ * @brief Retire les mesures antérieures à cutoff_ms (appareils devenus muets)
+ */
+void recent_cache_evict(int64_t cutoff_ms);
+
+/**
+ * @brief Libère la fenêtre
+ */
+void recent_cache_close(void);
+
+#endif // RECENT_CACHE_H
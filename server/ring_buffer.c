@@ -0,0 +1,149 @@
+#include "ring_buffer.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+int ring_init(RingBuffer *rb, size_t capacity, size_t slot_size)
+{
+  size_t cap = 2;
+  while (cap < capacity)
+    cap <<= 1;
+
+  memset(rb, 0, sizeof(*rb));
+
+  rb->slots = calloc(cap, slot_size);
+  if (!rb->slots)
+    return -1;
+
+  rb->slot_size = slot_size;
+  rb->capacity = cap;
+  rb->mask = cap - 1;
+  atomic_init(&rb->head, 0);
+  atomic_init(&rb->tail, 0);
+  atomic_init(&rb->high_water, 0);
+  atomic_init(&rb->pushed, 0);
+  atomic_init(&rb->dropped, 0);
+
+  if (sem_init(&rb->items, 0, 0) != 0)
+  {
+    free(rb->slots);
+    rb->slots = NULL;
+    return -1;
+  }
+
+  rb->wakeup = &rb->items;
+  return 0;
+}
+
+void ring_share_wakeup(RingBuffer *rb, RingBuffer *target)
+{
+  rb->wakeup = target->wakeup;
+}
+
+void ring_destroy(RingBuffer *rb)
+{
+  if (!rb->slots)
+    return;
+
+  sem_destroy(&rb->items);
+  free(rb->slots);
+  rb->slots = NULL;
+}
+
+void *ring_try_reserve(RingBuffer *rb)
+{
+  size_t head = atomic_load_explicit(&rb->head, memory_order_relaxed);
+  size_t tail = atomic_load_explicit(&rb->tail, memory_order_acquire);
+
+  if (head - tail >= rb->capacity)
+    return NULL;
+
+  return rb->slots + (head & rb->mask) * rb->slot_size;
+}
+
+void *ring_reserve(RingBuffer *rb)
+{
+  void *slot = ring_try_reserve(rb);
+  if (!slot)
+    ring_drop(rb);
+  return slot;
+}
+
+void ring_commit(RingBuffer *rb)
+{
+  size_t head = atomic_load_explicit(&rb->head, memory_order_relaxed) + 1;
+  atomic_store_explicit(&rb->head, head, memory_order_release);
+  atomic_fetch_add_explicit(&rb->pushed, 1, memory_order_relaxed);
+
+  // high_water n'est écrit que par le producteur
+  size_t depth = head - atomic_load_explicit(&rb->tail, memory_order_relaxed);
+  if (depth > atomic_load_explicit(&rb->high_water, memory_order_relaxed))
+    atomic_store_explicit(&rb->high_water, depth, memory_order_relaxed);
+
+  sem_post(rb->wakeup);
+}
+
+void ring_drop(RingBuffer *rb)
+{
+  atomic_fetch_add_explicit(&rb->dropped, 1, memory_order_relaxed);
+}
+
+void *ring_peek(RingBuffer *rb)
+{
+  size_t tail = atomic_load_explicit(&rb->tail, memory_order_relaxed);
+  size_t head = atomic_load_explicit(&rb->head, memory_order_acquire);
+
+  if (tail == head)
+    return NULL;
+
+  return rb->slots + (tail & rb->mask) * rb->slot_size;
+}
+
+void ring_release(RingBuffer *rb)
+{
+  size_t tail = atomic_load_explicit(&rb->tail, memory_order_relaxed);
+  atomic_store_explicit(&rb->tail, tail + 1, memory_order_release);
+}
+
+int ring_wait(RingBuffer *rb, int timeout_ms)
+{
+  struct timespec deadline;
+  clock_gettime(CLOCK_REALTIME, &deadline);
+  deadline.tv_sec += timeout_ms / 1000;
+  deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+  if (deadline.tv_nsec >= 1000000000L)
+  {
+    deadline.tv_sec++;
+    deadline.tv_nsec -= 1000000000L;
+  }
+
+  while (sem_timedwait(rb->wakeup, &deadline) != 0)
+  {
+    if (errno != EINTR)
+      return 0;
+  }
+
+  // Un seul réveil suffit pour vider la file : on absorbe les signaux en trop
+  while (sem_trywait(rb->wakeup) == 0)
+    ;
+
+  return 1;
+}
+
+void ring_wake(RingBuffer *rb)
+{
+  sem_post(rb->wakeup);
+}
+
+void ring_stats(RingBuffer *rb, RingStats *stats)
+{
+  size_t head = atomic_load_explicit(&rb->head, memory_order_acquire);
+  size_t tail = atomic_load_explicit(&rb->tail, memory_order_acquire);
+
+  stats->capacity = rb->capacity;
+  stats->depth = head - tail;
+  stats->high_water = atomic_load_explicit(&rb->high_water, memory_order_relaxed);
+  stats->pushed = atomic_load_explicit(&rb->pushed, memory_order_relaxed);
+  stats->dropped = atomic_load_explicit(&rb->dropped, memory_order_relaxed);
+}
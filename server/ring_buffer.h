@@ -0,0 +1,155 @@
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <semaphore.h>
+
+#include "sensor_packet.h"
+
+#define RING_PAYLOAD_SIZE SENSOR_MESSAGE_MAX // plus grand message accepté
+#define RING_CACHE_LINE 64
+
+// ===== STRUCTURES =====
+
+/**
+ * @brief Emplacement de la file : copie brute d'un message MQTT
+ */
+typedef struct
+{
+  int64_t received_ms;
+  int64_t enqueued_ns; // horloge monotone, pour la latence de file
+  int device;          // appareil déduit du topic, -1 : celui du payload
+  size_t len;
+  char payload[RING_PAYLOAD_SIZE];
+} RingSlot;
+
+/**
+ * @brief Compteurs de contre-pression de la file
+ */
+typedef struct
+{
+  size_t capacity;
+  size_t depth;
+  size_t high_water;
+  uint64_t pushed;
+  uint64_t dropped;
+} RingStats;
+
+/**
+ * @brief File bornée sans verrou, un seul producteur et un seul consommateur
+ *
+ * Le producteur (callback MQTT) écrit head, le consommateur (thread d'écriture)
+ * écrit tail : chaque index est sur sa propre ligne de cache. Le sémaphore ne
+ * sert qu'à réveiller le consommateur, il n'est jamais attendu par le producteur.
+ * Plusieurs files lues par un même consommateur peuvent partager le sémaphore
+ * de l'une d'elles (ring_share_wakeup).
+ */
+typedef struct
+{
+  unsigned char *slots;
+  size_t slot_size;
+  size_t capacity;
+  size_t mask;
+
+  _Alignas(RING_CACHE_LINE) atomic_size_t head;
+  atomic_size_t high_water;
+  atomic_uint_least64_t pushed;
+  atomic_uint_least64_t dropped;
+
+  _Alignas(RING_CACHE_LINE) atomic_size_t tail;
+
+  sem_t items;
+  sem_t *wakeup; // &items, ou celui d'une autre file
+} RingBuffer;
+
+// ===== FONCTIONS =====
+
+/**
+ * @brief Alloue la file
+ * @param rb File à initialiser
+ * @param capacity Nombre d'emplacements (arrondi à la puissance de 2 supérieure)
+ * @param slot_size Taille d'un emplacement (sizeof(RingSlot) pour les messages MQTT)
+ * @return 0 si succès, -1 en cas d'erreur
+ */
+int ring_init(RingBuffer *rb, size_t capacity, size_t slot_size);
+
+/**
+ * @brief Réveille le consommateur de target à chaque publication dans rb
+ *
+ * Le consommateur attend alors sur target (ring_wait) puis lit toutes ses files.
+ *
+ * @param rb File dont les publications sont signalées ailleurs
+ * @param target File dont le sémaphore est partagé
+ */
+void ring_share_wakeup(RingBuffer *rb, RingBuffer *target);
+
+/**
+ * @brief Libère la file
+ * @param rb File à libérer
+ */
+void ring_destroy(RingBuffer *rb);
+
+/**
+ * @brief Réserve l'emplacement suivant (producteur uniquement)
+ * @param rb File
+ * @return Emplacement libre, NULL si la file est pleine (message compté comme perdu)
+ */
+void *ring_reserve(RingBuffer *rb);
+
+/**
+ * @brief Comme ring_reserve, sans compter de perte : le producteur réessaiera
+ * @param rb File
+ * @return Emplacement libre, NULL si la file est pleine
+ */
+void *ring_try_reserve(RingBuffer *rb);
+
+/**
+ * @brief Publie l'emplacement réservé au consommateur (producteur uniquement)
+ * @param rb File
+ */
+void ring_commit(RingBuffer *rb);
+
+/**
+ * @brief Compte un message rejeté par le producteur (ex : trop volumineux)
+ * @param rb File
+ */
+void ring_drop(RingBuffer *rb);
+
+/**
+ * @brief Accède au plus ancien emplacement publié (consommateur uniquement)
+ * @param rb File
+ * @return Emplacement, NULL si la file est vide
+ */
+void *ring_peek(RingBuffer *rb);
+
+/**
+ * @brief Libère l'emplacement lu par ring_peek (consommateur uniquement)
+ * @param rb File
+ */
+void ring_release(RingBuffer *rb);
+
+/**
+ * @brief Attend qu'un message soit disponible
+ * @param rb File
+ * @param timeout_ms Délai maximal d'attente
+ * @return 1 si un message a été signalé, 0 sur délai expiré
+ */
+int ring_wait(RingBuffer *rb, int timeout_ms);
+
+/**
+ * @brief Réveille le consommateur sans publier de message (arrêt)
+ * @param rb File
+ */
+void ring_wake(RingBuffer *rb);
+
+/**
+ * @brief Lit les compteurs de contre-pression
+ * @param rb File
+ * @param stats Structure à remplir
+ */
+void ring_stats(RingBuffer *rb, RingStats *stats);
+
+#endif // RING_BUFFER_H
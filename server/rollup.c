@@ -0,0 +1,306 @@
+#include "rollup.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define METRICS 3
+
+typedef struct
+{
+  double sum;
+  double min;
+  double max;
+  double last;
+} MetricAgg;
+
+typedef struct
+{
+  int64_t bucket;
+  int64_t count;
+  int64_t last_ts;
+  MetricAgg metric[METRICS];
+} RollupAcc;
+
+typedef struct
+{
+  const char *table;
+  const char *view;
+  int64_t width_ms;
+  sqlite3_stmt *upsert;
+  sqlite3_stmt *purge;
+  RollupAcc *acc;
+} RollupLevelState;
+
+static const char *metric_names[METRICS] = {"temperature", "pression", "humidite"};
+
+static sqlite3 *rdb = NULL;
+static int device_capacity = 0;
+static RollupLevelState levels[ROLLUP_LEVELS] = {
+    {"rollup_1m", "mesures_1m", 60 * 1000LL, NULL, NULL, NULL},
+    {"rollup_1h", "mesures_1h", 3600 * 1000LL, NULL, NULL, NULL},
+};
+
+static int execSql(const char *sql)
+{
+  char *errMsg = NULL;
+  int rc = sqlite3_exec(rdb, sql, NULL, NULL, &errMsg);
+  if (rc != SQLITE_OK)
+  {
+    fprintf(stderr, "Erreur agrégats : %s\n", errMsg ? errMsg : sqlite3_errmsg(rdb));
+    sqlite3_free(errMsg);
+  }
+  return rc;
+}
+
+// Concatène un fragment SQL par métrique, fmt reçoit le nom de la métrique 4 fois
+static void appendPerMetric(char *sql, size_t size, const char *fmt)
+{
+  for (int m = 0; m < METRICS; m++)
+  {
+    size_t len = strlen(sql);
+    const char *n = metric_names[m];
+    snprintf(sql + len, size - len, fmt, n, n, n, n);
+  }
+}
+
+static int initLevel(RollupLevelState *level)
+{
+  char sql[2048];
+
+  // Table : une ligne par (appareil, seau)
+  snprintf(sql, sizeof(sql), "CREATE TABLE IF NOT EXISTS %s (device INTEGER NOT NULL, bucket INTEGER NOT NULL,"
+                             "n INTEGER NOT NULL, last_ts INTEGER NOT NULL,",
+           level->table);
+  appendPerMetric(sql, sizeof(sql), "%s_sum REAL, %s_min REAL, %s_max REAL, %s_last REAL,");
+  strncat(sql, "PRIMARY KEY (device, bucket)) WITHOUT ROWID;", sizeof(sql) - strlen(sql) - 1);
+  if (execSql(sql) != SQLITE_OK)
+    return SQLITE_ERROR;
+
+  // Vue lisible : moyennes calculées, bucket en epoch ms
+  snprintf(sql, sizeof(sql), "CREATE VIEW IF NOT EXISTS %s AS SELECT device, bucket, n", level->view);
+  appendPerMetric(sql, sizeof(sql), ", %s_sum / n AS %s_avg, %s_min, %s_max");
+  snprintf(sql + strlen(sql), sizeof(sql) - strlen(sql), " FROM %s;", level->table);
+  if (execSql(sql) != SQLITE_OK)
+    return SQLITE_ERROR;
+
+  // Fusion d'un cumul partiel : dans SET, les colonnes désignent l'ancienne ligne
+  snprintf(sql, sizeof(sql), "INSERT INTO %s VALUES (?1, ?2, ?3, ?4", level->table);
+  for (int i = 0; i < METRICS * 4; i++)
+    snprintf(sql + strlen(sql), sizeof(sql) - strlen(sql), ", ?%d", 5 + i);
+  strncat(sql, ") ON CONFLICT (device, bucket) DO UPDATE SET n = n + excluded.n", sizeof(sql) - strlen(sql) - 1);
+  for (int m = 0; m < METRICS; m++)
+  {
+    const char *n = metric_names[m];
+    snprintf(sql + strlen(sql), sizeof(sql) - strlen(sql),
+             ", %s_sum = %s_sum + excluded.%s_sum"
+             ", %s_min = min(%s_min, excluded.%s_min)"
+             ", %s_max = max(%s_max, excluded.%s_max)"
+             ", %s_last = CASE WHEN excluded.last_ts >= last_ts THEN excluded.%s_last ELSE %s_last END",
+             n, n, n, n, n, n, n, n, n, n, n, n);
+  }
+  strncat(sql, ", last_ts = max(last_ts, excluded.last_ts);", sizeof(sql) - strlen(sql) - 1);
+
+  if (sqlite3_prepare_v2(rdb, sql, -1, &level->upsert, NULL) != SQLITE_OK)
+  {
+    fprintf(stderr, "Erreur préparation agrégats : %s\n", sqlite3_errmsg(rdb));
+    return SQLITE_ERROR;
+  }
+
+  // Purge par appareil sur la clé primaire
+  snprintf(sql, sizeof(sql),
+           "DELETE FROM %s WHERE device IN (SELECT DISTINCT device FROM %s) AND bucket < ?1;",
+           level->table, level->table);
+  if (sqlite3_prepare_v2(rdb, sql, -1, &level->purge, NULL) != SQLITE_OK)
+  {
+    fprintf(stderr, "Erreur préparation purge agrégats : %s\n", sqlite3_errmsg(rdb));
+    return SQLITE_ERROR;
+  }
+
+  return SQLITE_OK;
+}
+
+int rollup_init(sqlite3 *db)
+{
+  rdb = db;
+
+  for (int l = 0; l < ROLLUP_LEVELS; l++)
+  {
+    if (initLevel(&levels[l]) != SQLITE_OK)
+      return SQLITE_ERROR;
+  }
+
+  return SQLITE_OK;
+}
+
+static int growDevices(int device)
+{
+  int capacity = device_capacity ? device_capacity : 8;
+  while (capacity <= device)
+    capacity *= 2;
+
+  for (int l = 0; l < ROLLUP_LEVELS; l++)
+  {
+    RollupAcc *grown = realloc(levels[l].acc, (size_t)capacity * sizeof(RollupAcc));
+    if (!grown)
+      return SQLITE_NOMEM;
+    memset(grown + device_capacity, 0, (size_t)(capacity - device_capacity) * sizeof(RollupAcc));
+    levels[l].acc = grown;
+  }
+
+  device_capacity = capacity;
+  return SQLITE_OK;
+}
+
+static int writeAcc(RollupLevelState *level, int device, RollupAcc *acc)
+{
+  if (acc->count == 0)
+    return SQLITE_OK;
+
+  sqlite3_stmt *stmt = level->upsert;
+  sqlite3_bind_int(stmt, 1, device);
+  sqlite3_bind_int64(stmt, 2, acc->bucket);
+  sqlite3_bind_int64(stmt, 3, acc->count);
+  sqlite3_bind_int64(stmt, 4, acc->last_ts);
+  for (int m = 0; m < METRICS; m++)
+  {
+    sqlite3_bind_double(stmt, 5 + m * 4, acc->metric[m].sum);
+    sqlite3_bind_double(stmt, 6 + m * 4, acc->metric[m].min);
+    sqlite3_bind_double(stmt, 7 + m * 4, acc->metric[m].max);
+    sqlite3_bind_double(stmt, 8 + m * 4, acc->metric[m].last);
+  }
+
+  int rc = sqlite3_step(stmt);
+  sqlite3_reset(stmt);
+
+  acc->count = 0;
+
+  if (rc != SQLITE_DONE)
+  {
+    fprintf(stderr, "Erreur écriture %s : %s\n", level->table, sqlite3_errmsg(rdb));
+    return rc;
+  }
+
+  return SQLITE_OK;
+}
+
+static int addRange(int device, int64_t ts_ms, const double values[METRICS], const double mins[METRICS],
+                    const double maxs[METRICS])
+{
+  int rc = SQLITE_OK;
+
+  if (device < 0)
+    return SQLITE_MISUSE;
+
+  if (device >= device_capacity && growDevices(device) != SQLITE_OK)
+    return SQLITE_NOMEM;
+
+  for (int l = 0; l < ROLLUP_LEVELS; l++)
+  {
+    RollupLevelState *level = &levels[l];
+    RollupAcc *acc = &level->acc[device];
+    int64_t bucket = ts_ms - (ts_ms % level->width_ms);
+
+    // Changement de seau : le cumul précédent est fusionné dans la table
+    if (acc->count > 0 && acc->bucket != bucket)
+      rc = writeAcc(level, device, acc);
+
+    if (acc->count == 0)
+    {
+      acc->bucket = bucket;
+      acc->last_ts = ts_ms;
+      for (int m = 0; m < METRICS; m++)
+      {
+        acc->metric[m].sum = 0;
+        acc->metric[m].min = mins[m];
+        acc->metric[m].max = maxs[m];
+        acc->metric[m].last = values[m];
+      }
+    }
+
+    acc->count++;
+    for (int m = 0; m < METRICS; m++)
+    {
+      MetricAgg *agg = &acc->metric[m];
+      agg->sum += values[m];
+      if (mins[m] < agg->min)
+        agg->min = mins[m];
+      if (maxs[m] > agg->max)
+        agg->max = maxs[m];
+    }
+
+    if (ts_ms >= acc->last_ts)
+    {
+      acc->last_ts = ts_ms;
+      for (int m = 0; m < METRICS; m++)
+        acc->metric[m].last = values[m];
+    }
+  }
+
+  return rc;
+}
+
+int rollup_add(int device, int64_t ts_ms, double temp, double press, double hum)
+{
+  const double values[METRICS] = {temp, press, hum};
+  return addRange(device, ts_ms, values, values, values);
+}
+
+int rollup_add_range(int device, int64_t ts_ms, const double mean[3], const double min[3], const double max[3])
+{
+  return addRange(device, ts_ms, mean, min, max);
+}
+
+int rollup_flush(void)
+{
+  int rc = SQLITE_OK;
+
+  for (int l = 0; l < ROLLUP_LEVELS; l++)
+  {
+    for (int d = 0; d < device_capacity; d++)
+    {
+      int step_rc = writeAcc(&levels[l], d, &levels[l].acc[d]);
+      if (step_rc != SQLITE_OK)
+        rc = step_rc;
+    }
+  }
+
+  return rc;
+}
+
+int rollup_purge(const int64_t cutoff_ms[ROLLUP_LEVELS])
+{
+  int rc = SQLITE_OK;
+
+  for (int l = 0; l < ROLLUP_LEVELS; l++)
+  {
+    if (cutoff_ms[l] <= 0)
+      continue;
+
+    sqlite3_bind_int64(levels[l].purge, 1, cutoff_ms[l]);
+    if (sqlite3_step(levels[l].purge) != SQLITE_DONE)
+    {
+      fprintf(stderr, "Erreur purge %s : %s\n", levels[l].table, sqlite3_errmsg(rdb));
+      rc = SQLITE_ERROR;
+    }
+    sqlite3_reset(levels[l].purge);
+  }
+
+  return rc;
+}
+
+void rollup_close(void)
+{
+  for (int l = 0; l < ROLLUP_LEVELS; l++)
+  {
+    sqlite3_finalize(levels[l].upsert);
+    sqlite3_finalize(levels[l].purge);
+    free(levels[l].acc);
+    levels[l].upsert = NULL;
+    levels[l].purge = NULL;
+    levels[l].acc = NULL;
+  }
+
+  device_capacity = 0;
+  rdb = NULL;
+}
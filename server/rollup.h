@@ -0,0 +1,75 @@
+#ifndef ROLLUP_H
+#define ROLLUP_H
+
+#include <stdint.h>
+#include <sqlite3.h>
+
+// ===== AGRÉGATS CONTINUS =====
+
+/*
+ * Deux niveaux d'agrégats par appareil : rollup_1m (minute) et rollup_1h
+ * (heure). Pour chaque métrique : nombre, somme, min, max et dernière valeur.
+ * Les agrégats du seau courant sont cumulés en mémoire puis fusionnés dans la
+ * table (UPSERT) quand le seau change ou au commit du lot, dans la même
+ * transaction que les mesures brutes.
+ */
+
+typedef enum
+{
+  ROLLUP_1M = 0,
+  ROLLUP_1H,
+  ROLLUP_LEVELS
+} RollupLevel;
+
+/**
+ * @brief Crée les tables et les vues d'agrégats
+ * @param db Base de données ouverte
+ * @return SQLITE_OK si succès, code d'erreur sinon
+ */
+int rollup_init(sqlite3 *db);
+
+/**
+ * @brief Cumule une mesure dans les seaux courants de chaque niveau
+ * @param device Appareil
+ * @param ts_ms Instant de la mesure (epoch UTC en millisecondes)
+ * @param temp Température
+ * @param press Pression
+ * @param hum Humidité
+ * @return SQLITE_OK si succès, code d'erreur sinon
+ */
+int rollup_add(int device, int64_t ts_ms, double temp, double press, double hum);
+
+/**
+ * @brief Cumule une mesure résumée par l'appareil (moyenne d'un intervalle)
+ *
+ * Compte pour une mesure ; min et max du seau tiennent compte des extrêmes
+ * de l'intervalle, même absents des moyennes.
+ *
+ * @param device Appareil
+ * @param ts_ms Instant de la mesure (epoch UTC en millisecondes)
+ * @param mean Moyennes (température, pression, humidité)
+ * @param min Minimums de l'intervalle
+ * @param max Maximums de l'intervalle
+ * @return SQLITE_OK si succès, code d'erreur sinon
+ */
+int rollup_add_range(int device, int64_t ts_ms, const double mean[3], const double min[3], const double max[3]);
+
+/**
+ * @brief Fusionne les cumuls en mémoire dans les tables (à appeler avant COMMIT)
+ * @return SQLITE_OK si succès, code d'erreur sinon
+ */
+int rollup_flush(void);
+
+/**
+ * @brief Supprime les seaux antérieurs à la limite de rétention de chaque niveau
+ * @param cutoff_ms Limites par niveau (epoch UTC en millisecondes), <= 0 pour conserver
+ * @return SQLITE_OK si succès, code d'erreur sinon
+ */
+int rollup_purge(const int64_t cutoff_ms[ROLLUP_LEVELS]);
+
+/**
+ * @brief Libère les statements et les cumuls (sans les écrire)
+ */
+void rollup_close(void);
+
+#endif // ROLLUP_H
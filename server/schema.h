@@ -0,0 +1,40 @@
+#ifndef SCHEMA_H
+#define SCHEMA_H
+
+// ===== SCHÉMA DES MESURES =====
+
+/*
+ * Colonnes communes aux tables de mesures. WITHOUT ROWID : la table est
+ * stockée dans l'ordre de sa clé primaire (device, ts), les lectures par
+ * appareil et plage de temps n'ont donc besoin d'aucun index secondaire.
+ *
+ * ts : epoch UTC en millisecondes.
+ */
+#define MESURES_COLUMNS_SQL          \
+  "("                                \
+  "device INTEGER NOT NULL DEFAULT 0," \
+  "ts INTEGER NOT NULL,"             \
+  "temperature REAL,"                \
+  "pression REAL,"                   \
+  "humidite REAL,"                   \
+  "PRIMARY KEY (device, ts)"         \
+  ") WITHOUT ROWID"
+
+/*
+ * Variante compacte : valeurs en dixièmes entiers (°C, hPa, %), stockées sur
+ * 1 à 3 octets au lieu d'un REAL de 8. La vue mesures et les lectures des
+ * partitions les reconvertissent en REAL.
+ */
+#define MESURES_COMPACT_SCALE 10
+
+#define MESURES_COMPACT_COLUMNS_SQL  \
+  "("                                \
+  "device INTEGER NOT NULL DEFAULT 0," \
+  "ts INTEGER NOT NULL,"             \
+  "temperature INTEGER,"             \
+  "pression INTEGER,"                \
+  "humidite INTEGER,"                \
+  "PRIMARY KEY (device, ts)"         \
+  ") WITHOUT ROWID"
+
+#endif // SCHEMA_H
@@ -0,0 +1,330 @@
+#include "window_stats.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INITIAL_CAPACITY 64
+
+typedef struct
+{
+  int64_t ts_ms;
+  double value[WINDOW_METRICS];
+} WindowSample;
+
+// File de numéros de mesure (anneau), valeurs monotones de l'avant vers l'arrière
+typedef struct
+{
+  uint64_t *seq;
+  size_t capacity;
+  size_t head;
+  size_t count;
+} SeqDeque;
+
+typedef struct
+{
+  uint64_t tail; // plus ancienne mesure de la fenêtre
+  double sum[WINDOW_METRICS];
+  double ewma[WINDOW_METRICS];
+  SeqDeque min[WINDOW_METRICS];
+  SeqDeque max[WINDOW_METRICS];
+} WindowState;
+
+typedef struct
+{
+  WindowSample *samples; // anneau indexé par seq & (capacity - 1)
+  size_t capacity;
+  uint64_t oldest; // mesures gardées : [oldest, next[
+  uint64_t next;
+  int64_t last_ts;
+  int dirty;
+  WindowState window[WINDOW_MAX_SIZES];
+} DeviceWindows;
+
+static int sizes_ms_count = 0;
+static int64_t sizes_ms[WINDOW_MAX_SIZES];
+static DeviceWindows *devices = NULL;
+static int device_capacity = 0;
+
+// ===== FILES MONOTONES =====
+
+static uint64_t dequeFront(const SeqDeque *q)
+{
+  return q->seq[q->head];
+}
+
+static uint64_t dequeBack(const SeqDeque *q)
+{
+  return q->seq[(q->head + q->count - 1) & (q->capacity - 1)];
+}
+
+static int dequePush(SeqDeque *q, uint64_t seq)
+{
+  if (q->count == q->capacity)
+  {
+    size_t capacity = q->capacity ? q->capacity * 2 : INITIAL_CAPACITY;
+    uint64_t *grown = malloc(capacity * sizeof(uint64_t));
+    if (!grown)
+      return -1;
+
+    for (size_t i = 0; i < q->count; i++)
+      grown[i] = q->seq[(q->head + i) & (q->capacity - 1)];
+
+    free(q->seq);
+    q->seq = grown;
+    q->capacity = capacity;
+    q->head = 0;
+  }
+
+  q->seq[(q->head + q->count) & (q->capacity - 1)] = seq;
+  q->count++;
+  return 0;
+}
+
+static void dequePopFront(SeqDeque *q)
+{
+  q->head = (q->head + 1) & (q->capacity - 1);
+  q->count--;
+}
+
+// ===== MESURES =====
+
+static WindowSample *sampleAt(DeviceWindows *d, uint64_t seq)
+{
+  return &d->samples[seq & (d->capacity - 1)];
+}
+
+static int growSamples(DeviceWindows *d)
+{
+  size_t capacity = d->capacity ? d->capacity * 2 : INITIAL_CAPACITY;
+  WindowSample *grown = malloc(capacity * sizeof(WindowSample));
+  if (!grown)
+    return -1;
+
+  for (uint64_t seq = d->oldest; seq < d->next; seq++)
+    grown[seq & (capacity - 1)] = *sampleAt(d, seq);
+
+  free(d->samples);
+  d->samples = grown;
+  d->capacity = capacity;
+  return 0;
+}
+
+static int growDevices(int device)
+{
+  int capacity = device_capacity ? device_capacity : 8;
+  while (capacity <= device)
+    capacity *= 2;
+
+  DeviceWindows *grown = realloc(devices, (size_t)capacity * sizeof(DeviceWindows));
+  if (!grown)
+    return -1;
+
+  memset(grown + device_capacity, 0, (size_t)(capacity - device_capacity) * sizeof(DeviceWindows));
+  devices = grown;
+  device_capacity = capacity;
+  return 0;
+}
+
+int window_stats_init(const int *sizes_s, int count)
+{
+  if (count < 1 || count > WINDOW_MAX_SIZES)
+    return -1;
+
+  for (int i = 0; i < count; i++)
+  {
+    if (sizes_s[i] <= 0 || (i > 0 && sizes_s[i] <= sizes_s[i - 1]))
+      return -1;
+    sizes_ms[i] = (int64_t)sizes_s[i] * 1000;
+  }
+
+  sizes_ms_count = count;
+  return 0;
+}
+
+static int addToWindow(DeviceWindows *d, WindowState *w, int64_t size_ms, uint64_t seq, int64_t dt_ms)
+{
+  const WindowSample *s = sampleAt(d, seq);
+
+  for (int m = 0; m < WINDOW_METRICS; m++)
+  {
+    double v = s->value[m];
+
+    // Moyenne exponentielle en temps : constante de temps = largeur de la fenêtre
+    if (seq == 0)
+      w->ewma[m] = v;
+    else
+      w->ewma[m] += (1.0 - exp(-(double)dt_ms / (double)size_ms)) * (v - w->ewma[m]);
+
+    w->sum[m] += v;
+
+    // Arrière des files : les mesures dominées ne seront jamais extrêmes
+    while (w->max[m].count > 0 && sampleAt(d, dequeBack(&w->max[m]))->value[m] <= v)
+      w->max[m].count--;
+    while (w->min[m].count > 0 && sampleAt(d, dequeBack(&w->min[m]))->value[m] >= v)
+      w->min[m].count--;
+
+    if (dequePush(&w->max[m], seq) != 0 || dequePush(&w->min[m], seq) != 0)
+      return -1;
+  }
+
+  // Avant : sortie des mesures trop anciennes
+  while (w->tail < seq && sampleAt(d, w->tail)->ts_ms <= s->ts_ms - size_ms)
+  {
+    const WindowSample *old = sampleAt(d, w->tail);
+    for (int m = 0; m < WINDOW_METRICS; m++)
+    {
+      w->sum[m] -= old->value[m];
+      if (dequeFront(&w->max[m]) == w->tail)
+        dequePopFront(&w->max[m]);
+      if (dequeFront(&w->min[m]) == w->tail)
+        dequePopFront(&w->min[m]);
+    }
+    w->tail++;
+  }
+
+  // Fenêtre réduite à cette mesure : somme recalée, sans dérive d'arrondi
+  if (w->tail == seq)
+  {
+    for (int m = 0; m < WINDOW_METRICS; m++)
+      w->sum[m] = s->value[m];
+  }
+
+  return 0;
+}
+
+int window_stats_add(int device, int64_t ts_ms, const double value[WINDOW_METRICS])
+{
+  if (device < 0 || sizes_ms_count == 0)
+    return -1;
+
+  if (device >= device_capacity && growDevices(device) != 0)
+    return -1;
+
+  DeviceWindows *d = &devices[device];
+
+  if (d->next > 0 && ts_ms < d->last_ts)
+    ts_ms = d->last_ts;
+
+  if (d->next - d->oldest == d->capacity && growSamples(d) != 0)
+    return -1;
+
+  uint64_t seq = d->next++;
+  WindowSample *s = sampleAt(d, seq);
+  s->ts_ms = ts_ms;
+  memcpy(s->value, value, sizeof(s->value));
+
+  int64_t dt_ms = (seq > 0) ? ts_ms - d->last_ts : 0;
+  for (int i = 0; i < sizes_ms_count; i++)
+  {
+    if (addToWindow(d, &d->window[i], sizes_ms[i], seq, dt_ms) != 0)
+      return -1;
+  }
+
+  // La plus large fenêtre retient les mesures les plus anciennes
+  d->oldest = d->window[sizes_ms_count - 1].tail;
+  d->last_ts = ts_ms;
+  d->dirty = 1;
+  return 0;
+}
+
+int window_stats_next_dirty(int *device)
+{
+  for (int i = (*device > 0) ? *device : 0; i < device_capacity; i++)
+  {
+    if (devices[i].dirty)
+    {
+      devices[i].dirty = 0;
+      *device = i;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+int window_stats_get(int device, WindowSnapshot *out, int64_t *last_ts)
+{
+  if (device < 0 || device >= device_capacity || devices[device].next == 0)
+    return 0;
+
+  DeviceWindows *d = &devices[device];
+
+  for (int i = 0; i < sizes_ms_count; i++)
+  {
+    WindowState *w = &d->window[i];
+    out[i].size_s = (int)(sizes_ms[i] / 1000);
+    out[i].count = (size_t)(d->next - w->tail);
+
+    for (int m = 0; m < WINDOW_METRICS; m++)
+    {
+      out[i].metric[m].mean = w->sum[m] / (double)out[i].count;
+      out[i].metric[m].min = sampleAt(d, dequeFront(&w->min[m]))->value[m];
+      out[i].metric[m].max = sampleAt(d, dequeFront(&w->max[m]))->value[m];
+      out[i].metric[m].ewma = w->ewma[m];
+    }
+  }
+
+  if (last_ts)
+    *last_ts = d->last_ts;
+  return sizes_ms_count;
+}
+
+int window_stats_format(char *buffer, size_t size, const char *timestamp, const WindowSnapshot *windows, int count)
+{
+  static const char *names[WINDOW_METRICS] = {"temperature", "pression", "humidite"};
+  size_t len = 0;
+  int n = snprintf(buffer, size, "{\"timestamp\": \"%s\", \"windows\": [", timestamp);
+
+  for (int i = 0; n >= 0 && i < count; i++)
+  {
+    len += (size_t)n;
+    if (len >= size)
+      return -1;
+
+    n = snprintf(buffer + len, size - len, "%s{\"window_s\": %d, \"n\": %zu", i ? ", " : "",
+                 windows[i].size_s, windows[i].count);
+
+    for (int m = 0; n >= 0 && m < WINDOW_METRICS; m++)
+    {
+      len += (size_t)n;
+      if (len >= size)
+        return -1;
+
+      const WindowMetric *metric = &windows[i].metric[m];
+      n = snprintf(buffer + len, size - len,
+                   ", \"%s\": {\"mean\": %.2f, \"min\": %.1f, \"max\": %.1f, \"ewma\": %.2f}%s", names[m],
+                   metric->mean, metric->min, metric->max, metric->ewma, (m == WINDOW_METRICS - 1) ? "}" : "");
+    }
+  }
+
+  if (n < 0)
+    return -1;
+  len += (size_t)n;
+
+  n = (len < size) ? snprintf(buffer + len, size - len, "]}") : -1;
+  if (n < 0 || len + (size_t)n >= size)
+    return -1;
+
+  return (int)(len + (size_t)n);
+}
+
+void window_stats_close(void)
+{
+  for (int i = 0; i < device_capacity; i++)
+  {
+    free(devices[i].samples);
+    for (int w = 0; w < WINDOW_MAX_SIZES; w++)
+    {
+      for (int m = 0; m < WINDOW_METRICS; m++)
+      {
+        free(devices[i].window[w].min[m].seq);
+        free(devices[i].window[w].max[m].seq);
+      }
+    }
+  }
+
+  free(devices);
+  devices = NULL;
+  device_capacity = 0;
+}
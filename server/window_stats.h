@@ -0,0 +1,94 @@
+#ifndef WINDOW_STATS_H
+#define WINDOW_STATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define WINDOW_METRICS 3
+#define WINDOW_MAX_SIZES 8
+
+// ===== FENÊTRES GLISSANTES =====
+
+/*
+ * Statistiques de chaque appareil sur plusieurs fenêtres glissantes (60 s,
+ * 15 min, 3 h...), tenues à chaque mesure en O(1) amorti : sommes courantes
+ * pour la moyenne, files monotones pour min et max, moyenne mobile
+ * exponentielle (constante de temps = largeur de la fenêtre).
+ *
+ * Les mesures d'un appareil sont gardées une seule fois, dans un anneau qui
+ * couvre la plus large fenêtre ; chaque fenêtre n'en garde que des positions.
+ * Les fenêtres suivent l'instant de la dernière mesure de l'appareil, pas
+ * l'horloge : un appareil muet garde ses dernières statistiques.
+ *
+ * Uniquement utilisé par le thread d'écriture : aucun verrou.
+ */
+
+/**
+ * @brief Statistiques d'une métrique sur une fenêtre
+ */
+typedef struct
+{
+  double mean;
+  double min;
+  double max;
+  double ewma;
+} WindowMetric;
+
+/**
+ * @brief Statistiques d'une fenêtre
+ */
+typedef struct
+{
+  int size_s;
+  size_t count;
+  WindowMetric metric[WINDOW_METRICS]; // temperature, pression, humidite
+} WindowSnapshot;
+
+/**
+ * @brief Initialise les fenêtres
+ * @param sizes_s Largeurs en secondes, croissantes
+ * @param count Nombre de fenêtres (1..WINDOW_MAX_SIZES)
+ * @return 0 si succès, -1 si les largeurs sont invalides
+ */
+int window_stats_init(const int *sizes_s, int count);
+
+/**
+ * @brief Ajoute une mesure
+ *
+ * Une mesure antérieure à la précédente de l'appareil est datée comme elle.
+ *
+ * @return 0 si succès, -1 en cas d'erreur d'allocation
+ */
+int window_stats_add(int device, int64_t ts_ms, const double value[WINDOW_METRICS]);
+
+/**
+ * @brief Appareil suivant modifié depuis le dernier appel, remis à zéro
+ * @param device Appareil à partir duquel chercher, mis à jour
+ * @return 1 si un appareil a été trouvé, 0 sinon
+ */
+int window_stats_next_dirty(int *device);
+
+/**
+ * @brief Statistiques courantes d'un appareil
+ * @param out Une entrée par fenêtre (WINDOW_MAX_SIZES au plus)
+ * @param last_ts Instant de la dernière mesure (peut être NULL)
+ * @return Nombre de fenêtres, 0 si l'appareil est inconnu
+ */
+int window_stats_get(int device, WindowSnapshot *out, int64_t *last_ts);
+
+/**
+ * @brief Sérialise les statistiques en JSON
+ *
+ * {"timestamp": "...", "windows": [{"window_s": 60, "n": 12, "temperature":
+ * {"mean": 21.43, "min": 21.3, "max": 21.6, "ewma": 21.45}, ...}, ...]}
+ *
+ * @return Longueur écrite, -1 si le buffer est trop petit
+ */
+int window_stats_format(char *buffer, size_t size, const char *timestamp, const WindowSnapshot *windows, int count);
+
+/**
+ * @brief Libère l'état par appareil
+ */
+void window_stats_close(void);
+
+#endif // WINDOW_STATS_H